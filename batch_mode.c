@@ -0,0 +1,445 @@
+/** @file
+ * Implementacja wsadowego trybu gry
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch_mode.h"
+#include "constants.h"
+#include "game.h"
+#include "safe_memory_allocation.h"
+
+/**
+ * Rozmiar bufora wejścia.
+ */
+#define INPUT_BUFFER_SIZE (1 << 20)
+
+/**
+ * Rozmiar bufora wyjścia.
+ */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+/**
+ * Rozmiar bufora na statystyki gry w formacie JSON.
+ */
+#define STATS_BUFFER_SIZE 2048
+
+/**
+ * Maksymalna liczba argumentów polecenia.
+ */
+#define MAX_ARGUMENTS 3
+
+/**
+ * To jest struktura buforowanego czytnika.
+ */
+typedef struct reader {
+    int fd;
+    size_t pos;
+    size_t len;
+    bool error;
+    char buffer[INPUT_BUFFER_SIZE];
+} reader_t;
+
+/**
+ * To jest struktura buforowanego pisarza.
+ */
+typedef struct writer {
+    int fd;
+    size_t len;
+    bool error;
+    char buffer[OUTPUT_BUFFER_SIZE];
+} writer_t;
+
+/* CZYTNIK */
+
+/**
+ * Wczytuje kolejny fragment wejścia do bufora. Zwraca false, gdy wejście
+ * się skończyło lub wystąpił błąd.
+ */
+static bool reader_fill(reader_t *r) {
+    ssize_t n;
+    do {
+        n = read(r->fd, r->buffer, INPUT_BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        r->error = true;
+    }
+    r->pos = 0;
+    r->len = n > 0 ? (size_t) n : 0;
+    return n > 0;
+}
+
+/**
+ * Zwraca kolejny znak wejścia lub EOF.
+ */
+static inline int reader_get(reader_t *r) {
+    if (r->pos == r->len && !reader_fill(r)) {
+        return EOF;
+    }
+    return (unsigned char) r->buffer[r->pos++];
+}
+
+/**
+ * Pomija wejście do końca bieżącego wiersza.
+ */
+static void reader_skip_line(reader_t *r) {
+    int ch;
+    do {
+        ch = reader_get(r);
+    } while (ch != '\n' && ch != EOF);
+}
+
+/* PISARZ */
+
+/**
+ * Wypisuje zawartość bufora.
+ */
+static void writer_flush(writer_t *w) {
+    size_t done = 0;
+    while (done < w->len && !w->error) {
+        ssize_t n = write(w->fd, w->buffer + done, w->len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO;
+            }
+            w->error = true;
+        }
+        else {
+            done += (size_t) n;
+        }
+    }
+    w->len = 0;
+}
+
+/**
+ * Dopisuje napis o zadanej długości do bufora.
+ */
+static void writer_write(writer_t *w, const char *s, size_t len) {
+    while (len > 0) {
+        if (w->len == OUTPUT_BUFFER_SIZE) {
+            writer_flush(w);
+        }
+        size_t chunk = OUTPUT_BUFFER_SIZE - w->len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(w->buffer + w->len, s, chunk);
+        w->len += chunk;
+        s += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * Dopisuje liczbę zakończoną znakiem nowego wiersza do bufora.
+ */
+static void writer_write_number(writer_t *w, uint64_t number) {
+    char digits[24];
+    size_t i = sizeof(digits);
+    digits[--i] = '\n';
+    do {
+        digits[--i] = (char) ('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+    writer_write(w, digits + i, sizeof(digits) - i);
+}
+
+/**
+ * Dopisuje napis opisujący stan planszy, kopiując go prosto do bufora
+ * fragmentami zamiast tworzyć cały napis.
+ */
+static void writer_write_board(writer_t *w, game_t const *g) {
+    uint64_t offset = 0;
+    uint64_t length;
+    do {
+        if (w->len == OUTPUT_BUFFER_SIZE) {
+            writer_flush(w);
+        }
+        length = game_board_read(g, offset, w->buffer + w->len,
+                                 OUTPUT_BUFFER_SIZE - w->len);
+        w->len += length;
+        offset += length;
+    } while (length > 0);
+}
+
+/**
+ * Dopisuje sformatowany napis do bufora o rozmiarze @p size od pozycji
+ * @p *len i przesuwa ją za dopisany tekst. Gdy tekst się nie mieści, jest
+ * obcinany, a pozycja zatrzymuje się na kończącym bufor znaku '\0', więc
+ * kolejne dopisania niczego nie zmieniają.
+ */
+__attribute__((format(printf, 4, 5)))
+static void append_format(char *buffer, size_t size, size_t *len,
+                          const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *len, size - *len, format, args);
+    va_end(args);
+    if (written > 0) {
+        *len += (size_t) written;
+    }
+    if (*len >= size) {
+        *len = size - 1;
+    }
+}
+
+/**
+ * Zapisuje statystyki gry w jednym wierszu w formacie JSON. Zwraca długość
+ * napisu.
+ */
+static size_t format_stats(const game_stats_t *s, char *buffer, size_t size) {
+    static const char *reasons[GAME_REJECT_REASONS] = {
+        "none", "player", "field", "no_moves", "busy", "areas", "memory"
+    };
+    size_t len = 0;
+    append_format(buffer, size, &len,
+                  "{\"calls\": %lu, \"moves\": %lu, \"rejected\": {",
+                  s->calls, s->moves);
+    for (int i = GAME_REJECT_PLAYER; i < GAME_REJECT_REASONS; i++) {
+        append_format(buffer, size, &len, "%s\"%s\": %lu",
+                      i > GAME_REJECT_PLAYER ? ", " : "", reasons[i],
+                      s->rejected[i]);
+    }
+    append_format(buffer, size, &len,
+                  "}, \"merged\": [%lu, %lu, %lu, %lu, %lu], "
+                  "\"merges\": %lu, \"relabels\": %lu, "
+                  "\"relabel_cells\": %lu, \"relabel_max\": %lu, "
+                  "\"relabel_sizes\": [",
+                  s->merged[0], s->merged[1], s->merged[2], s->merged[3],
+                  s->merged[4], s->merges, s->relabels, s->relabel_cells,
+                  s->relabel_max);
+    for (int i = 0; i < GAME_STATS_RELABEL_SIZES; i++) {
+        append_format(buffer, size, &len, "%s%lu", i > 0 ? ", " : "",
+                      s->relabel_sizes[i]);
+    }
+    append_format(buffer, size, &len,
+                  "], \"latency_ns\": {\"total\": %lu, "
+                  "\"max\": %lu, \"p50\": %lu, \"p90\": %lu, "
+                  "\"p99\": %lu, \"p999\": %lu}}\n",
+                  s->latency_ns, s->latency_max,
+                  game_stats_latency_quantile(s, 0.5),
+                  game_stats_latency_quantile(s, 0.9),
+                  game_stats_latency_quantile(s, 0.99),
+                  game_stats_latency_quantile(s, 0.999));
+    return len;
+}
+
+/* POLECENIA */
+
+/**
+ * To jest struktura przechowująca wczytane polecenie.
+ */
+typedef struct command {
+    char name;
+    uint32_t count;
+    uint32_t args[MAX_ARGUMENTS];
+} command_t;
+
+/**
+ * Wczytuje resztę wiersza polecenia. Zwraca false, jeśli wiersz jest
+ * niepoprawny. Wczytuje wejście do końca wiersza niezależnie od wyniku.
+ */
+static bool read_arguments(reader_t *r, command_t *c) {
+    bool separated = false;
+    int ch = reader_get(r);
+    while (ch != '\n' && ch != EOF) {
+        if (ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f' || ch == '\r') {
+            separated = true;
+            ch = reader_get(r);
+        }
+        else if (ch >= '0' && ch <= '9' && separated
+                 && c->count < MAX_ARGUMENTS) {
+            uint64_t number = 0;
+            while (ch >= '0' && ch <= '9') {
+                number = number * 10 + (uint64_t) (ch - '0');
+                if (number > UINT32_MAX) {
+                    reader_skip_line(r);
+                    return false;
+                }
+                ch = reader_get(r);
+            }
+            c->args[c->count++] = (uint32_t) number;
+            separated = false;
+        }
+        else {
+            reader_skip_line(r);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Wykonuje ruch gracza wybrany przez komputerowego gracza i wypisuje jego
+ * współrzędne. Zwraca false, jeśli numer gracza jest niepoprawny.
+ */
+static bool execute_bot_move(game_t *g, uint32_t player,
+                             const mcts_params_t *bot, writer_t *w) {
+    if (player == NO_PLAYER || player > game_players(g)) {
+        return false;
+    }
+    mcts_result_t result;
+    if (!mcts_search(g, player, bot, &result)
+        || !game_move(g, player, result.x, result.y)) {
+        writer_write(w, "-\n", 2);
+        return true;
+    }
+    char digits[24];
+    int len = snprintf(digits, sizeof(digits), "%u ", result.x);
+    writer_write(w, digits, (size_t) len);
+    writer_write_number(w, result.y);
+    return true;
+}
+
+/**
+ * Zapisuje migawkę gry do pliku tymczasowego i podmienia nim plik
+ * @p path. Zwraca false, gdy się to nie udało.
+ */
+static bool save_snapshot(game_t const *g, const char *path) {
+    size_t length = strlen(path);
+    char *temporary = safe_malloc(length + sizeof(".tmp"));
+    if (temporary == NULL) {
+        return false;
+    }
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && game_save(g, fd);
+    ok = (fd < 0 || close(fd) == 0) && ok && rename(temporary, path) == 0;
+    if (!ok && fd >= 0) {
+        unlink(temporary);
+    }
+    free(temporary);
+    return ok;
+}
+
+/**
+ * Wykonuje polecenie. Zwraca false, jeśli polecenie jest niepoprawne.
+ */
+static bool execute_command(game_t *g, const command_t *c,
+                            const mcts_params_t *bot, const char *snapshot,
+                            writer_t *w) {
+    switch (c->name) {
+        case 'm':
+            if (c->count != 3) {
+                return false;
+            }
+            writer_write(w, game_move(g, c->args[0], c->args[1], c->args[2])
+                            ? "1\n" : "0\n", 2);
+            return true;
+        case 'b':
+            if (c->count != 1) {
+                return false;
+            }
+            writer_write_number(w, game_busy_fields(g, c->args[0]));
+            return true;
+        case 'f':
+            if (c->count != 1) {
+                return false;
+            }
+            writer_write_number(w, game_free_fields(g, c->args[0]));
+            return true;
+        case 'p': {
+            if (c->count != 0) {
+                return false;
+            }
+            writer_write_board(w, g);
+            return true;
+        }
+        case 'a':
+            if (c->count != 1) {
+                return false;
+            }
+            return execute_bot_move(g, c->args[0], bot, w);
+        case 's': {
+            game_stats_t stats;
+            if (c->count != 0 || !game_stats(g, &stats)) {
+                return false;
+            }
+            char buffer[STATS_BUFFER_SIZE];
+            writer_write(w, buffer, format_stats(&stats, buffer, sizeof(buffer)));
+            return true;
+        }
+        case 'z':
+            if (c->count != 0 || snapshot == NULL) {
+                return false;
+            }
+            writer_write(w, save_snapshot(g, snapshot) ? "1\n" : "0\n", 2);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* FUNKCJE MODUŁU */
+
+int run_batch(game_t *g, int input_fd, const mcts_params_t *bot,
+              const char *snapshot) {
+    reader_t *r = safe_malloc(sizeof(reader_t));
+    writer_t *w = safe_malloc(sizeof(writer_t));
+    if (r == NULL || w == NULL) {
+        free(r);
+        free(w);
+        fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+        return MEMORY_ERROR;
+    }
+    r->fd = input_fd;
+    r->pos = r->len = 0;
+    r->error = false;
+    w->fd = STDOUT_FILENO;
+    w->len = 0;
+    w->error = false;
+
+    uint64_t line = 0;
+    int ch;
+    while ((ch = reader_get(r)) != EOF) {
+        line++;
+        if (ch == '\n') {
+            continue;
+        }
+        if (ch == '#') {
+            reader_skip_line(r);
+            continue;
+        }
+        command_t c = {.name = (char) ch, .count = 0};
+        mcts_params_t params = *bot;
+        params.seed += line;
+        if (!read_arguments(r, &c)
+            || !execute_command(g, &c, &params, snapshot, w)) {
+            writer_flush(w);
+            fprintf(stderr, "ERROR %lu\n", line);
+        }
+    }
+    writer_flush(w);
+
+    game_stats_t stats;
+    if (game_stats(g, &stats)) {
+        char buffer[STATS_BUFFER_SIZE];
+        format_stats(&stats, buffer, sizeof(buffer));
+        fputs(buffer, stderr);
+    }
+
+    int status = 0;
+    if (r->error || w->error) {
+        fprintf(stderr, "Błąd wejścia/wyjścia.\n");
+        status = WRONG_INPUT;
+    }
+    free(r);
+    free(w);
+    return status;
+}
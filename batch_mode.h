@@ -0,0 +1,40 @@
+/** @file
+ * Interfejs wsadowego trybu gry
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+#include "game.h"
+#include "mcts.h"
+
+/**
+ * Uruchamia wsadowy tryb gry. Czyta polecenia z deskryptora @p input_fd,
+ * a odpowiedzi wypisuje na standardowe wyjście. Obsługiwane polecenia
+ * (po jednym w wierszu):
+ * - `m player x y` – wykonuje ruch, wypisuje 1 lub 0,
+ * - `b player` – wypisuje liczbę pól zajętych przez gracza,
+ * - `f player` – wypisuje liczbę pól, które gracz może jeszcze zająć,
+ * - `p` – wypisuje planszę,
+ * - `a player` – wykonuje ruch gracza wybrany przez komputerowego gracza
+ *   z parametrami @p bot, wypisuje współrzędne `x y` pola lub `-`, gdy
+ *   gracz nie może wykonać ruchu,
+ * - `s` – wypisuje statystyki gry w jednym wierszu w formacie JSON; wymaga
+ *   włączonego zbierania statystyk,
+ * - `z` – zapisuje migawkę gry do pliku @p snapshot (przez plik tymczasowy
+ *   z przyrostkiem `.tmp` podmieniany funkcją @p rename, więc można
+ *   nadpisać migawkę, z której gra została wczytana), wypisuje 1 lub 0;
+ *   wymaga podania pliku.
+ * Puste wiersze i wiersze zaczynające się od znaku `#` są pomijane.
+ * Dla niepoprawnego wiersza wypisuje na standardowe wyjście diagnostyczne
+ * `ERROR n`, gdzie n jest numerem wiersza.
+ * Jeśli zbieranie statystyk jest włączone, po zakończeniu wypisuje je na
+ * standardowe wyjście diagnostyczne. Zwraca 0 lub kod błędu.
+ */
+int run_batch(game_t *g, int input_fd, const mcts_params_t *bot,
+              const char *snapshot);
+
+#endif /* BATCH_MODE_H */
@@ -0,0 +1,509 @@
+/** @file
+ * Program mierzący wydajność silnika gry.
+ *
+ * Uruchamia powtarzalne (zależne tylko od ziarna) scenariusze gry i wypisuje
+ * ich wyniki na standardowe wyjście w formacie JSON. Mierzy czas ruchów
+ * (@ref game_move), zapytań o liczbę wolnych pól (@ref game_free_fields),
+ * rysowania planszy (@ref game_board) i rozgałęziania gry (@ref game_fork)
+ * oraz pamięć zajmowaną przez grę. Wszystkie scenariusze można uruchomić
+ * z wybraną kolejnością pól planszy; jeśli system udostępnia liczniki
+ * sprzętowe, program podaje też liczbę chybień w pamięci podręcznej
+ * na ruch.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "constants.h"
+#include "game.h"
+#include "mcts.h"
+#include "rng.h"
+
+/**
+ * Wersja formatu wyników.
+ */
+#define BENCH_FORMAT_VERSION 3
+
+/**
+ * Liczba zapytań o liczbę wolnych pól w jednym pomiarze.
+ */
+#define FREE_FIELDS_QUERIES 1000000
+
+/**
+ * Minimalna liczba pól rysowanych w jednym pomiarze rysowania planszy.
+ */
+#define RENDER_CELLS (1 << 24)
+
+/**
+ * Liczba rozgałęzień gry w jednym pomiarze.
+ */
+#define FORKS 100
+
+/**
+ * To jest typ wyliczeniowy opisujący sposób wybierania ruchów scenariusza.
+ */
+typedef enum pattern {
+    PATTERN_LEGAL,      /* Cała gra z losowymi dozwolonymi ruchami. */
+    PATTERN_ATTEMPTS,   /* Losowe, często niedozwolone ruchy. */
+    PATTERN_SNAKE,      /* Wąż jednego gracza wypełniający planszę. */
+    PATTERN_COMB,       /* Zęby grzebienia łączone na końcu grzbietem. */
+    PATTERN_WALK,       /* Ruchy w błądzeniu losowym, skupione w plamie. */
+} pattern_t;
+
+/**
+ * To jest struktura opisująca scenariusz.
+ */
+typedef struct workload {
+    const char *name;
+    pattern_t pattern;
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+    uint64_t attempts;  /* Liczba prób ruchu dla PATTERN_ATTEMPTS
+                           i PATTERN_WALK. */
+} workload_t;
+
+/**
+ * To jest struktura przechowująca wyniki scenariusza.
+ */
+typedef struct measurement {
+    uint64_t attempts;
+    uint64_t accepted;
+    double move_seconds;
+    double free_fields_seconds;
+    uint64_t render_cells;
+    double render_seconds;
+    double fork_seconds;        /* Łączny czas rozgałęzień. */
+    double fork_move_seconds;   /* Łączny czas pierwszych ruchów w kopiach. */
+    uint64_t fork_memory;       /* Pamięć kopii po pierwszym ruchu. */
+    uint64_t memory;
+    int64_t cache_misses;       /* Chybienia podczas ruchów lub -1. */
+    uint64_t checksum;
+} measurement_t;
+
+/**
+ * Scenariusze.
+ */
+static const workload_t workloads[] = {
+    {"random_legal", PATTERN_LEGAL, 512, 512, 4, 16, 0},
+    {"random_legal_small", PATTERN_LEGAL, 64, 64, 4, 4, 0},
+    {"random_attempts", PATTERN_ATTEMPTS, 512, 512, 4, 4, 2000000},
+    {"snake", PATTERN_SNAKE, 1024, 1024, 1, 1, 0},
+    {"comb", PATTERN_COMB, 1024, 1024, 1, 1024, 0},
+    {"many_players", PATTERN_LEGAL, 256, 256, MAX_NUMBER_OF_PLAYERS, 1, 0},
+    {"huge_sparse", PATTERN_ATTEMPTS, 8192, 8192, 8, UINT32_MAX, 1000000},
+    {"huge_blob", PATTERN_WALK, 16384, 16384, 4, UINT32_MAX, 4000000},
+};
+
+/**
+ * Nazwy kolejności pól planszy.
+ */
+static const char *const orders[BOARD_ORDERS] = {
+    [BOARD_ORDER_TILES] = "tiles",
+    [BOARD_ORDER_MORTON] = "morton",
+    [BOARD_ORDER_COLUMNS] = "columns",
+};
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca czas monotoniczny w sekundach.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * Otwiera licznik chybień w pamięci podręcznej wątku w trybie użytkownika.
+ * Zwraca jego deskryptor lub -1, gdy system nie udostępnia licznika.
+ */
+static int cache_counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Włącza licznik @p fd od zera, o ile jest otwarty.
+ */
+static void cache_counter_start(int fd) {
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/**
+ * Wyłącza licznik @p fd i zamyka go. Zwraca jego wartość lub -1, gdy
+ * licznik nie jest otwarty lub nie udało się go odczytać.
+ */
+static int64_t cache_counter_stop(int fd) {
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count;
+    int64_t result = read(fd, &count, sizeof(count)) == sizeof(count)
+                     ? (int64_t)count : -1;
+    close(fd);
+    return result;
+}
+
+/**
+ * Wykonuje ruch i dolicza go do wyników.
+ */
+static void bench_move(game_t *g, measurement_t *m, uint32_t player,
+                       uint32_t x, uint32_t y) {
+    m->attempts++;
+    m->accepted += game_move(g, player, x, y);
+}
+
+/**
+ * Rozgrywa całą grę z losowymi dozwolonymi ruchami.
+ */
+static void run_legal(game_t *g, measurement_t *m, rng_t *rng) {
+    for (uint32_t p = game_next_active_player(g, NO_PLAYER);
+         p != NO_PLAYER; p = game_next_active_player(g, p)) {
+        uint32_t x, y;
+        if (!game_legal_move(g, p, rng_below(rng, game_free_fields(g, p)),
+                             &x, &y)) {
+            break;
+        }
+        bench_move(g, m, p, x, y);
+    }
+}
+
+/**
+ * Wykonuje losowe ruchy losowych graczy.
+ */
+static void run_attempts(game_t *g, const workload_t *w, measurement_t *m,
+                         rng_t *rng) {
+    for (uint64_t i = 0; i < w->attempts; i++) {
+        uint32_t player = 1 + (uint32_t)rng_below(rng, w->players);
+        uint32_t x = (uint32_t)rng_below(rng, w->width);
+        uint32_t y = (uint32_t)rng_below(rng, w->height);
+        bench_move(g, m, player, x, y);
+    }
+}
+
+/**
+ * Wykonuje ruchy losowych graczy na polach kolejno odwiedzanych
+ * w błądzeniu losowym ze środka planszy, więc zajęte pola tworzą zwartą
+ * plamę, jak w prawdziwej grze.
+ */
+static void run_walk(game_t *g, const workload_t *w, measurement_t *m,
+                     rng_t *rng) {
+    uint32_t x = w->width / 2, y = w->height / 2;
+    for (uint64_t i = 0; i < w->attempts; i++) {
+        switch (rng_below(rng, DIRECTIONS)) {
+            case 0:
+                y += y + 1 < w->height;
+                break;
+            case 1:
+                x += x + 1 < w->width;
+                break;
+            case 2:
+                y -= y > 0;
+                break;
+            default:
+                x -= x > 0;
+                break;
+        }
+        bench_move(g, m, 1 + (uint32_t)rng_below(rng, w->players), x, y);
+    }
+}
+
+/**
+ * Wypełnia planszę wężem: kolejne kolumny są zajmowane na przemian w górę
+ * i w dół, więc każde pole dołącza do jednego rosnącego obszaru.
+ */
+static void run_snake(game_t *g, const workload_t *w, measurement_t *m) {
+    for (uint32_t x = 0; x < w->width; x++) {
+        for (uint32_t i = 0; i < w->height; i++) {
+            uint32_t y = x % 2 == 0 ? i : w->height - 1 - i;
+            bench_move(g, m, 1, x, y);
+        }
+    }
+}
+
+/**
+ * Buduje grzebień: najpierw zęby w parzystych kolumnach jako osobne
+ * obszary, a potem grzbiet w wierszu zerowym, który kolejno je łączy.
+ */
+static void run_comb(game_t *g, const workload_t *w, measurement_t *m) {
+    for (uint32_t x = 0; x < w->width; x += 2) {
+        for (uint32_t y = 1; y < w->height; y++) {
+            bench_move(g, m, 1, x, y);
+        }
+    }
+    for (uint32_t x = 0; x < w->width; x++) {
+        bench_move(g, m, 1, x, 0);
+    }
+}
+
+/**
+ * Mierzy rozgałęzianie gry i pierwszą próbę ruchu w każdej kopii, na polu
+ * zależnym od numeru kopii. Zwraca false, gdy nie udało się utworzyć kopii.
+ */
+static bool measure_forks(game_t *g, const workload_t *w, measurement_t *m) {
+    game_t *forks[FORKS];
+    double start = now();
+    for (uint32_t i = 0; i < FORKS; i++) {
+        forks[i] = game_fork(g);
+    }
+    m->fork_seconds = now() - start;
+    bool ok = true;
+    for (uint32_t i = 0; i < FORKS; i++) {
+        ok = ok && forks[i] != NULL;
+    }
+    if (ok) {
+        uint32_t xs[FORKS], ys[FORKS];
+        for (uint32_t i = 0; i < FORKS; i++) {
+            uint64_t field = (uint64_t)i * w->width * w->height / FORKS;
+            xs[i] = (uint32_t)(field / w->height);
+            ys[i] = (uint32_t)(field % w->height);
+        }
+        start = now();
+        for (uint32_t i = 0; i < FORKS; i++) {
+            game_move(forks[i], 1 + i % w->players, xs[i], ys[i]);
+        }
+        m->fork_move_seconds = now() - start;
+        m->fork_memory = game_memory(forks[0]);
+    }
+    for (uint32_t i = 0; i < FORKS; i++) {
+        game_delete(forks[i]);
+    }
+    return ok;
+}
+
+/**
+ * Uruchamia scenariusz i mierzy jego wyniki. Zwraca false, gdy nie udało
+ * się utworzyć gry.
+ */
+static bool run_workload(const workload_t *w, uint64_t seed,
+                         board_order_t order, measurement_t *m) {
+    game_options_t options = {.huge_pages = false, .order = order};
+    game_t *g = game_new_with_options(w->width, w->height, w->players,
+                                      w->areas, &options);
+    if (g == NULL) {
+        return false;
+    }
+    memset(m, 0, sizeof(measurement_t));
+    rng_t rng;
+    rng_seed(&rng, seed);
+
+    int counter = cache_counter_open();
+    cache_counter_start(counter);
+    double start = now();
+    switch (w->pattern) {
+        case PATTERN_LEGAL:
+            run_legal(g, m, &rng);
+            break;
+        case PATTERN_ATTEMPTS:
+            run_attempts(g, w, m, &rng);
+            break;
+        case PATTERN_SNAKE:
+            run_snake(g, w, m);
+            break;
+        case PATTERN_COMB:
+            run_comb(g, w, m);
+            break;
+        case PATTERN_WALK:
+            run_walk(g, w, m, &rng);
+            break;
+    }
+    m->move_seconds = now() - start;
+    m->cache_misses = cache_counter_stop(counter);
+
+    uint64_t sum = 0;
+    start = now();
+    for (uint64_t i = 0; i < FREE_FIELDS_QUERIES; i++) {
+        sum += game_free_fields(g, 1 + (uint32_t)(i % w->players));
+    }
+    m->free_fields_seconds = now() - start;
+
+    uint64_t cells = (uint64_t)w->width * w->height;
+    start = now();
+    do {
+        char *board = game_board(g);
+        if (board == NULL) {
+            break;
+        }
+        sum += (unsigned char)board[0];
+        free(board);
+        m->render_cells += cells;
+    } while (m->render_cells < RENDER_CELLS);
+    m->render_seconds = now() - start;
+
+    if (!measure_forks(g, w, m)) {
+        game_delete(g);
+        return false;
+    }
+
+    m->memory = game_memory(g);
+    for (uint32_t p = 1; p <= w->players; p++) {
+        m->checksum = m->checksum * 31 + game_busy_fields(g, p);
+    }
+    m->checksum = m->checksum * 31 + sum % 2;
+    game_delete(g);
+    return true;
+}
+
+/**
+ * Zwraca iloraz lub zero, gdy dzielnik jest zerowy.
+ */
+static double ratio(double a, double b) {
+    return b > 0 ? a / b : 0;
+}
+
+/**
+ * Wypisuje wyniki scenariusza jako obiekt JSON.
+ */
+static void print_workload(const workload_t *w, uint64_t seed,
+                           board_order_t order, const measurement_t *m,
+                           bool last) {
+    uint64_t cells = (uint64_t)w->width * w->height;
+    printf("    {\"name\": \"%s\", \"width\": %u, \"height\": %u, "
+           "\"players\": %u, \"areas\": %u, \"seed\": %lu, "
+           "\"order\": \"%s\",\n",
+           w->name, w->width, w->height, w->players, w->areas, seed,
+           orders[order]);
+    printf("     \"attempts\": %lu, \"accepted\": %lu, \"move_seconds\": %.6f, "
+           "\"moves_per_second\": %.0f, \"ns_per_move\": %.2f,\n",
+           m->attempts, m->accepted, m->move_seconds,
+           ratio((double)m->attempts, m->move_seconds),
+           ratio(m->move_seconds * 1e9, (double)m->attempts));
+    if (m->cache_misses >= 0) {
+        printf("     \"cache_misses_per_move\": %.3f,\n",
+               ratio((double)m->cache_misses, (double)m->attempts));
+    }
+    else {
+        printf("     \"cache_misses_per_move\": null,\n");
+    }
+    printf("     \"free_fields_ns\": %.2f, \"render_ns_per_cell\": %.3f, "
+           "\"fork_ns\": %.0f, \"fork_move_ns\": %.0f,\n",
+           ratio(m->free_fields_seconds * 1e9, FREE_FIELDS_QUERIES),
+           ratio(m->render_seconds * 1e9, (double)m->render_cells),
+           m->fork_seconds * 1e9 / FORKS, m->fork_move_seconds * 1e9 / FORKS);
+    printf("     \"memory_bytes\": %lu, \"bytes_per_cell\": %.3f, "
+           "\"fork_memory_bytes\": %lu, \"checksum\": %lu}%s\n",
+           m->memory, ratio((double)m->memory, (double)cells), m->fork_memory,
+           m->checksum, last ? "" : ",");
+}
+
+/**
+ * Wypisuje sposób użycia programu.
+ */
+static int usage(const char *name) {
+    fprintf(stderr, "Użycie:\n%s [-s ziarno] [-q] [-w scenariusz] "
+                    "[-o kolejność]\n"
+                    "  -s ziarno      ziarno generatora (domyślnie 1)\n"
+                    "  -q             scenariusze zmniejszone czterokrotnie\n"
+                    "  -w scenariusz  uruchamia tylko wskazany scenariusz\n"
+                    "  -o kolejność   kolejność pól planszy: tiles "
+                    "(domyślnie), morton\n"
+                    "                 lub columns\n",
+            name);
+    return WRONG_INPUT;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t seed = 1;
+    bool quick = false;
+    const char *only = NULL;
+    board_order_t order = BOARD_ORDER_TILES;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:qw:o:")) != -1) {
+        switch (opt) {
+            case 's': {
+                char *endptr;
+                errno = 0;
+                seed = strtoull(optarg, &endptr, 10);
+                if (errno != 0 || *endptr != '\0') {
+                    return usage(argv[0]);
+                }
+                break;
+            }
+            case 'q':
+                quick = true;
+                break;
+            case 'w':
+                only = optarg;
+                break;
+            case 'o': {
+                uint32_t i = 0;
+                while (i < BOARD_ORDERS && strcmp(optarg, orders[i]) != 0) {
+                    i++;
+                }
+                if (i == BOARD_ORDERS) {
+                    return usage(argv[0]);
+                }
+                order = (board_order_t)i;
+                break;
+            }
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (optind != argc) {
+        return usage(argv[0]);
+    }
+
+    size_t count = sizeof(workloads) / sizeof(workloads[0]);
+    size_t selected = 0;
+    for (size_t i = 0; i < count; i++) {
+        selected += only == NULL || strcmp(only, workloads[i].name) == 0;
+    }
+    if (selected == 0) {
+        fprintf(stderr, "Nieznany scenariusz.\n");
+        return WRONG_INPUT;
+    }
+
+    printf("{\n  \"format\": %d,\n  \"seed\": %lu,\n  \"quick\": %s,\n"
+           "  \"workloads\": [\n", BENCH_FORMAT_VERSION, seed,
+           quick ? "true" : "false");
+    for (size_t i = 0; i < count; i++) {
+        if (only != NULL && strcmp(only, workloads[i].name) != 0) {
+            continue;
+        }
+        workload_t w = workloads[i];
+        if (quick) {
+            w.width = (w.width + 3) / 4;
+            w.height = (w.height + 3) / 4;
+            w.attempts /= 16;
+        }
+        uint64_t workload_seed = seed + i;
+        measurement_t m;
+        if (!run_workload(&w, workload_seed, order, &m)) {
+            fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+            return MEMORY_ERROR;
+        }
+        print_workload(&w, workload_seed, order, &m, --selected == 0);
+        fflush(stdout);
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,193 @@
+/** @file
+ * Implementacja modułu planszy bitowej
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitboard.h"
+#include "constants.h"
+
+/**
+ * Liczba pustych kolumn dopisanych z każdej strony planszy. Dzięki nim
+ * sąsiedztwo kolumny można liczyć bez sprawdzania brzegów planszy.
+ */
+#define BITBOARD_PADDING 2
+
+/**
+ * Liczba kolumn przechowywanych dla każdego gracza.
+ */
+#define BITBOARD_COLUMNS (BITBOARD_MAX_SIZE + 2 * BITBOARD_PADDING)
+
+/**
+ * To jest struktura przechowująca planszę bitową. Kolumna x planszy ma
+ * w tablicach indeks x + BITBOARD_PADDING.
+ */
+struct bitboard {
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint64_t fields[BITBOARD_COLUMNS]; /* Pola należące do planszy. */
+    uint64_t busy[BITBOARD_COLUMNS];   /* Pola zajęte przez dowolnego gracza. */
+    uint64_t occupied[][BITBOARD_COLUMNS];
+};
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca indeks kolumny x w tablicach planszy bitowej.
+ */
+static uint32_t column(uint32_t x) {
+    return x + BITBOARD_PADDING;
+}
+
+/**
+ * Zwraca pola kolumny o indeksie @p i, które sąsiadują z polami zbioru @p set.
+ */
+static uint64_t adjacent(const uint64_t *set, uint32_t i) {
+    return set[i] << 1 | set[i] >> 1 | set[i - 1] | set[i + 1];
+}
+
+/**
+ * Zwraca wolne pola kolumny o indeksie @p i.
+ */
+static uint64_t free_cells(bitboard_t bb, uint32_t i) {
+    return bb->fields[i] & ~bb->busy[i];
+}
+
+/**
+ * Sprawdza poprawność gracza.
+ */
+static bool bitboard_player_correct(bitboard_t bb, uint32_t player) {
+    return bb != NULL && player != NO_PLAYER && player <= bb->players;
+}
+
+/* FUNKCJE MODUŁU */
+
+size_t bitboard_size(uint32_t players) {
+    return sizeof(struct bitboard)
+           + (players + 1) * sizeof(((bitboard_t)NULL)->occupied[0]);
+}
+
+bool bitboard_fits(uint32_t width, uint32_t height) {
+    return width <= BITBOARD_MAX_SIZE && height <= BITBOARD_MAX_SIZE;
+}
+
+bitboard_t bitboard_init(void *memory, uint32_t width, uint32_t height,
+                         uint32_t players) {
+    assert(memory != NULL && bitboard_fits(width, height));
+    bitboard_t bb = memory;
+    memset(bb, 0, bitboard_size(players));
+    bb->width = width;
+    bb->height = height;
+    bb->players = players;
+    uint64_t column_mask = height == BITBOARD_MAX_SIZE
+                           ? UINT64_MAX : ((uint64_t)1 << height) - 1;
+    for (uint32_t x = 0; x < width; x++) {
+        bb->fields[column(x)] = column_mask;
+    }
+    return bb;
+}
+
+void bitboard_copy(bitboard_t dst, bitboard_t src) {
+    assert(dst != NULL && src != NULL && dst->players == src->players);
+    memcpy(dst, src, bitboard_size(src->players));
+}
+
+bool bitboard_load(bitboard_t bb, const void *data, size_t size) {
+    assert(bb != NULL && data != NULL);
+    const struct bitboard *src = data;
+    if (size != bitboard_size(bb->players) || src->width != bb->width
+        || src->height != bb->height || src->players != bb->players
+        || memcmp(src->fields, bb->fields, sizeof(bb->fields)) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < BITBOARD_COLUMNS; i++) {
+        uint64_t busy = 0;
+        for (uint32_t p = 0; p <= src->players; p++) {
+            if ((busy & src->occupied[p][i]) != 0
+                || (p == NO_PLAYER && src->occupied[p][i] != 0)) {
+                return false;
+            }
+            busy |= src->occupied[p][i];
+        }
+        if (busy != src->busy[i] || (busy & ~src->fields[i]) != 0) {
+            return false;
+        }
+    }
+    memcpy(bb, src, size);
+    return true;
+}
+
+void bitboard_reset(bitboard_t bb) {
+    assert(bb != NULL);
+    memset(bb->busy, 0, sizeof(bb->busy));
+    memset(bb->occupied, 0, (bb->players + 1) * sizeof(bb->occupied[0]));
+}
+
+bool bitboard_has_neighbour(bitboard_t bb, uint32_t x, uint32_t y,
+                            uint32_t player) {
+    assert(bitboard_player_correct(bb, player));
+    assert(x < bb->width && y < bb->height);
+    return (adjacent(bb->occupied[player], column(x)) >> y) & 1;
+}
+
+uint32_t bitboard_new_frontier(bitboard_t bb, uint32_t x, uint32_t y,
+                               uint32_t player) {
+    assert(bitboard_player_correct(bb, player));
+    assert(x < bb->width && y < bb->height);
+    assert(((bb->busy[column(x)] >> y) & 1) == 0);
+
+    const uint64_t *set = bb->occupied[player];
+    uint32_t i = column(x);
+    uint64_t bit = (uint64_t)1 << y;
+    uint64_t middle = (bit << 1 | bit >> 1) & free_cells(bb, i)
+                      & ~adjacent(set, i);
+    uint64_t left = bit & free_cells(bb, i - 1) & ~adjacent(set, i - 1);
+    uint64_t right = bit & free_cells(bb, i + 1) & ~adjacent(set, i + 1);
+    return (uint32_t)(__builtin_popcountll(middle) + __builtin_popcountll(left)
+                      + __builtin_popcountll(right));
+}
+
+void bitboard_move(bitboard_t bb, uint32_t x, uint32_t y, uint32_t player) {
+    assert(bitboard_player_correct(bb, player));
+    assert(x < bb->width && y < bb->height);
+    uint64_t bit = (uint64_t)1 << y;
+    bb->busy[column(x)] |= bit;
+    bb->occupied[player][column(x)] |= bit;
+}
+
+void bitboard_undo(bitboard_t bb, uint32_t x, uint32_t y, uint32_t player) {
+    assert(bitboard_player_correct(bb, player));
+    assert(x < bb->width && y < bb->height);
+    uint64_t bit = (uint64_t)1 << y;
+    assert(bb->occupied[player][column(x)] & bit);
+    bb->busy[column(x)] &= ~bit;
+    bb->occupied[player][column(x)] &= ~bit;
+}
+
+bool bitboard_select(bitboard_t bb, uint32_t player, uint64_t n,
+                     uint32_t *x, uint32_t *y) {
+    assert(bb != NULL && player <= bb->players);
+    const uint64_t *set = bb->occupied[player];
+    for (uint32_t i = column(0); i < column(bb->width); i++) {
+        uint64_t cells = free_cells(bb, i);
+        if (player != NO_PLAYER) {
+            cells &= adjacent(set, i);
+        }
+        uint64_t count = (uint64_t)__builtin_popcountll(cells);
+        if (n < count) {
+            for (; n > 0; n--) {
+                cells &= cells - 1;
+            }
+            *x = i - column(0);
+            *y = (uint32_t)__builtin_ctzll(cells);
+            return true;
+        }
+        n -= count;
+    }
+    return false;
+}
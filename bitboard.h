@@ -0,0 +1,100 @@
+/** @file
+ * Interfejs modułu planszy bitowej
+ *
+ * Plansza bitowa przechowuje dla każdego gracza zbiór zajętych pól jako
+ * tablicę kolumn, w której kolumna jest jednym słowem 64-bitowym (bit y
+ * odpowiada polu w wierszu y). Pozwala to liczyć pola sąsiednie z obszarami
+ * gracza kilkoma operacjami na słowach dla całej kolumny naraz.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Maksymalna szerokość i wysokość planszy bitowej.
+ */
+#define BITBOARD_MAX_SIZE 64
+
+/**
+ * To jest deklaracja struktury przechowującej planszę bitową.
+ */
+typedef struct bitboard* bitboard_t;
+
+/**
+ * Sprawdza, czy plansza o zadanych wymiarach mieści się w planszy bitowej.
+ */
+bool bitboard_fits(uint32_t width, uint32_t height);
+
+/**
+ * Zwraca liczbę bajtów pamięci potrzebnych na planszę bitową dla graczy
+ * o numerach od 1 do @p players.
+ */
+size_t bitboard_size(uint32_t players);
+
+/**
+ * Tworzy pustą planszę bitową dla graczy o numerach od 1 do @p players
+ * w bloku pamięci @p memory o rozmiarze @ref bitboard_size. Plansza nie
+ * jest właścicielem tego bloku.
+ */
+bitboard_t bitboard_init(void *memory, uint32_t width, uint32_t height,
+                         uint32_t players);
+
+/**
+ * Kopiuje stan planszy bitowej @p src do planszy @p dst o tych samych
+ * parametrach.
+ */
+void bitboard_copy(bitboard_t dst, bitboard_t src);
+
+/**
+ * Wczytuje stan planszy bitowej z @p size bajtów spod adresu @p data,
+ * zapisanych wcześniej z planszy o tych samych parametrach. Zwraca false,
+ * gdy dane nie opisują planszy o parametrach planszy @p bb albo pola
+ * graczy nie są rozłącznymi zbiorami, których suma to zajęte pola planszy.
+ */
+bool bitboard_load(bitboard_t bb, const void *data, size_t size);
+
+/**
+ * Przywraca planszę bitową do stanu początkowego.
+ */
+void bitboard_reset(bitboard_t bb);
+
+/**
+ * Sprawdza, czy pole (x, y) sąsiaduje z jakimś polem gracza.
+ */
+bool bitboard_has_neighbour(bitboard_t bb, uint32_t x, uint32_t y,
+                            uint32_t player);
+
+/**
+ * Zwraca liczbę wolnych pól, które staną się sąsiednie z obszarami gracza,
+ * gdy zajmie on wolne pole (x, y).
+ */
+uint32_t bitboard_new_frontier(bitboard_t bb, uint32_t x, uint32_t y,
+                               uint32_t player);
+
+/**
+ * Zaznacza zajęcie wolnego pola (x, y) przez gracza.
+ */
+void bitboard_move(bitboard_t bb, uint32_t x, uint32_t y, uint32_t player);
+
+/**
+ * Wycofuje zajęcie pola (x, y) przez gracza.
+ */
+void bitboard_undo(bitboard_t bb, uint32_t x, uint32_t y, uint32_t player);
+
+/**
+ * Wyznacza pole o numerze @p n (licząc od zera, kolumnami) w zbiorze wolnych
+ * pól, gdy @p player ma wartość @p NO_PLAYER, lub w zbiorze wolnych pól
+ * sąsiadujących z obszarami gracza @p player. Zwraca false, gdy zbiór ma
+ * co najwyżej @p n pól.
+ */
+bool bitboard_select(bitboard_t bb, uint32_t player, uint64_t n,
+                     uint32_t *x, uint32_t *y);
+
+#endif /* BITBOARD_H */
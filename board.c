@@ -6,82 +6,615 @@
  */
 
 #include <assert.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bitboard.h"
 #include "board.h"
+#include "player.h"
+#include "rng.h"
 #include "safe_memory_allocation.h"
+#include "snapshot.h"
 #include "constants.h"
 
 /**
- * To jest struktura przechowująca pole planszy.
+ * Liczba bitów numeru pola w kafelku i numeru koloru na stronie kolorów.
  */
-typedef struct field {
-    uint32_t player;
-    char player_symbol;
-    uint64_t color;
-} field;
+#define BOARD_TILE_BITS 12
 
+/**
+ * Liczba pól kafelka i kolorów strony kolorów.
+ */
+#define BOARD_TILE_CELLS ((uint64_t)1 << BOARD_TILE_BITS)
+
+/**
+ * Liczba bitów boku kafelka. Kafelek jest kwadratem pól.
+ */
+#define BOARD_TILE_SIDE_BITS (BOARD_TILE_BITS / 2)
+
+/**
+ * Długość boku kafelka.
+ */
+#define BOARD_TILE_SIDE ((uint64_t)1 << BOARD_TILE_SIDE_BITS)
+
+/**
+ * Maska bitów wiersza w numerze pola kafelka w porządku Mortona (bity
+ * parzyste). Bity nieparzyste zawierają kolumnę.
+ */
+#define BOARD_MORTON_ROWS ((uint64_t)0x555)
+
+/**
+ * Maska bitów kolumny w numerze pola kafelka w porządku Mortona.
+ */
+#define BOARD_MORTON_COLUMNS (BOARD_MORTON_ROWS << 1)
+
+/**
+ * Numer gracza zapisywany w polach ramki otaczającej planszę. Jest większy
+ * od numeru każdego gracza, więc pole ramki nigdy nie jest wolne ani nie
+ * należy do gracza wykonującego ruch.
+ */
+#define BOARD_BORDER_PLAYER (MAX_NUMBER_OF_PLAYERS + 1)
+
+/**
+ * Kolor, którym rezerwacja ruchu chwilowo oznacza odwiedzone pola
+ * przekolorowywanego obszaru. Nie jest nigdy przydzielany obszarom.
+ */
+#define BOARD_MARK_COLOR UINT32_MAX
+
+/**
+ * To jest struktura przechowująca kafelek planszy: kwadrat
+ * @ref BOARD_TILE_SIDE na @ref BOARD_TILE_SIDE pól lub, dla kolejności
+ * @ref BOARD_ORDER_COLUMNS, kolejne pola planszy w porządku kolumnowym.
+ * Bit p maski sąsiadów pola jest ustawiony wtedy i tylko wtedy,
+ * gdy któreś z sąsiednich pól należy do gracza p. Plansza mieszcząca się
+ * w planszy bitowej nie przechowuje masek, więc jej kafelki kończą się
+ * przed tablicą @p neighbours.
+ */
+typedef struct board_tile {
+    atomic_uint_fast32_t references;  /* Liczba plansz używających kafelka. */
+    uint8_t players[BOARD_TILE_CELLS];
+    uint32_t areas[BOARD_TILE_CELLS];
+    uint64_t neighbours[BOARD_TILE_CELLS];
+} board_tile_t;
+
+/**
+ * To jest struktura przechowująca stronę kolorów. Kolor obszaru wskazuje
+ * w tablicy @p colors na siebie, a wolny kolor na kolejny kolor listy
+ * wolnych kolorów lub na @p NO_COLOR.
+ */
+typedef struct board_page {
+    atomic_uint_fast32_t references;  /* Liczba plansz używających strony. */
+    uint32_t colors[BOARD_TILE_CELLS];
+    uint64_t sizes[BOARD_TILE_CELLS];
+} board_page_t;
+
+/**
+ * Liczba odwołań zapisywana w kafelkach i stronach migawki. Jedno należy
+ * do planszy, a drugie do samej migawki, więc kafelek zmapowany z migawki
+ * nigdy nie jest uznawany za własny planszy i nigdy nie jest zwalniany.
+ */
+#define BOARD_SNAPSHOT_REFERENCES 2
+
+/**
+ * To jest struktura przechowująca nagłówek sekcji planszy w migawce.
+ * Przesunięcia są liczone od początku migawki. Tablice kafelków i stron
+ * zawierają przesunięcia kolejnych kafelków i stron albo zero dla
+ * nieprzydzielonych; kafelki i strony są zapisane po tablicach,
+ * w kolejności rosnących przesunięć.
+ */
+typedef struct board_snapshot {
+    uint32_t width;
+    uint32_t height;
+    uint32_t new_color;
+    uint32_t tile_cells;
+    uint32_t order;
+    uint32_t free_color;
+    uint64_t tile_size;
+    uint64_t page_size;
+    uint64_t tiles_count;
+    uint64_t pages_count;
+    uint64_t bits_offset;
+    uint64_t bits_size;
+    uint64_t tiles_offset;
+    uint64_t pages_offset;
+    uint64_t hash;
+} board_snapshot_t;
+
+/**
+ * To jest struktura przechowująca planszę. Pola są przechowywane
+ * w kwadratowych kafelkach, a kolory (obszary) i ich rozmiary w stronach.
+ * Symbol pola wynika z numeru gracza.
+ * Plansza jest otoczona ramką szerokości jednego pola, której pola należą
+ * do gracza @ref BOARD_BORDER_PLAYER. Dzięki temu każde pole planszy ma
+ * czterech sąsiadów i sąsiadów wyznacza się bez sprawdzania współrzędnych.
+ * Kafelki planszy z ramką są numerowane kolumnami, po @p tile_rows
+ * w kolumnie. Indeks pola składa się z numeru kafelka i numeru pola
+ * w kafelku (kolumnami albo w porządku Mortona), więc sąsiad leży o stałe
+ * przesunięcie (±1, ±@ref BOARD_TILE_SIDE) albo o krok w bitach wiersza
+ * lub kolumny numeru Mortona, do którego na brzegu kafelka dochodzi
+ * przeniesienie do sąsiedniego kafelka. W kolejności
+ * @ref BOARD_ORDER_COLUMNS indeks pola jest jego numerem w porządku
+ * kolumnowym, a sąsiad leży o ±1 lub ±@p stride.
+ * Kafelki i strony są przydzielane przy pierwszym zapisie; brak kafelka
+ * oznacza same wolne pola, więc pamięć rośnie z obszarem, na którym toczy
+ * się gra, a nie z rozmiarem planszy. Kopie planszy współdzielą kafelki i strony,
+ * a plansza, która chce zmienić współdzielony kafelek lub stronę, najpierw
+ * tworzy ich własną kopię. Dlatego każdy zapis musi być poprzedzony
+ * rezerwacją (@ref board_reserve_move, @ref board_reserve_undo), która
+ * zapewnia, że zmieniane kafelki i strony należą tylko do tej planszy.
+ * Każde zajęte pole ma kolor swojego obszaru. Ruch łączący obszary
+ * przekolorowuje pola mniejszych z nich na kolor największego,
+ * przeszukując je od pól sąsiednich, a kolory połączonych obszarów
+ * trafiają na listę wolnych kolorów. Nowy obszar dostaje najpierw kolor
+ * z tej listy, więc strony kolorów rosną wraz z największą liczbą obszarów
+ * istniejących naraz, a nie z liczbą ruchów ani rozmiarem planszy.
+ * Struktura, plansza bitowa i tablice wskaźników na kafelki i strony leżą
+ * w jednym bloku pamięci.
+ * Plansza mieszcząca się w planszy bitowej nie ma masek sąsiadów:
+ * sąsiedztwo obszarów gracza wyznacza się wtedy operacjami na kolumnach
+ * planszy bitowej.
+ */
 struct board {
     uint32_t width;
     uint32_t height;
-    uint64_t new_color;
-    field** fields;
-    uint64_t* colors;
+    uint32_t new_color;  /* Największy przydzielony kolor. */
+    uint32_t free_color; /* Początek listy wolnych kolorów lub NO_COLOR. */
+    uint32_t colors_capacity;
+    board_order_t order;
+    uint64_t stride;      /* Liczba pól kolumny planszy z ramką. */
+    uint64_t tile_rows;   /* Liczba kafelków w kolumnie kafelków. */
+    int64_t steps[DIRECTIONS];   /* Przesunięcia indeksów sąsiadów. */
+    uint64_t masks[DIRECTIONS];  /* Bity indeksu zmieniane przez krok. */
+    uint64_t edges[DIRECTIONS];  /* Wartości tych bitów na brzegu kafelka. */
+    int64_t carries[DIRECTIONS]; /* Przeniesienia na brzegach kafelków. */
+    uint64_t hash;        /* Skrót Zobrista zajętych pól. */
+    bitboard_t bits;      /* Plansza bitowa lub NULL. */
+    board_tile_t** tiles; /* Kafelki pól lub NULL dla pustych kafelków. */
+    board_page_t** pages; /* Strony kolorów lub NULL. */
+    uint64_t tiles_count;
+    uint64_t pages_count;
+    size_t tile_size;     /* Liczba używanych bajtów kafelka. */
+    bool rollback;          /* Czy ruchy można wycofywać. */
+    board_undo_t* record;   /* Opis wykonywanego ruchu lub NULL. */
+    board_stats_t* stats;   /* Statystyki przekolorowywania lub NULL. */
+    uint64_t* stack;        /* Stos przeszukiwania obszaru lub NULL. */
+    uint64_t stack_capacity;
 };
 
 /**
- * To jest struktura przechowująca parę współrzędnych.
+ * Wyrównanie części bloku pamięci planszy (rozmiar linii pamięci
+ * podręcznej).
+ */
+#define BOARD_ALIGNMENT 64
+
+/**
+ * To jest struktura opisująca położenie części planszy w jej bloku pamięci.
  */
-typedef struct coordinates_t {
-    int64_t x;
-    int64_t y;
-} coordinates_t;
+typedef struct board_layout {
+    size_t bits;
+    size_t tiles;
+    size_t pages;
+    size_t size;
+    uint64_t tiles_count;
+    uint64_t pages_count;
+    uint32_t colors_capacity;
+} board_layout_t;
 
 /* FUNKCJE POMOCNICZE */
 
 /**
- * Zwalnia pamięć zajmowaną przez pola planszy.
+ * Zwraca liczbę pól planszy.
+ */
+static uint64_t board_cells(uint32_t width, uint32_t height) {
+    return (uint64_t)width * (uint64_t)height;
+}
+
+/**
+ * Zwraca liczbę kafelków potrzebnych na @p length kolejnych kolumn lub
+ * wierszy planszy razem z ramką.
  */
-static void board_free_fields(field** fields, uint32_t width) {
-	for (uint32_t i = 0; i < width; i++) {
-		free(fields[i]);
-	}
-	free(fields);
+static uint64_t board_tile_span(uint32_t length) {
+    return ((uint64_t)length + 2 + BOARD_TILE_SIDE - 1) >> BOARD_TILE_SIDE_BITS;
 }
 
 /**
- * Tworzy tablicę pól planszy.
+ * Zaokrągla rozmiar w górę do wielokrotności wyrównania.
  */
-static field** board_new_fields(uint32_t width, uint32_t height) {
-	field** fields = safe_calloc(width, sizeof(field*));
-	if (fields != NULL) {
-		for (uint32_t i = 0; i < width; i++) {
-			fields[i] = safe_calloc(height, sizeof(field));
-			if (fields[i] == NULL) {
-				board_free_fields(fields, i);
-				return NULL;
-			}
-		}
-	}
-	return fields;
+static size_t board_align(size_t size) {
+    return (size + BOARD_ALIGNMENT - 1) & ~(size_t)(BOARD_ALIGNMENT - 1);
 }
 
 /**
- * Ustawia parametry planszy.
+ * Zwraca liczbę kafelków lub stron potrzebnych na @p count pól lub kolorów.
  */
-static void board_set_parameters(board_t b, uint32_t width, uint32_t height) {
-	assert(b != NULL);
+static uint64_t board_tiles(uint64_t count) {
+    return (count + BOARD_TILE_CELLS - 1) >> BOARD_TILE_BITS;
+}
 
-	b->width = width;
-	b->height = height;
-	b->new_color = 0;
-	b->colors = safe_malloc(((uint64_t)width * (uint64_t)height + 1) * sizeof(uint64_t));
-	if (b->colors != NULL) {
-		b->fields = board_new_fields(width, height);
-		if (b->fields == NULL) {
-			free(b->colors);
-		}
-	}
+/**
+ * Wyznacza położenie części planszy o zadanych wymiarach w jej bloku
+ * pamięci. Kolorów może być co najwyżej o jeden więcej niż pól.
+ */
+static board_layout_t board_layout(uint32_t width, uint32_t height,
+                                   board_order_t order) {
+    uint64_t cells = board_cells(width, height);
+    board_layout_t layout;
+    layout.colors_capacity = cells < UINT32_MAX ? (uint32_t)cells + 1
+                                                : UINT32_MAX;
+    if (order == BOARD_ORDER_COLUMNS) {
+        layout.tiles_count = board_tiles(((uint64_t)width + 2)
+                                         * ((uint64_t)height + 2));
+    }
+    else {
+        layout.tiles_count = board_tile_span(width) * board_tile_span(height);
+    }
+    layout.pages_count = board_tiles(layout.colors_capacity);
+    layout.bits = board_align(sizeof(struct board));
+    layout.tiles = layout.bits;
+    if (bitboard_fits(width, height)) {
+        layout.tiles += board_align(bitboard_size(MAX_NUMBER_OF_PLAYERS));
+    }
+    layout.pages = layout.tiles
+                   + board_align(layout.tiles_count * sizeof(board_tile_t*));
+    layout.size = layout.pages + layout.pages_count * sizeof(board_page_t*);
+    return layout;
+}
+
+/* KAFELKI I STRONY */
+
+/**
+ * Zwraca licznik odwołań kafelka lub strony wskazywanych przez @p object.
+ */
+static atomic_uint_fast32_t* shared_references(void const* object) {
+    return (atomic_uint_fast32_t*)object;
+}
+
+/**
+ * Sprawdza, czy kafelek lub strona należą tylko do jednej planszy.
+ */
+static bool shared_owned(void const* object) {
+    return object != NULL
+           && atomic_load_explicit(shared_references(object),
+                                   memory_order_acquire) == 1;
+}
+
+/**
+ * Dolicza odwołanie do kafelka lub strony, o ile nie są NULL.
+ */
+static void shared_acquire(void* object) {
+    if (object != NULL) {
+        atomic_fetch_add_explicit(shared_references(object), 1,
+                                  memory_order_relaxed);
+    }
+}
+
+/**
+ * Usuwa odwołanie do kafelka lub strony i zwalnia je, gdy było ostatnie.
+ */
+static void shared_release(void* object) {
+    if (object != NULL
+        && atomic_fetch_sub_explicit(shared_references(object), 1,
+                                     memory_order_acq_rel) == 1) {
+        free(object);
+    }
+}
+
+/**
+ * Zwraca część rozmiaru @p size kafelka lub strony przypadającą na jedną
+ * używającą ich planszę.
+ */
+static uint64_t shared_memory(void const* object, size_t size) {
+    if (object == NULL) {
+        return 0;
+    }
+    return size / atomic_load_explicit(shared_references(object),
+                                       memory_order_relaxed);
+}
+
+/**
+ * Tworzy kafelek lub stronę o rozmiarze @p size, należące tylko do
+ * wywołującej planszy: kopię obiektu @p object lub obiekt wyzerowany, gdy
+ * @p object jest NULL. Zwalnia odwołanie do @p object. Zwraca NULL, gdy nie
+ * udało się alokować pamięci; @p object pozostaje wtedy bez zmian.
+ */
+static void* shared_unshare(void* object, size_t size) {
+    void* copy = safe_malloc(size);
+    if (copy == NULL) {
+        return NULL;
+    }
+    if (object != NULL) {
+        size_t header = sizeof(atomic_uint_fast32_t);
+        memcpy((char*)copy + header, (char*)object + header, size - header);
+        shared_release(object);
+    }
+    else {
+        memset(copy, 0, size);
+    }
+    atomic_init(shared_references(copy), 1);
+    return copy;
+}
+
+/**
+ * Rozsuwa bity liczby mniejszej od @ref BOARD_TILE_SIDE na pozycje
+ * parzyste.
+ */
+static uint64_t morton_spread(uint64_t value) {
+    value = (value | value << 4) & 0x0F0F;
+    value = (value | value << 2) & 0x3333;
+    value = (value | value << 1) & 0x5555;
+    return value;
+}
+
+/**
+ * Składa bity parzyste liczby w liczbę mniejszą od @ref BOARD_TILE_SIDE;
+ * odwrotność @ref morton_spread.
+ */
+static uint64_t morton_compact(uint64_t value) {
+    value &= 0x5555;
+    value = (value | value >> 1) & 0x3333;
+    value = (value | value >> 2) & 0x0F0F;
+    value = (value | value >> 4) & 0x00FF;
+    return value;
+}
+
+/**
+ * Zwraca numer pola w kafelku kwadratowym, gdy pole leży w kolumnie
+ * @p column i wierszu @p row kafelka.
+ */
+static uint64_t tile_cell(board_t b, uint64_t column, uint64_t row) {
+    if (b->order == BOARD_ORDER_MORTON) {
+        return morton_spread(row) | morton_spread(column) << 1;
+    }
+    return column << BOARD_TILE_SIDE_BITS | row;
+}
+
+/**
+ * Zapisuje gracza @ref BOARD_BORDER_PLAYER w polach ramki leżących
+ * w kafelku @p tile o numerze @p number.
+ */
+static void board_mark_border(board_t b, board_tile_t* tile, uint64_t number) {
+    if (b->order == BOARD_ORDER_COLUMNS) {
+        uint64_t first = number << BOARD_TILE_BITS;
+        for (uint64_t i = 0; i < BOARD_TILE_CELLS; i++) {
+            uint64_t x = (first + i) / b->stride;
+            uint64_t y = (first + i) % b->stride;
+            if (x == 0 || x > b->width || y == 0 || y > b->height) {
+                tile->players[i] = BOARD_BORDER_PLAYER;
+            }
+        }
+        return;
+    }
+    uint64_t left = number / b->tile_rows << BOARD_TILE_SIDE_BITS;
+    uint64_t bottom = number % b->tile_rows << BOARD_TILE_SIDE_BITS;
+    for (uint64_t i = 0; i < BOARD_TILE_SIDE; i++) {
+        for (uint64_t j = 0; j < BOARD_TILE_SIDE; j++) {
+            uint64_t x = left + i;
+            uint64_t y = bottom + j;
+            if (x == 0 || x > b->width || y == 0 || y > b->height) {
+                tile->players[tile_cell(b, i, j)] = BOARD_BORDER_PLAYER;
+            }
+        }
+    }
+}
+
+/**
+ * Zapewnia, że kafelek zawierający pole o indeksie @p index należy tylko
+ * do planszy. Nowy kafelek dostaje pola ramki.
+ * Zwraca false, gdy nie udało się alokować pamięci.
+ */
+static bool board_claim_tile(board_t b, uint64_t index) {
+    board_tile_t** slot = &b->tiles[index >> BOARD_TILE_BITS];
+    if (shared_owned(*slot)) {
+        return true;
+    }
+    bool empty = *slot == NULL;
+    board_tile_t* tile = shared_unshare(*slot, b->tile_size);
+    if (tile == NULL) {
+        return false;
+    }
+    if (empty) {
+        board_mark_border(b, tile, index >> BOARD_TILE_BITS);
+    }
+    *slot = tile;
+    return true;
+}
+
+/**
+ * Zapewnia, że strona zawierająca kolor @p color należy tylko do planszy.
+ * Zwraca false, gdy nie udało się alokować pamięci.
+ */
+static bool board_claim_page(board_t b, uint32_t color) {
+    board_page_t** slot = &b->pages[color >> BOARD_TILE_BITS];
+    if (shared_owned(*slot)) {
+        return true;
+    }
+    board_page_t* page = shared_unshare(*slot, sizeof(board_page_t));
+    if (page == NULL) {
+        return false;
+    }
+    *slot = page;
+    return true;
+}
+
+/**
+ * Zwraca numer pola o indeksie @p index w jego kafelku lub numer koloru
+ * na jego stronie.
+ */
+static uint64_t tile_offset(uint64_t index) {
+    return index & (BOARD_TILE_CELLS - 1);
+}
+
+/**
+ * Zwraca kafelek zawierający pole o indeksie @p index lub NULL.
+ */
+static board_tile_t* board_tile(board_t b, uint64_t index) {
+    return b->tiles[index >> BOARD_TILE_BITS];
+}
+
+/**
+ * Zwraca kafelek zawierający pole o indeksie @p index, do którego plansza
+ * może pisać.
+ */
+static board_tile_t* board_writable_tile(board_t b, uint64_t index) {
+    board_tile_t* tile = board_tile(b, index);
+    assert(shared_owned(tile));
+    return tile;
+}
+
+/**
+ * Zwraca stronę zawierającą kolor @p color.
+ */
+static board_page_t* board_page(board_t b, uint32_t color) {
+    board_page_t* page = b->pages[color >> BOARD_TILE_BITS];
+    assert(page != NULL);
+    return page;
+}
+
+/**
+ * Zwraca stronę zawierającą kolor @p color, do której plansza może pisać.
+ */
+static board_page_t* board_writable_page(board_t b, uint32_t color) {
+    board_page_t* page = board_page(b, color);
+    assert(shared_owned(page));
+    return page;
+}
+
+/**
+ * Zwraca wpis koloru w tablicy kolorów: sam kolor, gdy należy do obszaru,
+ * lub kolejny wolny kolor.
+ */
+static uint32_t color_link(board_t b, uint32_t color) {
+    return board_page(b, color)->colors[tile_offset(color)];
+}
+
+/**
+ * Zwraca rozmiar obszaru o kolorze @p color.
+ */
+static uint64_t area_size(board_t b, uint32_t color) {
+    return board_page(b, color)->sizes[tile_offset(color)];
+}
+
+/**
+ * Zwraca adres rozmiaru obszaru o kolorze @p color, do którego plansza
+ * może pisać.
+ */
+static uint64_t* color_size(board_t b, uint32_t color) {
+    return &board_writable_page(b, color)->sizes[tile_offset(color)];
+}
+
+/**
+ * Wyznacza nagłówek sekcji planszy w migawce zaczynającej się
+ * w przesunięciu @p offset. Zwraca przesunięcie pierwszego kafelka.
+ */
+static uint64_t board_snapshot_layout(board_t b, uint64_t offset,
+                                      board_snapshot_t* s) {
+    memset(s, 0, sizeof(board_snapshot_t));
+    s->width = b->width;
+    s->height = b->height;
+    s->new_color = b->new_color;
+    s->free_color = b->free_color;
+    s->tile_cells = BOARD_TILE_CELLS;
+    s->order = b->order;
+    s->tile_size = b->tile_size;
+    s->page_size = sizeof(board_page_t);
+    s->tiles_count = b->tiles_count;
+    s->pages_count = b->pages_count;
+    s->hash = b->hash;
+    offset = snapshot_align(offset + sizeof(board_snapshot_t));
+    if (b->bits != NULL) {
+        s->bits_offset = offset;
+        s->bits_size = bitboard_size(MAX_NUMBER_OF_PLAYERS);
+        offset = snapshot_align(offset + s->bits_size);
+    }
+    s->tiles_offset = offset;
+    offset = snapshot_align(offset + s->tiles_count * sizeof(uint64_t));
+    s->pages_offset = offset;
+    return snapshot_align(offset + s->pages_count * sizeof(uint64_t));
+}
+
+/**
+ * Zapisuje tablicę przesunięć @p count kafelków lub stron o rozmiarze
+ * @p size, zaczynając od przesunięcia @p *offset, które przesuwa za nie.
+ */
+static bool board_save_index(snapshot_writer_t* w, void* const* objects,
+                             uint64_t count, size_t size, uint64_t* offset) {
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t position = 0;
+        if (objects[i] != NULL) {
+            position = *offset;
+            *offset = snapshot_align(*offset + size);
+        }
+        if (!snapshot_write(w, &position, sizeof(position))) {
+            return false;
+        }
+    }
+    return snapshot_write_padding(w);
+}
+
+/**
+ * Zapisuje @p count kafelków lub stron o rozmiarze @p size. Zamiast
+ * bieżącej liczby odwołań zapisuje @ref BOARD_SNAPSHOT_REFERENCES.
+ */
+static bool board_save_objects(snapshot_writer_t* w, void* const* objects,
+                               uint64_t count, size_t size) {
+    size_t header = sizeof(atomic_uint_fast32_t);
+    uint_fast32_t references = BOARD_SNAPSHOT_REFERENCES;
+    for (uint64_t i = 0; i < count; i++) {
+        if (objects[i] != NULL
+            && (!snapshot_write(w, &references, header)
+                || !snapshot_write(w, (char*)objects[i] + header, size - header)
+                || !snapshot_write_padding(w))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Ustawia kafelki lub strony planszy na @p count obiektów o rozmiarze
+ * @p size z migawki @p data o rozmiarze @p total, opisanych tablicą
+ * przesunięć zaczynającą się w @p index_offset. Obiekty muszą leżeć za
+ * przesunięciem @p *end, w kolejności rosnących przesunięć, i mieć
+ * @ref BOARD_SNAPSHOT_REFERENCES odwołań. Przesuwa @p *end za ostatni
+ * z nich.
+ */
+static bool board_load_objects(const char* data, uint64_t total,
+                               uint64_t index_offset, void** objects,
+                               uint64_t count, size_t size, uint64_t* end) {
+    if (!snapshot_section_correct(index_offset, count * sizeof(uint64_t),
+                                  total)) {
+        return false;
+    }
+    const uint64_t* index = (const uint64_t*)(data + index_offset);
+    for (uint64_t i = 0; i < count; i++) {
+        if (index[i] == 0) {
+            continue;
+        }
+        if (index[i] < *end || !snapshot_section_correct(index[i], size, total)
+            || atomic_load(shared_references(data + index[i]))
+               != BOARD_SNAPSHOT_REFERENCES) {
+            return false;
+        }
+        objects[i] = (void*)(data + index[i]);
+        *end = index[i] + size;
+    }
+    return true;
+}
+
+/**
+ * Zwalnia wszystkie kafelki i strony planszy.
+ */
+static void board_release_tiles(board_t b) {
+    for (uint64_t i = 0; i < b->tiles_count; i++) {
+        shared_release(b->tiles[i]);
+        b->tiles[i] = NULL;
+    }
+    for (uint64_t i = 0; i < b->pages_count; i++) {
+        shared_release(b->pages[i]);
+        b->pages[i] = NULL;
+    }
 }
 
 /**
@@ -102,344 +635,1013 @@ bool board_field_correct(board_t b, uint32_t x, uint32_t y) {
 /* COORDINATES FUNCTIONS */
 
 /**
- * Sprawdza, czy współrzędne są poprawne.
+ * Zwraca indeks pola (x, y) w tablicach pól.
  */
-static bool coordinates_correct(board_t b, coordinates_t c) {
-    return b != NULL
-           && c.x < b->width && c.y < b->height && c.x >= 0 && c.y >= 0;
+static uint64_t coordinates_index(board_t b, uint32_t x, uint32_t y) {
+    uint64_t column = (uint64_t)x + 1;
+    uint64_t row = (uint64_t)y + 1;
+    if (b->order == BOARD_ORDER_COLUMNS) {
+        return column * b->stride + row;
+    }
+    uint64_t tile = (column >> BOARD_TILE_SIDE_BITS) * b->tile_rows
+                    + (row >> BOARD_TILE_SIDE_BITS);
+    return tile << BOARD_TILE_BITS
+           | tile_cell(b, column & (BOARD_TILE_SIDE - 1),
+                       row & (BOARD_TILE_SIDE - 1));
 }
 
 /**
- * Zwraca współrzędne pola (x, y)
+ * Wyznacza kolumnę i wiersz planszy z ramką pola o indeksie @p index;
+ * odwrotność @ref coordinates_index.
  */
-static coordinates_t coordinates(uint32_t x, uint32_t y) {
-    return (coordinates_t) {.x = x, .y = y};
+static void index_coordinates(board_t b, uint64_t index, uint64_t *column,
+                              uint64_t *row) {
+    if (b->order == BOARD_ORDER_COLUMNS) {
+        *column = index / b->stride;
+        *row = index % b->stride;
+        return;
+    }
+    uint64_t tile = index >> BOARD_TILE_BITS;
+    uint64_t cell = tile_offset(index);
+    uint64_t tile_column, tile_row;
+    if (b->order == BOARD_ORDER_MORTON) {
+        tile_column = morton_compact(cell >> 1);
+        tile_row = morton_compact(cell);
+    }
+    else {
+        tile_column = cell >> BOARD_TILE_SIDE_BITS;
+        tile_row = cell & (BOARD_TILE_SIDE - 1);
+    }
+    *column = (tile / b->tile_rows) << BOARD_TILE_SIDE_BITS | tile_column;
+    *row = (tile % b->tile_rows) << BOARD_TILE_SIDE_BITS | tile_row;
 }
 
 /**
- * Sprawdza, czy współrzędne pola o jeden w górę.
+ * Zwraca indeks pola sąsiadującego z polem o indeksie @p index w zadanym
+ * kierunku (w górę, w prawo, w dół lub w lewo). Dla pola planszy jest to
+ * zawsze pole planszy lub ramki. W porządku Mortona krok zmienia tylko
+ * bity wiersza lub kolumny: przy zwiększaniu pozostałe bity są ustawiane,
+ * żeby przeniesienie przeszło przez nie, a przy zmniejszaniu są zerowane.
  */
-static coordinates_t up_coordinates(coordinates_t c) {
-    c.y++;
-    return c;
+static uint64_t neighbour_index(board_t b, uint64_t index, uint32_t direction) {
+    uint64_t mask = b->masks[direction];
+    uint64_t carry = (index & mask) == b->edges[direction]
+                     ? (uint64_t)b->carries[direction] : 0;
+    if (b->order == BOARD_ORDER_MORTON) {
+        uint64_t lane = direction < DIRECTIONS / 2 ? (index | ~mask) + 1
+                                                   : (index & mask) - 1;
+        return ((index & ~mask) | (lane & mask)) + carry;
+    }
+    return index + (uint64_t)b->steps[direction] + carry;
 }
 
 /**
- * Sprawdza, czy współrzędne pola o jeden w dół.
+ * Zwraca numer gracza pola o indeksie @p index. Pola ramki w pustych
+ * kafelkach są traktowane jak wolne, więc wynik dla pola ramki jest
+ * @p NO_PLAYER lub @ref BOARD_BORDER_PLAYER.
  */
-static coordinates_t down_coordinates(coordinates_t c) {
-    c.y--;
-    return c;
+static uint32_t index_player(board_t b, uint64_t index) {
+    board_tile_t* tile = board_tile(b, index);
+    return tile != NULL ? tile->players[tile_offset(index)] : NO_PLAYER;
 }
 
 /**
- * Sprawdza, czy współrzędne pola o jeden na lewo.
+ * Zwraca kolor pola o indeksie @p index.
  */
-static coordinates_t left_coordinates(coordinates_t c) {
-    c.x--;
-    return c;
+static uint32_t index_color(board_t b, uint64_t index) {
+    board_tile_t* tile = board_tile(b, index);
+    return tile != NULL ? tile->areas[tile_offset(index)] : NO_COLOR;
 }
 
 /**
- * Sprawdza, czy współrzędne pola o jeden na prawo.
+ * Zwraca maskę z ustawionym bitem zadanego gracza.
  */
-static coordinates_t right_coordinates(coordinates_t c) {
-    c.x++;
-    return c;
+static uint64_t player_bit(uint32_t player) {
+    return (uint64_t)1 << player;
 }
 
 /**
- * Sprawdza, czy współrzędne pola sąsiedniego w zadanym kierunku.
+ * Zwraca maskę graczy sąsiadujących z polem o indeksie @p index.
  */
-static coordinates_t neighbour_coordinates(coordinates_t c, uint32_t direction) {
-    switch (direction) {
-        case 0:
-            return up_coordinates(c);
-        case 1:
-            return right_coordinates(c);
-        case 2:
-            return down_coordinates(c);
-        case 3:
-            return left_coordinates(c);
-        default:
-            assert(false);
-            return c;
+static uint64_t index_neighbours(board_t b, uint64_t index) {
+    if (b->bits == NULL) {
+        board_tile_t* tile = board_tile(b, index);
+        return tile != NULL ? tile->neighbours[tile_offset(index)] : 0;
     }
+    uint64_t players = 0;
+    for (uint32_t i = 0; i < DIRECTIONS; i++) {
+        players |= player_bit(index_player(b, neighbour_index(b, index, i)));
+    }
+    return players & ~(player_bit(NO_PLAYER) | player_bit(BOARD_BORDER_PLAYER));
 }
 
 /**
- * Zwraca symbol pola o zadanych współrzędnych.
+ * Dodaje gracza do maski sąsiadów pola o numerze @p offset w kafelku
+ * @p tile. Zwraca true, jeśli wcześniej pole nie sąsiadowało z żadnym polem
+ * gracza.
  */
-static char coordinates_symbol(board_t b, coordinates_t c) {
-    if (!coordinates_correct(b, c)) {
-        return NONEXISTENT_FIELD_SYMBOL;
-    }
-    if (b->fields[c.x][c.y].player == NO_PLAYER) {
-        return EMPTY_FIELD_SYMBOL;
-    }
-    return b->fields[c.x][c.y].player_symbol;
+static bool add_neighbour_player(board_tile_t* tile, uint64_t offset,
+                                 uint32_t player) {
+    uint64_t bit = player_bit(player);
+    bool added = (tile->neighbours[offset] & bit) == 0;
+    tile->neighbours[offset] |= bit;
+    return added;
 }
 
 /**
- * Zwraca numer gracza pola o zadanych współrzędnych.
+ * Usuwa gracza z maski sąsiadów pola o indeksie @p index.
  */
-static uint32_t coordinates_player(board_t b, coordinates_t c) {
-    return coordinates_correct(b, c) ? b->fields[c.x][c.y].player : NO_PLAYER;
+static void remove_neighbour_player(board_t b, uint64_t index,
+                                    uint32_t player) {
+    board_writable_tile(b, index)->neighbours[tile_offset(index)]
+        &= ~player_bit(player);
+}
+
+/* END OF COORDINATES FUNCTIONS */
+
+static uint32_t board_get_player(board_t b, uint32_t x, uint32_t y) {
+    return index_player(b, coordinates_index(b, x, y));
 }
 
 /**
- * Zwraca kolor pola o zadanych współrzędnych.
+ * Zwraca słowo 64-bitowe, którego każdy bajt ma wartość @p byte.
  */
-static uint64_t coordinates_color(board_t b, coordinates_t c) {
-    return coordinates_correct(b, c) ? b->fields[c.x][c.y].color : NO_COLOR;
+static uint64_t repeat_byte(uint8_t byte) {
+    return (uint64_t)0x0101010101010101 * byte;
 }
 
 /**
- * Sprawdza czy pola są tego samego gracza.
+ * Zamienia numery graczy zapisane w @p length bajtach bufora na ich symbole
+ * (jak @ref player_symbol). Przetwarza po osiem bajtów w słowie 64-bitowym:
+ * numer gracza jest mniejszy od 64, więc dodawanie stałej do każdego bajtu
+ * nie przenosi się do sąsiedniego bajtu, a najstarszy bit sumy mówi, czy
+ * numer przekroczył próg.
  */
-static bool are_same_player(board_t b, coordinates_t c1, coordinates_t c2) {
-    return coordinates_player(b, c1) == coordinates_player(b, c2);
+static void players_to_symbols(char* buffer, uint64_t length) {
+    uint64_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t players;
+        memcpy(&players, buffer + i, sizeof(players));
+        uint64_t high = repeat_byte(0x80);
+        uint64_t letters = ((players + repeat_byte(0x80 - 10)) & high) >> 7;
+        uint64_t taken = ((players + repeat_byte(0x7F)) & high) >> 7;
+        uint64_t symbols = players + repeat_byte('0')
+                           + letters * ('A' - '0' - 10);
+        uint64_t mask = taken * 0xFF;
+        symbols = (symbols & mask)
+                  | (repeat_byte(EMPTY_FIELD_SYMBOL) & ~mask);
+        memcpy(buffer + i, &symbols, sizeof(symbols));
+    }
+    for (; i < length; i++) {
+        buffer[i] = player_symbol((unsigned char)buffer[i]);
+    }
 }
 
 /**
- * Sprawdza czy pola są tego samego symbolu.
+ * Zwraca klucz Zobrista pola (x, y) zajętego przez gracza @p player.
+ * Klucze nie są przechowywane, tylko wyliczane z współrzędnych dwoma
+ * krokami splitmix64, więc nie zajmują pamięci nawet na ogromnej planszy
+ * i nie zależą od kolejności pól w pamięci.
  */
-static bool are_same_symbol(board_t b, coordinates_t c1, coordinates_t c2) {
-    return coordinates_symbol(b, c1) == coordinates_symbol(b, c2);
+static uint64_t zobrist_key(uint32_t x, uint32_t y, uint32_t player) {
+    uint64_t state = (uint64_t)x << 32 | y;
+    state = rng_splitmix(&state) + player;
+    return rng_splitmix(&state);
 }
 
 /**
- * Sprawdza czy pola są sąsiednie.
+ * To jest struktura opisująca różne obszary gracza sąsiadujące z polem.
+ */
+typedef struct board_areas {
+    uint32_t count;
+    uint32_t largest;                 /* Numer największego z obszarów. */
+    uint32_t colors[DIRECTIONS];
+    uint32_t directions[DIRECTIONS];  /* Kierunek sąsiada z obszaru. */
+} board_areas_t;
+
+/**
+ * Wyznacza różne obszary gracza @p player sąsiadujące z polem o indeksie
+ * @p field, w kolejności kierunków ich pierwszych sąsiadów, i największy
+ * z nich (pierwszy z równych).
  */
-static bool are_neighbours(coordinates_t c1, coordinates_t c2) {
-    return (c1.x == c2.x && labs(c1.y - c2.y) == 1)
-           || (c1.y == c2.y && labs(c1.x - c2.x) == 1);
+static void board_neighbour_areas(board_t b, uint64_t field, uint32_t player,
+                                  board_areas_t* areas) {
+    areas->count = 0;
+    areas->largest = 0;
+    for (uint32_t i = 0; i < DIRECTIONS; i++) {
+        uint64_t index = neighbour_index(b, field, i);
+        if (index_player(b, index) != player) {
+            continue;
+        }
+        uint32_t color = index_color(b, index);
+        uint32_t j = 0;
+        while (j < areas->count && areas->colors[j] != color) {
+            j++;
+        }
+        if (j == areas->count) {
+            areas->colors[j] = color;
+            areas->directions[j] = i;
+            uint32_t largest = areas->colors[areas->largest];
+            if (area_size(b, color) > area_size(b, largest)) {
+                areas->largest = j;
+            }
+            areas->count++;
+        }
+    }
 }
 
 /**
- * Sprawdza czy pole jest wolne.
+ * Zapewnia, że stos przeszukiwania obszaru mieści @p cells pól.
+ * Zwraca false, gdy nie udało się alokować pamięci.
  */
-static bool coordinates_free(board_t b, coordinates_t c) {
-    return coordinates_symbol(b, c) == EMPTY_FIELD_SYMBOL;
+static bool board_reserve_stack(board_t b, uint64_t cells) {
+    if (cells <= b->stack_capacity) {
+        return true;
+    }
+    uint64_t capacity = b->stack_capacity > 0 ? b->stack_capacity : 64;
+    while (capacity < cells) {
+        capacity *= 2;
+    }
+    uint64_t* stack = safe_realloc(b->stack, capacity * sizeof(uint64_t));
+    if (stack == NULL) {
+        return false;
+    }
+    b->stack = stack;
+    b->stack_capacity = capacity;
+    return true;
 }
 
 /**
- * Sprawdza czy pole ma sąsiada o zadanym symbolu.
+ * Nadaje kolor @p to polom gracza @p player o kolorze @p from połączonym
+ * z polem o indeksie @p start (które ma kolor @p from), z pominięciem pola
+ * o indeksie @p barrier. Gdy @p claim jest true, przed zmianą pola
+ * zapewnia, że jego kafelek należy tylko do planszy, i kończy się
+ * porażką, gdy nie udało się alokować pamięci; kolor @p to mają wtedy pola
+ * połączone z polem @p start, które zdążyły go dostać. Stos musi mieścić
+ * wszystkie pola o kolorze @p from. Zapisuje pod @p cells liczbę
+ * zmienionych pól i zwraca false tylko przy błędzie alokacji.
  */
-static bool has_neighbour_with_symbol(board_t b, coordinates_t c, char symbol) {
-    if (!coordinates_correct(b, c)) {
+static bool board_flood(board_t b, uint64_t start, uint64_t barrier,
+                        uint32_t player, uint32_t from, uint32_t to,
+                        bool claim, uint64_t* cells) {
+    uint64_t top = 0;
+    *cells = 0;
+    if (claim && !board_claim_tile(b, start)) {
         return false;
     }
-    for (uint32_t i = 0; i < DIRECTIONS; i++) {
-        coordinates_t neighbour = neighbour_coordinates(c, i);
-        if (coordinates_symbol(b, neighbour) == symbol) {
-            return true;
+    board_writable_tile(b, start)->areas[tile_offset(start)] = to;
+    b->stack[top++] = start;
+    while (top > 0) {
+        uint64_t index = b->stack[--top];
+        (*cells)++;
+        for (uint32_t i = 0; i < DIRECTIONS; i++) {
+            uint64_t next = neighbour_index(b, index, i);
+            if (next == barrier || index_player(b, next) != player
+                || index_color(b, next) != from) {
+                continue;
+            }
+            if (claim && !board_claim_tile(b, next)) {
+                return false;
+            }
+            assert(top < b->stack_capacity);
+            board_writable_tile(b, next)->areas[tile_offset(next)] = to;
+            b->stack[top++] = next;
         }
     }
-    return false;
+    return true;
 }
 
-/* END OF COORDINATES FUNCTIONS */
+/**
+ * Zapewnia, że kafelki pól gracza @p player o kolorze @p color połączonych
+ * z polem o indeksie @p start, z pominięciem pola o indeksie @p barrier,
+ * należą tylko do planszy. Oznacza te pola kolorem
+ * @ref BOARD_MARK_COLOR, a potem przywraca im kolor @p color, więc stan
+ * planszy się nie zmienia. Zwraca false, gdy nie udało się alokować
+ * pamięci.
+ */
+static bool board_claim_area(board_t b, uint64_t start, uint64_t barrier,
+                             uint32_t player, uint32_t color) {
+    uint64_t cells;
+    if (!board_claim_tile(b, start)) {
+        return false;
+    }
+    bool claimed = board_flood(b, start, barrier, player, color,
+                               BOARD_MARK_COLOR, true, &cells);
+    board_flood(b, start, barrier, player, BOARD_MARK_COLOR, color, false,
+                &cells);
+    return claimed;
+}
 
-static uint32_t board_get_player(board_t b, uint32_t x, uint32_t y) {
-    return coordinates_player(b, coordinates(x, y));
+/**
+ * Przekolorowuje na kolor @p to pola gracza @p player o kolorze @p from
+ * połączone z polem o indeksie @p start, z pominięciem pola o indeksie
+ * @p field, i zlicza to w statystykach. Zwraca liczbę tych pól.
+ */
+static uint64_t relabel_area(board_t b, uint64_t start, uint64_t field,
+                             uint32_t player, uint32_t from, uint32_t to) {
+    uint64_t cells;
+    board_flood(b, start, field, player, from, to, false, &cells);
+    if (b->stats != NULL) {
+        board_stats_t *stats = b->stats;
+        uint32_t bucket = 63 - (uint32_t)__builtin_clzll(cells);
+        stats->relabels++;
+        stats->cells += cells;
+        if (cells > stats->max_cells) {
+            stats->max_cells = cells;
+        }
+        stats->sizes[bucket < BOARD_RELABEL_SIZES
+                     ? bucket : BOARD_RELABEL_SIZES - 1]++;
+    }
+    return cells;
 }
 
-static char board_get_symbol(board_t b, uint32_t x, uint32_t y) {
-    return coordinates_symbol(b, coordinates(x, y));
+/**
+ * Przydziela kolor nowemu obszarowi o jednym polu: pierwszy kolor z listy
+ * wolnych kolorów lub, gdy lista jest pusta, kolejny nieużywany kolor.
+ */
+static uint32_t board_new_area(board_t b) {
+    uint32_t color = b->free_color;
+    if (color != NO_COLOR) {
+        b->free_color = color_link(b, color);
+    }
+    else {
+        assert(b->new_color < b->colors_capacity - 1);
+        color = ++b->new_color;
+    }
+    board_page_t* page = board_writable_page(b, color);
+    page->colors[tile_offset(color)] = color;
+    page->sizes[tile_offset(color)] = 1;
+    return color;
 }
 
-static void board_set_symbol(board_t b, uint32_t x, uint32_t y, char symbol) {
-    assert(board_field_free(b, x, y));
-    b->fields[x][y].player_symbol = symbol;
+/**
+ * Wstawia kolor obszaru, którego pola mają już inny kolor, na początek
+ * listy wolnych kolorów.
+ */
+static void board_free_color(board_t b, uint32_t color) {
+    board_writable_page(b, color)->colors[tile_offset(color)] = b->free_color;
+    b->free_color = color;
 }
 
-static void board_set_player(board_t b, uint32_t x, uint32_t y, uint32_t player) {
-    assert(board_field_free(b, x, y));
-    b->fields[x][y].player = player;
+/**
+ * Przywraca kolor z początku listy wolnych kolorów obszarowi o @p size
+ * polach.
+ */
+static void board_restore_color(board_t b, uint32_t color, uint64_t size) {
+    assert(b->free_color == color);
+    b->free_color = color_link(b, color);
+    board_page_t* page = board_writable_page(b, color);
+    page->colors[tile_offset(color)] = color;
+    page->sizes[tile_offset(color)] = size;
 }
 
-static void board_set_color(board_t b, uint32_t x, uint32_t y, uint32_t color) {
-    assert(board_field_correct(b, x, y));
-    b->fields[x][y].color = color;
+/**
+ * Dołącza nowe pole gracza @p player o indeksie @p field do sąsiednich
+ * obszarów @p areas: pole i pola mniejszych obszarów dostają kolor
+ * największego z nich, a kolory mniejszych są zwalniane. Gdy pole nie ma
+ * sąsiednich obszarów, tworzy nowy obszar. Zwraca kolor obszaru pola.
+ */
+static uint32_t board_join_areas(board_t b, uint64_t field, uint32_t player,
+                                 const board_areas_t* areas) {
+    if (areas->count == 0) {
+        if (b->record != NULL) {
+            b->record->fresh = b->free_color == NO_COLOR;
+        }
+        uint32_t color = board_new_area(b);
+        board_writable_tile(b, field)->areas[tile_offset(field)] = color;
+        return color;
+    }
+    uint32_t color = areas->colors[areas->largest];
+    board_writable_tile(b, field)->areas[tile_offset(field)] = color;
+    (*color_size(b, color))++;
+    for (uint32_t j = 0; j < areas->count; j++) {
+        if (j == areas->largest) {
+            continue;
+        }
+        uint32_t absorbed = areas->colors[j];
+        uint64_t start = neighbour_index(b, field, areas->directions[j]);
+        uint64_t size = relabel_area(b, start, field, player, absorbed, color);
+        assert(size == area_size(b, absorbed));
+        *color_size(b, color) += size;
+        board_free_color(b, absorbed);
+        if (b->record != NULL) {
+            uint8_t k = b->record->absorbed_count++;
+            b->record->absorbed[k] = absorbed;
+            b->record->absorbed_sizes[k] = size;
+            b->record->absorbed_directions[k] = (uint8_t)areas->directions[j];
+        }
+    }
+    if (b->record != NULL) {
+        b->record->joined = true;
+    }
+    return color;
 }
 
-static void board_make_move(board_t b, uint32_t x, uint32_t y, char symbol,
-							uint32_t player) {
-    assert(board_field_free(b, x, y));
-    board_set_symbol(b, x, y, symbol);
-    board_set_player(b, x, y, player);
+/* MIGAWKI */
 
-    b->new_color++;
-    board_set_color(b, x, y, b->new_color);
-    b->colors[b->new_color] = b->new_color;
+/**
+ * Sprawdza zawartość kafelka o numerze @p number wczytanego z migawki:
+ * pola ramki i tylko one należą do @ref BOARD_BORDER_PLAYER, pozostałe
+ * pola są wolne lub należą do graczy o numerach co najwyżej @p players,
+ * kolory zajętych pól są przydzielonymi kolorami (co najwyżej @p colors),
+ * a maski sąsiadów zawierają tylko graczy. Kolory wolnych pól nie są
+ * odczytywane, więc nie są sprawdzane.
+ */
+static bool board_tile_correct(board_t b, uint64_t number, uint32_t players,
+                               uint32_t colors) {
+    const board_tile_t* tile = b->tiles[number];
+    uint64_t mask = (player_bit(players) << 1) - 1 - player_bit(NO_PLAYER);
+    for (uint64_t i = 0; i < BOARD_TILE_CELLS; i++) {
+        uint64_t column, row;
+        index_coordinates(b, number << BOARD_TILE_BITS | i, &column, &row);
+        bool border = column == 0 || column > b->width || row == 0
+                      || row > b->height;
+        uint32_t player = tile->players[i];
+        bool busy = !border && player != NO_PLAYER;
+        if (border != (player == BOARD_BORDER_PLAYER)
+            || (!border && player > players)
+            || (busy && (tile->areas[i] == NO_COLOR || tile->areas[i] > colors))
+            || (b->bits == NULL && (tile->neighbours[i] & ~mask) != 0)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-static void set_coordinates_color(board_t b, coordinates_t c, uint64_t color) {
-    board_set_color(b, c.x, c.y, color);
+/**
+ * Sprawdza listę wolnych kolorów wczytaną z migawki: zaczyna się
+ * w @p free_color, zawiera tylko przydzielone kolory (co najwyżej
+ * @p colors) niewskazujące na siebie i kończy się po co najwyżej
+ * @p colors krokach, więc nie ma cyklu.
+ */
+static bool board_free_colors_correct(board_t b, uint32_t free_color,
+                                      uint32_t colors) {
+    uint32_t color = free_color;
+    for (uint32_t steps = 0; color != NO_COLOR; steps++) {
+        if (steps == colors || color > colors
+            || color_link(b, color) == color) {
+            return false;
+        }
+        color = color_link(b, color);
+    }
+    return true;
 }
 
-static void add_field_to_area(board_t b, coordinates_t c_field,
-							  coordinates_t c_area) {
-    assert(are_same_symbol(b, c_field, c_area));
-    assert(are_same_player(b, c_field, c_area));
-    uint64_t color = coordinates_color(b, c_area);
-    set_coordinates_color(b, c_field, color);
+/**
+ * Sprawdza kolory obszarów wczytanych z migawki: kolor każdego zajętego
+ * pola należy do obszaru, a rozmiar każdego obszaru jest liczbą pól jego
+ * koloru, więc przeszukiwanie obszaru mieści się w stosie o rozmiarze
+ * obszaru. Zwraca false, gdy dane są niepoprawne lub nie udało się
+ * alokować pamięci.
+ */
+static bool board_areas_correct(board_t b, uint32_t colors) {
+    uint64_t* counts = safe_calloc((uint64_t)colors + 1, sizeof(uint64_t));
+    uint64_t end = b->tiles_count << BOARD_TILE_BITS;
+    bool correct = counts != NULL;
+    for (uint64_t index = 0; correct && index < end; index++) {
+        board_tile_t* tile = board_tile(b, index);
+        if (tile == NULL) {
+            index |= BOARD_TILE_CELLS - 1;
+            continue;
+        }
+        uint32_t player = tile->players[tile_offset(index)];
+        if (player != NO_PLAYER && player != BOARD_BORDER_PLAYER) {
+            uint32_t color = tile->areas[tile_offset(index)];
+            correct = color_link(b, color) == color;
+            counts[color]++;
+        }
+    }
+    for (uint32_t color = 1; correct && color <= colors; color++) {
+        correct = color_link(b, color) != color
+                  || (counts[color] > 0
+                      && area_size(b, color) == counts[color]);
+    }
+    free(counts);
+    return correct;
 }
 
-static bool color_correct(board_t b, uint64_t color) {
-    return b != NULL && color < b->new_color && color > 0;
-}
+/* FUNKCJE MODUŁU */
 
-static uint64_t find_true_color(board_t b, uint64_t color) {
-    assert(color_correct(b, color));
-    assert(color < b->new_color);
-    if (b->colors[color] != color) {
-        b->colors[color] = find_true_color(b, b->colors[color]);
+/**
+ * Wyznacza kroki do sąsiadów i przeniesienia na brzegach kafelków planszy
+ * o ustawionych wymiarach i kolejności pól. Kierunki w górę i w prawo
+ * zwiększają wiersz i kolumnę, a dwa kolejne są do nich przeciwne.
+ */
+static void board_init_steps(board_t b) {
+    b->stride = (uint64_t)b->height + 2;
+    b->tile_rows = board_tile_span(b->height);
+    uint64_t tile_column = b->tile_rows << BOARD_TILE_BITS;
+    int64_t steps[2] = {0, 0}, carries[2] = {0, 0};
+    uint64_t masks[2] = {0, 0};
+    switch (b->order) {
+        case BOARD_ORDER_TILES:
+            steps[0] = 1;
+            steps[1] = (int64_t)BOARD_TILE_SIDE;
+            masks[0] = BOARD_TILE_SIDE - 1;
+            masks[1] = (BOARD_TILE_SIDE - 1) << BOARD_TILE_SIDE_BITS;
+            carries[0] = (int64_t)(BOARD_TILE_CELLS - BOARD_TILE_SIDE);
+            carries[1] = (int64_t)(tile_column - BOARD_TILE_CELLS);
+            break;
+        case BOARD_ORDER_MORTON:
+            masks[0] = BOARD_MORTON_ROWS;
+            masks[1] = BOARD_MORTON_COLUMNS;
+            carries[0] = (int64_t)BOARD_TILE_CELLS;
+            carries[1] = (int64_t)tile_column;
+            break;
+        case BOARD_ORDER_COLUMNS:
+            steps[0] = 1;
+            steps[1] = (int64_t)b->stride;
+            break;
+    }
+    for (uint32_t i = 0; i < DIRECTIONS / 2; i++) {
+        b->steps[i] = steps[i];
+        b->steps[i + 2] = -steps[i];
+        b->masks[i] = b->masks[i + 2] = masks[i];
+        b->edges[i] = masks[i];
+        b->edges[i + 2] = 0;
+        b->carries[i] = carries[i];
+        b->carries[i + 2] = -carries[i];
     }
-    return b->colors[color];
 }
 
-static void union_true_colors(board_t b, uint64_t c1, uint64_t c2) {
-    assert(c1 != c2);
-    b->colors[c1] = c2;
+size_t board_size(uint32_t width, uint32_t height, board_order_t order) {
+    return board_layout(width, height, order).size;
 }
 
-static bool recolor(board_t b, coordinates_t c1, coordinates_t c2) {
-    assert(are_same_symbol(b, c1, c2));
-    assert(are_same_player(b, c1, c2));
-    assert(are_neighbours(c1, c2));
+board_t board_init(void* memory, uint32_t width, uint32_t height,
+                   board_order_t order) {
+    assert(memory != NULL && order < BOARD_ORDERS);
+    board_layout_t layout = board_layout(width, height, order);
+    char* block = memory;
+    board_t b = memory;
 
-    uint64_t c1_true_color = find_true_color(b, coordinates_color(b, c1));
-    uint64_t c2_true_color = find_true_color(b, coordinates_color(b, c2));
-    if (c1_true_color == c2_true_color) {
-        return false;
+    b->width = width;
+    b->height = height;
+    b->new_color = NO_COLOR;
+    b->free_color = NO_COLOR;
+    b->colors_capacity = layout.colors_capacity;
+    b->order = order;
+    b->hash = 0;
+    board_init_steps(b);
+    b->rollback = false;
+    b->record = NULL;
+    b->stats = NULL;
+    b->stack = NULL;
+    b->stack_capacity = 0;
+    b->bits = NULL;
+    if (bitboard_fits(width, height)) {
+        b->bits = bitboard_init(block + layout.bits, width, height,
+                                MAX_NUMBER_OF_PLAYERS);
     }
-    union_true_colors(b, c1_true_color, c2_true_color);
-    return true;
+    b->tiles = (board_tile_t**)(block + layout.tiles);
+    b->pages = (board_page_t**)(block + layout.pages);
+    b->tiles_count = layout.tiles_count;
+    b->pages_count = layout.pages_count;
+    b->tile_size = b->bits != NULL ? offsetof(board_tile_t, neighbours)
+                                   : sizeof(board_tile_t);
+    return b;
 }
 
-static bool is_coordinates_color_new(board_t b, coordinates_t c) {
-    assert(coordinates_correct(b, c));
-    return coordinates_color(b, c) == b->new_color;
+void board_copy(board_t dst, board_t src) {
+    assert(dst != NULL && src != NULL);
+    assert(dst->width == src->width && dst->height == src->height
+           && dst->order == src->order);
+    board_release_tiles(dst);
+    if (src->bits != NULL) {
+        bitboard_copy(dst->bits, src->bits);
+    }
+    for (uint64_t i = 0; i < src->tiles_count; i++) {
+        dst->tiles[i] = src->tiles[i];
+        shared_acquire(dst->tiles[i]);
+    }
+    for (uint64_t i = 0; i < src->pages_count; i++) {
+        dst->pages[i] = src->pages[i];
+        shared_acquire(dst->pages[i]);
+    }
+    dst->new_color = src->new_color;
+    dst->free_color = src->free_color;
+    dst->hash = src->hash;
 }
 
-static uint32_t merge_areas(board_t b, coordinates_t c1, coordinates_t c2) {
-    assert(are_same_symbol(b, c1, c2));
-    assert(are_same_player(b, c1, c2));
-    assert(are_neighbours(c1, c2));
-    assert(coordinates_player(b, c1) == coordinates_player(b, c2));
-
-    if (is_coordinates_color_new(b, c1) || recolor(b, c1, c2)) {
-        add_field_to_area(b, c1, c2);
-        return 1;
+void board_reset(board_t b) {
+    assert(b != NULL);
+    size_t fields = offsetof(board_tile_t, players);
+    for (uint64_t i = 0; i < b->tiles_count; i++) {
+        if (shared_owned(b->tiles[i])) {
+            memset((char*)b->tiles[i] + fields, 0, b->tile_size - fields);
+            board_mark_border(b, b->tiles[i], i);
+        }
+        else {
+            shared_release(b->tiles[i]);
+            b->tiles[i] = NULL;
+        }
+    }
+    for (uint64_t i = 0; i < b->pages_count; i++) {
+        if (!shared_owned(b->pages[i])) {
+            shared_release(b->pages[i]);
+            b->pages[i] = NULL;
+        }
     }
-    return 0;
+    if (b->bits != NULL) {
+        bitboard_reset(b->bits);
+    }
+    b->new_color = NO_COLOR;
+    b->free_color = NO_COLOR;
+    b->hash = 0;
+    b->record = NULL;
 }
 
-/* FUNKCJE MODUŁU */
+uint64_t board_snapshot_size(board_t b, uint64_t offset) {
+    assert(b != NULL);
+    board_snapshot_t s;
+    uint64_t end = board_snapshot_layout(b, offset, &s);
+    for (uint64_t i = 0; i < b->tiles_count; i++) {
+        end += b->tiles[i] != NULL ? snapshot_align(b->tile_size) : 0;
+    }
+    for (uint64_t i = 0; i < b->pages_count; i++) {
+        end += b->pages[i] != NULL ? snapshot_align(sizeof(board_page_t)) : 0;
+    }
+    return end - offset;
+}
 
-board_t board_new(uint32_t width, uint32_t height) {
-	board_t b = safe_malloc(sizeof(struct board));
-	if (b) {
-		board_set_parameters(b, width, height);
-	}
-	if (b->colors == NULL || b->fields == NULL) {
-		free(b);
-		return NULL;
-	}
-	return b;
+bool board_save(board_t b, snapshot_writer_t *w) {
+    assert(b != NULL && w != NULL && w->offset % SNAPSHOT_ALIGNMENT == 0);
+    board_snapshot_t s;
+    uint64_t offset = board_snapshot_layout(b, w->offset, &s);
+    if (!snapshot_write(w, &s, sizeof(s)) || !snapshot_write_padding(w)
+        || (b->bits != NULL
+            && (!snapshot_write(w, b->bits, s.bits_size)
+                || !snapshot_write_padding(w)))) {
+        return false;
+    }
+    return board_save_index(w, (void* const*)b->tiles, b->tiles_count,
+                            b->tile_size, &offset)
+           && board_save_index(w, (void* const*)b->pages, b->pages_count,
+                               sizeof(board_page_t), &offset)
+           && board_save_objects(w, (void* const*)b->tiles, b->tiles_count,
+                                 b->tile_size)
+           && board_save_objects(w, (void* const*)b->pages, b->pages_count,
+                                 sizeof(board_page_t));
 }
 
-void board_delete(board_t b) {
-    if (b != NULL) {
-        if (b->fields != NULL) {
-			board_free_fields(b->fields, b->width);
+bool board_load(board_t b, const void *data, uint64_t size, uint64_t offset,
+                uint32_t players) {
+    assert(b != NULL && data != NULL && b->new_color == NO_COLOR);
+    const char* bytes = data;
+    if (!snapshot_section_correct(offset, sizeof(board_snapshot_t), size)) {
+        return false;
+    }
+    const board_snapshot_t* s = (const board_snapshot_t*)(bytes + offset);
+    if (s->width != b->width || s->height != b->height
+        || s->tile_cells != BOARD_TILE_CELLS || s->order != b->order
+        || s->tile_size != b->tile_size
+        || s->page_size != sizeof(board_page_t)
+        || s->tiles_count != b->tiles_count || s->pages_count != b->pages_count
+        || s->new_color >= b->colors_capacity || s->free_color > s->new_color
+        || (b->bits == NULL) != (s->bits_size == 0)) {
+        return false;
+    }
+    if (b->bits != NULL
+        && (!snapshot_section_correct(s->bits_offset, s->bits_size, size)
+            || !bitboard_load(b->bits, bytes + s->bits_offset, s->bits_size))) {
+        return false;
+    }
+    uint64_t end = s->pages_offset + s->pages_count * sizeof(uint64_t);
+    if (!board_load_objects(bytes, size, s->tiles_offset, (void**)b->tiles,
+                            b->tiles_count, b->tile_size, &end)
+        || !board_load_objects(bytes, size, s->pages_offset, (void**)b->pages,
+                               b->pages_count, sizeof(board_page_t), &end)) {
+        board_release_tiles(b);
+        return false;
+    }
+    for (uint64_t i = 0; i <= (s->new_color >> BOARD_TILE_BITS); i++) {
+        if (s->new_color != NO_COLOR && b->pages[i] == NULL) {
+            board_release_tiles(b);
+            return false;
         }
-        if (b->colors != NULL) {
-            free(b->colors);
+    }
+    for (uint64_t i = 0; i < b->tiles_count; i++) {
+        if (b->tiles[i] != NULL
+            && !board_tile_correct(b, i, players, s->new_color)) {
+            board_release_tiles(b);
+            return false;
         }
-        free(b);
+    }
+    if (!board_free_colors_correct(b, s->free_color, s->new_color)
+        || !board_areas_correct(b, s->new_color)) {
+        board_release_tiles(b);
+        return false;
+    }
+    b->new_color = s->new_color;
+    b->free_color = s->free_color;
+    b->hash = s->hash;
+    return true;
+}
+
+void board_release(board_t b) {
+    if (b != NULL) {
+        board_release_tiles(b);
+        free(b->stack);
+        b->stack = NULL;
+        b->stack_capacity = 0;
     }
 }
 
+uint64_t board_memory(board_t b) {
+    assert(b != NULL);
+    uint64_t memory = board_layout(b->width, b->height, b->order).size;
+    for (uint64_t i = 0; i < b->tiles_count; i++) {
+        memory += shared_memory(b->tiles[i], b->tile_size);
+    }
+    for (uint64_t i = 0; i < b->pages_count; i++) {
+        memory += shared_memory(b->pages[i], sizeof(board_page_t));
+    }
+    return memory + b->stack_capacity * sizeof(uint64_t);
+}
+
 char* board_draw(board_t b) {
     if (b == NULL) {
         return NULL;
     }
     char *b_d = safe_calloc((uint64_t)(b->width + 1) * (uint64_t)b->height + 1,
 							sizeof(char));
+    if (b_d == NULL) {
+        return NULL;
+    }
 
     for (uint64_t i = 0; i < b->height; i++) {
-        for (uint64_t x = 0; x < b->width; x++) {
-            uint64_t y = (uint64_t)b->height - i -1;
-            b_d[(uint64_t)(b->width + 1) * i + x] = board_get_symbol(b, x, y);
-        }
-        char endl = '\n';
-        b_d[i * (uint64_t)(b->width + 1) + (uint64_t)b->width] = endl;
+        char *row = b_d + i * (uint64_t)(b->width + 1);
+        board_draw_row(b, b->height - (uint32_t)i - 1, 0, b->width, row);
+        row[b->width] = '\n';
     }
     return b_d;
 }
 
+void board_draw_row(board_t b, uint32_t y, uint32_t x, uint32_t count,
+                    char *buffer) {
+    assert(count == 0 || board_field_correct(b, x + count - 1, y));
+    uint64_t row = (uint64_t)y + 1;
+    uint64_t first = (uint64_t)x + 1;
+    uint64_t end = first + count;
+    if (b->order == BOARD_ORDER_COLUMNS) {
+        uint64_t index = first * b->stride + row;
+        for (uint64_t i = 0; i < count; i++, index += b->stride) {
+            buffer[i] = (char)index_player(b, index);
+        }
+    }
+    else {
+        uint64_t offsets[BOARD_TILE_SIDE];
+        for (uint64_t i = 0; i < BOARD_TILE_SIDE; i++) {
+            offsets[i] = tile_cell(b, i, row & (BOARD_TILE_SIDE - 1));
+        }
+        uint64_t tile_row = row >> BOARD_TILE_SIDE_BITS;
+        for (uint64_t column = first; column < end;) {
+            uint64_t stop = (column | (BOARD_TILE_SIDE - 1)) + 1;
+            stop = stop < end ? stop : end;
+            board_tile_t* tile = b->tiles[(column >> BOARD_TILE_SIDE_BITS)
+                                          * b->tile_rows + tile_row];
+            char* out = buffer + (column - first);
+            if (tile == NULL) {
+                memset(out, NO_PLAYER, stop - column);
+            }
+            else {
+                for (uint64_t c = column; c < stop; c++) {
+                    *out++ = (char)tile->players[offsets[c
+                                                 & (BOARD_TILE_SIDE - 1)]];
+                }
+            }
+            column = stop;
+        }
+    }
+    players_to_symbols(buffer, count);
+}
+
 bool board_field_free(board_t b, uint32_t x, uint32_t y) {
     assert(board_field_correct(b, x, y));
-    return board_get_player(b, x, y) == NO_PLAYER
-           && board_get_symbol(b, x, y) == EMPTY_FIELD_SYMBOL;
+    return board_get_player(b, x, y) == NO_PLAYER;
 }
 
-uint32_t board_up_neighbour_player(board_t b, uint32_t x, uint32_t y) {
-    coordinates_t c = coordinates(x, y);
-    return coordinates_player(b, up_coordinates(c));
+uint32_t board_field_player(board_t b, uint32_t x, uint32_t y) {
+    assert(board_field_correct(b, x, y));
+    return board_get_player(b, x, y);
 }
 
-uint32_t board_down_neighbour_player(board_t b, uint32_t x, uint32_t y) {
-    coordinates_t c = coordinates(x, y);
-    return coordinates_player(b, down_coordinates(c));
+bool board_next_busy(board_t b, uint64_t *cursor, uint32_t *x, uint32_t *y) {
+    assert(b != NULL && cursor != NULL && x != NULL && y != NULL);
+    uint64_t end = b->tiles_count << BOARD_TILE_BITS;
+    for (uint64_t index = *cursor; index < end; index++) {
+        board_tile_t* tile = board_tile(b, index);
+        if (tile == NULL) {
+            index |= BOARD_TILE_CELLS - 1;
+            continue;
+        }
+        uint32_t player = tile->players[tile_offset(index)];
+        if (player == NO_PLAYER || player == BOARD_BORDER_PLAYER) {
+            continue;
+        }
+        uint64_t column, row;
+        index_coordinates(b, index, &column, &row);
+        *x = (uint32_t)(column - 1);
+        *y = (uint32_t)(row - 1);
+        *cursor = index + 1;
+        return true;
+    }
+    *cursor = end;
+    return false;
 }
 
-uint32_t board_left_neighbour_player(board_t b, uint32_t x, uint32_t y) {
-    coordinates_t c = coordinates(x, y);
-    return coordinates_player(b, left_coordinates(c));
+uint64_t board_neighbour_players(board_t b, uint32_t x, uint32_t y) {
+    assert(board_field_correct(b, x, y));
+    return index_neighbours(b, coordinates_index(b, x, y));
 }
 
-uint32_t board_right_neighbour_player(board_t b, uint32_t x, uint32_t y) {
-    coordinates_t c = coordinates(x, y);
-    return coordinates_player(b, right_coordinates(c));
+bool board_has_neighbour_with_player(board_t b, uint32_t x, uint32_t y,
+                                     uint32_t player) {
+    if (b->bits != NULL) {
+        return bitboard_has_neighbour(b->bits, x, y, player);
+    }
+    return (board_neighbour_players(b, x, y) & player_bit(player)) != 0;
 }
 
-bool board_has_neighbour_with_symbol(board_t b, uint32_t x, uint32_t y,
-									 char symbol) {
-    assert(board_field_correct(b, x, y));
-    return has_neighbour_with_symbol(b, coordinates(x, y), symbol);
+uint32_t board_move(board_t b, uint32_t x, uint32_t y, uint32_t player,
+                    uint32_t *new_neighbours, board_undo_t *undo) {
+    assert(undo == NULL || b->rollback);
+    if (undo != NULL) {
+        *undo = (board_undo_t) {.x = x, .y = y, .player = player};
+    }
+    b->record = undo;
+    *new_neighbours = 0;
+    if (b->bits != NULL) {
+        *new_neighbours = bitboard_new_frontier(b->bits, x, y, player);
+        bitboard_move(b->bits, x, y, player);
+    }
+    assert(board_field_free(b, x, y));
+    assert(player <= UINT8_MAX);
+    uint64_t field = coordinates_index(b, x, y);
+    board_tile_t* tile = board_writable_tile(b, field);
+    tile->players[tile_offset(field)] = (uint8_t)player;
+    b->hash ^= zobrist_key(x, y, player);
+
+    for (uint32_t i = 0; i < DIRECTIONS; i++) {
+        uint64_t index = neighbour_index(b, field, i);
+        uint64_t offset = tile_offset(index);
+        tile = board_tile(b, index);
+        if (b->bits == NULL
+            && add_neighbour_player(board_writable_tile(b, index), offset,
+                                    player)) {
+            if (tile->players[offset] == NO_PLAYER) {
+                (*new_neighbours)++;
+            }
+            if (undo != NULL) {
+                undo->added_neighbours |= (uint8_t)(1 << i);
+            }
+        }
+    }
+    board_areas_t areas;
+    board_neighbour_areas(b, field, player, &areas);
+    uint32_t color = board_join_areas(b, field, player, &areas);
+    if (undo != NULL) {
+        undo->color = color;
+    }
+    b->record = NULL;
+    return areas.count;
 }
 
-uint32_t board_new_free_neighbours(board_t b, uint32_t x, uint32_t y,
-								   char symbol) {
-    assert(board_field_free(b, x, y));
+void board_set_stats(board_t b, board_stats_t *stats) {
+    assert(b != NULL);
+    b->stats = stats;
+}
+
+void board_set_rollback(board_t b, bool rollback) {
+    assert(b != NULL);
+    b->rollback = rollback;
+}
+
+void board_undo(board_t b, const board_undo_t *undo) {
+    assert(b != NULL && b->rollback);
+    assert(board_get_player(b, undo->x, undo->y) == undo->player);
+
+    uint64_t index = coordinates_index(b, undo->x, undo->y);
+    for (uint32_t i = undo->absorbed_count; i-- > 0;) {
+        uint32_t color = undo->absorbed[i];
+        uint64_t start = neighbour_index(b, index,
+                                         undo->absorbed_directions[i]);
+        uint64_t size = undo->absorbed_sizes[i];
+        relabel_area(b, start, index, undo->player, undo->color, color);
+        board_restore_color(b, color, size);
+        *color_size(b, undo->color) -= size;
+    }
+    if (undo->joined) {
+        (*color_size(b, undo->color))--;
+    }
+    else if (undo->fresh) {
+        assert(undo->color == b->new_color);
+        b->new_color--;
+    }
+    else {
+        board_free_color(b, undo->color);
+    }
 
-    uint32_t new_neighbours = 0;
-    coordinates_t c = coordinates(x, y);
     for (uint32_t i = 0; i < DIRECTIONS; i++) {
-        coordinates_t neighbour = neighbour_coordinates(c, i);
-        if (coordinates_free(b, neighbour)
-            && !has_neighbour_with_symbol(b, neighbour, symbol)) {
-            new_neighbours++;
+        if ((undo->added_neighbours >> i) & 1) {
+            remove_neighbour_player(b, neighbour_index(b, index, i),
+                                    undo->player);
         }
     }
-    return new_neighbours;
+    if (b->bits != NULL) {
+        bitboard_undo(b->bits, undo->x, undo->y, undo->player);
+    }
+    board_tile_t* tile = board_writable_tile(b, index);
+    tile->players[tile_offset(index)] = NO_PLAYER;
+    tile->areas[tile_offset(index)] = NO_COLOR;
+    b->hash ^= zobrist_key(undo->x, undo->y, undo->player);
 }
 
-uint32_t board_move(board_t b, uint32_t x, uint32_t y,
-                    char symbol, uint32_t player) {
-    board_make_move(b, x, y, symbol, player);
+uint64_t board_area_size(board_t b, uint32_t x, uint32_t y) {
+    assert(board_field_correct(b, x, y));
+    if (board_field_free(b, x, y)) {
+        return 0;
+    }
+    return area_size(b, index_color(b, coordinates_index(b, x, y)));
+}
 
-    uint32_t merged_areas = 0;
-    coordinates_t c = coordinates(x, y);
+bool board_reserve_move(board_t b, uint32_t x, uint32_t y, uint32_t player) {
+    assert(board_field_free(b, x, y));
+    uint64_t field = coordinates_index(b, x, y);
+    if (!board_claim_tile(b, field)) {
+        return false;
+    }
     for (uint32_t i = 0; i < DIRECTIONS; i++) {
-        coordinates_t neighbour = neighbour_coordinates(c, i);
-        if (are_same_symbol(b, c, neighbour)) {
-            merged_areas += merge_areas(b, c, neighbour);
+        if (b->bits == NULL
+            && !board_claim_tile(b, neighbour_index(b, field, i))) {
+            return false;
+        }
+    }
+    board_areas_t areas;
+    board_neighbour_areas(b, field, player, &areas);
+    if (areas.count == 0) {
+        if (b->free_color != NO_COLOR) {
+            return board_claim_page(b, b->free_color);
         }
+        return b->new_color < b->colors_capacity - 1
+               && board_claim_page(b, b->new_color + 1);
     }
-    return merged_areas;
-}
\ No newline at end of file
+    uint64_t absorbed = 0;
+    for (uint32_t j = 0; j < areas.count; j++) {
+        if (j != areas.largest && area_size(b, areas.colors[j]) > absorbed) {
+            absorbed = area_size(b, areas.colors[j]);
+        }
+    }
+    if (!board_reserve_stack(b, absorbed)) {
+        return false;
+    }
+    for (uint32_t j = 0; j < areas.count; j++) {
+        uint64_t index = neighbour_index(b, field, areas.directions[j]);
+        if (!board_claim_page(b, areas.colors[j])
+            || (j != areas.largest
+                && !board_claim_area(b, index, field, player,
+                                     areas.colors[j]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool board_reserve_undo(board_t b, const board_undo_t *undo) {
+    assert(b != NULL && undo != NULL);
+    uint64_t field = coordinates_index(b, undo->x, undo->y);
+    if (!board_claim_tile(b, field)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < DIRECTIONS; i++) {
+        if (((undo->added_neighbours >> i) & 1)
+            && !board_claim_tile(b, neighbour_index(b, field, i))) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < undo->absorbed_count; i++) {
+        uint64_t start = neighbour_index(b, field,
+                                         undo->absorbed_directions[i]);
+        if (!board_reserve_stack(b, undo->absorbed_sizes[i])
+            || !board_claim_page(b, undo->absorbed[i])
+            || !board_claim_area(b, start, field, undo->player,
+                                 undo->color)) {
+            return false;
+        }
+    }
+    return board_claim_page(b, undo->color);
+}
+
+uint64_t board_hash(board_t b) {
+    assert(b != NULL);
+    return b->hash;
+}
+
+board_order_t board_order(board_t b) {
+    assert(b != NULL);
+    return b->order;
+}
+
+bitboard_t board_bitboard(board_t b) {
+    return b != NULL ? b->bits : NULL;
+}
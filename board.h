@@ -9,7 +9,12 @@
 #define BOARD_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "bitboard.h"
+#include "board_order.h"
+#include "snapshot.h"
+#include "constants.h"
 
 /**
  * To jest deklaracja struktury przechowującej planszę gry.
@@ -17,20 +22,139 @@
 typedef struct board* board_t;
 
 /**
- * Tworzy nową planszę gry.
+ * Liczba przedziałów histogramu rozmiarów przekolorowanych obszarów.
+ * Przedział i obejmuje obszary od 2^i do 2^(i+1) - 1 pól, a ostatni
+ * przedział wszystkie większe obszary.
  */
-board_t board_new(uint32_t width, uint32_t height);
+#define BOARD_RELABEL_SIZES 16
 
 /**
- * Usuwa planszę gry.
+ * To jest struktura przechowująca statystyki przekolorowywania obszarów
+ * przy ich łączeniu i wycofywaniu połączeń.
  */
-void board_delete(board_t b);
+typedef struct board_stats {
+    uint64_t relabels;
+    uint64_t cells;
+    uint64_t max_cells;
+    uint64_t sizes[BOARD_RELABEL_SIZES];
+} board_stats_t;
+
+/**
+ * To jest struktura opisująca ruch na planszy, pozwalająca go wycofać.
+ */
+typedef struct board_undo {
+    uint32_t x;
+    uint32_t y;
+    uint32_t player;
+    uint32_t color;               /* Kolor obszaru pola po ruchu. */
+    uint32_t absorbed[DIRECTIONS - 1];  /* Kolory obszarów przekolorowanych
+                                           na kolor pola. */
+    uint64_t absorbed_sizes[DIRECTIONS - 1];  /* Rozmiary tych obszarów. */
+    uint8_t absorbed_directions[DIRECTIONS - 1];  /* Kierunki ich sąsiadów. */
+    uint8_t absorbed_count;
+    uint8_t added_neighbours;     /* Kierunki, w których sąsiad zyskał gracza
+                                     w masce sąsiadów. */
+    bool joined;                  /* Czy pole dołączyło do sąsiedniego
+                                     obszaru. */
+    bool fresh;                   /* Czy pole utworzyło obszar o nieużywanym
+                                     dotąd kolorze. */
+} board_undo_t;
+
+/**
+ * Zwraca liczbę bajtów pamięci potrzebnych na planszę o zadanych wymiarach
+ * i kolejności pól. Rozmiar obejmuje tablicę wskaźników na strony kolorów
+ * dla największej możliwej liczby obszarów.
+ */
+size_t board_size(uint32_t width, uint32_t height, board_order_t order);
+
+/**
+ * Tworzy pustą planszę gry w wyzerowanym bloku pamięci @p memory o rozmiarze
+ * @ref board_size, wyrównanym do 64 bajtów. Plansza nie jest właścicielem
+ * tego bloku.
+ */
+board_t board_init(void* memory, uint32_t width, uint32_t height,
+                   board_order_t order);
+
+/**
+ * Zwraca skrót Zobrista planszy: alternatywę wykluczającą kluczy par
+ * (pole, gracz) wszystkich zajętych pól. Ruch i jego wycofanie zmieniają
+ * skrót o jeden klucz.
+ */
+uint64_t board_hash(board_t b);
+
+/**
+ * Zwraca kolejność pól planszy.
+ */
+board_order_t board_order(board_t b);
+
+/**
+ * Kopiuje stan planszy @p src do planszy @p dst o tych samych wymiarach,
+ * zwalniając dotychczasowe kafelki planszy @p dst. Plansze współdzielą
+ * kafelki i strony kolorów, dopóki któraś z nich ich nie zmieni, więc
+ * kopiowanie działa w czasie proporcjonalnym do liczby kafelków, a nie pól.
+ * Tryb wycofywania ruchów i statystyki planszy @p dst się nie zmieniają.
+ */
+void board_copy(board_t dst, board_t src);
+
+/**
+ * Zwalnia kafelki i strony kolorów planszy. Musi zostać wywołana przed
+ * zwolnieniem bloku pamięci planszy.
+ */
+void board_release(board_t b);
+
+/**
+ * Przywraca planszę do stanu początkowego bez zwalniania pamięci.
+ */
+void board_reset(board_t b);
+
+/**
+ * Zwraca rozmiar sekcji planszy w migawce, gdy sekcja zaczyna się
+ * w wyrównanym przesunięciu @p offset.
+ */
+uint64_t board_snapshot_size(board_t b, uint64_t offset);
+
+/**
+ * Zapisuje sekcję planszy do migawki jednym sekwencyjnym przebiegiem.
+ * Zwraca false, gdy zapis się nie powiódł.
+ */
+bool board_save(board_t b, snapshot_writer_t *w);
+
+/**
+ * Ustawia pustą planszę @p b na stan zapisany w sekcji planszy migawki
+ * @p data o rozmiarze @p size, zaczynającej się w przesunięciu @p offset.
+ * Nie kopiuje kafelków ani stron: plansza używa ich bezpośrednio
+ * z migawki i kopiuje je dopiero przy pierwszym zapisie, więc migawka musi
+ * pozostać zmapowana i dostępna do zapisu, dopóki plansza i jej kopie
+ * istnieją. Sprawdza zgodność parametrów, położenie sekcji oraz zawartość
+ * kafelków i stron: ramkę, numery graczy (co najwyżej @p players), kolory
+ * pól, rozmiary obszarów i listę wolnych kolorów, więc plansza wczytana
+ * z uszkodzonego pliku nie odwołuje się poza swoje tablice. Zwraca false,
+ * gdy sekcja jest niepoprawna.
+ */
+bool board_load(board_t b, const void *data, uint64_t size, uint64_t offset,
+                uint32_t players);
+
+/**
+ * Zwraca liczbę bajtów pamięci używanych przez planszę. Kafelki i strony
+ * współdzielone z innymi planszami są liczone proporcjonalnie do liczby
+ * używających ich plansz.
+ */
+uint64_t board_memory(board_t b);
 
 /**
  * Zwraca napis przedstawiający planszę gry.
  */
 char* board_draw(board_t b);
 
+/**
+ * Zapisuje do bufora @p buffer symbole @p count kolejnych pól wiersza @p y,
+ * zaczynając od kolumny @p x (bez znaku końca wiersza). Pola są czytane
+ * kafelkami: pusty kafelek daje od razu ciąg wolnych pól, a numery graczy
+ * są zamieniane na symbole po osiem naraz.
+ */
+void board_draw_row(board_t b, uint32_t y, uint32_t x, uint32_t count,
+                    char *buffer);
+
 /**
  * Sprawdza czy pole gry jest puste. Zwraca true, jeśli jest lub false
  * w przeciwnym wypadku.
@@ -38,39 +162,85 @@ char* board_draw(board_t b);
 bool board_field_free(board_t b, uint32_t x, uint32_t y);
 
 /**
- * Zwraca numer gracza z pola o jeden wyżej.
+ * Zwraca numer gracza, do którego należy pole (x, y), lub @p NO_PLAYER,
+ * gdy pole jest wolne.
+ */
+uint32_t board_field_player(board_t b, uint32_t x, uint32_t y);
+
+/**
+ * Wyznacza kolejne zajęte pole planszy w kolejności jej przechowywania,
+ * zaczynając od pozycji @p cursor, i przesuwa @p cursor za nie. Pomija
+ * nieprzydzielone kafelki, więc przejście całej planszy od pozycji 0 trwa
+ * proporcjonalnie do obszaru, na którym toczy się gra. Zwraca false, gdy
+ * zajętych pól już nie ma.
+ */
+bool board_next_busy(board_t b, uint64_t *cursor, uint32_t *x, uint32_t *y);
+
+/**
+ * Zwraca maskę graczy, do których należy któreś z pól sąsiednich z polem
+ * (x, y). Bit p maski jest ustawiony, gdy gracz p ma takie pole.
+ */
+uint64_t board_neighbour_players(board_t b, uint32_t x, uint32_t y);
+
+/**
+ * Sprawdza, czy pole planszy sąsiaduje z jakimś polem zadanego gracza.
+ */
+bool board_has_neighbour_with_player(board_t b, uint32_t x, uint32_t y,
+                                     uint32_t player);
+
+/**
+ * Przygotowuje planszę do ruchu gracza na wolne pole (x, y): sprawdza, czy
+ * jest miejsce na kolor nowego obszaru, i zapewnia, że kafelki i strony
+ * kolorów zmieniane przez ruch należą tylko do tej planszy. Zwraca false,
+ * gdy wszystkie kolory zostały już przydzielone lub nie udało się alokować
+ * pamięci. Musi zostać wywołana przed @ref board_move.
+ */
+bool board_reserve_move(board_t b, uint32_t x, uint32_t y, uint32_t player);
+
+/**
+ * Zapewnia, że kafelki i strony kolorów zmieniane przez wycofanie ruchu
+ * @p undo należą tylko do tej planszy. Zwraca false, gdy nie udało się
+ * alokować pamięci. Musi zostać wywołana przed @ref board_undo.
  */
-uint32_t board_up_neighbour_player(board_t b, uint32_t x, uint32_t y);
+bool board_reserve_undo(board_t b, const board_undo_t *undo);
 
 /**
- * Zwraca numer gracza z pola o jeden niżej.
+ * Wykonuje ruch gracza na planszy. Zwraca liczbę połączonych obszarów,
+ * a pod @p new_neighbours zapisuje liczbę wolnych pól, które stały się
+ * sąsiednie z obszarami gracza. Jeśli @p undo nie jest NULL, zapisuje w nim
+ * opis ruchu dla @ref board_undo.
  */
-uint32_t board_down_neighbour_player(board_t b, uint32_t x, uint32_t y);
+uint32_t board_move(board_t b, uint32_t x, uint32_t y, uint32_t player,
+                    uint32_t *new_neighbours, board_undo_t *undo);
 
 /**
- * Zwraca numer gracza z pola o jeden na lewo.
+ * Włącza lub wyłącza tryb, w którym ruchy można wycofywać. Tylko w tym
+ * trybie @ref board_move przyjmuje opis ruchu do wypełnienia.
  */
-uint32_t board_left_neighbour_player(board_t b, uint32_t x, uint32_t y);
+void board_set_rollback(board_t b, bool rollback);
 
 /**
- * Zwraca numer gracza z pola o jeden na prawo.
+ * Ustawia strukturę, w której plansza zlicza statystyki przekolorowywania
+ * obszarów. Wartość NULL wyłącza zliczanie.
  */
-uint32_t board_right_neighbour_player(board_t b, uint32_t x, uint32_t y);
+void board_set_stats(board_t b, board_stats_t *stats);
 
 /**
- * Sprawdza, czy pole planszy sąsiaduje z jakimś polem o zadanym symbolu.
+ * Wycofuje ostatni niewycofany ruch opisany przez @p undo. Ruch musiał
+ * zostać wykonany w trybie wycofywania.
  */
-bool board_has_neighbour_with_symbol(board_t b, uint32_t x, uint32_t y, char symbol);
+void board_undo(board_t b, const board_undo_t *undo);
 
 /**
- * Zwraca ile nowych pustych sąsiednich pól ma gracz o zadanym symbolu.
+ * Zwraca liczbę pól obszaru zawierającego pole (x, y) lub zero, gdy pole
+ * jest puste.
  */
-uint32_t board_new_free_neighbours(board_t b, uint32_t x, uint32_t y, char symbol);
+uint64_t board_area_size(board_t b, uint32_t x, uint32_t y);
 
 /**
- * Wykonuje ruch gracza na planszy.
+ * Zwraca planszę bitową utrzymywaną dla planszy lub NULL, gdy plansza się
+ * w niej nie mieści.
  */
-uint32_t board_move(board_t b, uint32_t x, uint32_t y,
-                    char symbol, uint32_t player);
+bitboard_t board_bitboard(board_t b);
 
 #endif /* BOARD_H */
\ No newline at end of file
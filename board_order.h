@@ -0,0 +1,34 @@
+/** @file
+ * Kolejność pól planszy w pamięci
+ *
+ * Typ jest wydzielony z interfejsu planszy, żeby interfejs silnika gry
+ * mógł go udostępniać bez dołączania wewnętrznych nagłówków planszy.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef BOARD_ORDER_H
+#define BOARD_ORDER_H
+
+/**
+ * To jest typ wyliczeniowy opisujący kolejność pól planszy w pamięci.
+ * Gra toczy się zwykle w zwartych obszarach, więc na dużych planszach
+ * kolejność, w której sąsiedzi pola leżą blisko siebie, zmniejsza liczbę
+ * chybień w pamięci podręcznej.
+ */
+typedef enum board_order {
+    BOARD_ORDER_TILES,      /**< kwadratowe kafelki 64 na 64 pola, w każdym
+                                 pola kolumnami (domyślna) */
+    BOARD_ORDER_MORTON,     /**< kwadratowe kafelki 64 na 64 pola, w każdym
+                                 pola w porządku Mortona (krzywej Z) */
+    BOARD_ORDER_COLUMNS,    /**< cała plansza kolumnami, podzielona na
+                                 kafelki po 4096 kolejnych pól */
+} board_order_t;
+
+/**
+ * Liczba kolejności pól planszy.
+ */
+#define BOARD_ORDERS 3
+
+#endif /* BOARD_ORDER_H */
@@ -5,15 +5,97 @@
  * @date 2023
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include "board.h"
 #include "game.h"
+#include "moves.h"
 #include "player.h"
+#include "replay.h"
 #include "safe_memory_allocation.h"
+#include "snapshot.h"
 #include "constants.h"
 
+/**
+ * Początkowa pojemność historii ruchów.
+ */
+#define INITIAL_HISTORY_CAPACITY 16
+
+/**
+ * Wyrównanie części bloku pamięci gry (rozmiar linii pamięci podręcznej).
+ */
+#define GAME_ALIGNMENT 64
+
+/**
+ * Rozmiar fragmentu napisu planszy zapisywanego przez @ref game_board_write.
+ */
+#define GAME_BOARD_CHUNK 65536
+
+/**
+ * Rozmiar dużej strony pamięci. Blok gry używający dużych stron ma rozmiar
+ * będący jego wielokrotnością.
+ */
+#define GAME_HUGE_PAGE_SIZE ((size_t)1 << 21)
+
+/**
+ * To jest struktura opisująca wykonany ruch, pozwalająca go wycofać.
+ */
+typedef struct game_record {
+    board_undo_t board;
+    moves_undo_t moves;         /* Zmiana indeksu dozwolonych ruchów. */
+    uint64_t neighbour_players; /* Gracze sąsiadujący z polem przed ruchem. */
+    uint32_t new_neighbours;
+    uint32_t merged_areas;
+} game_record_t;
+
+/**
+ * To jest struktura przechowująca statystyki gry i planszy.
+ */
+typedef struct game_counters {
+    game_stats_t game;
+    board_stats_t board;
+} game_counters_t;
+
+/**
+ * To jest struktura opisująca zmapowaną migawkę, z której plansze gier
+ * wczytanych z pliku i ich kopii czytają niezmienione kafelki. Migawka jest
+ * odmapowywana, gdy usunięta zostanie ostatnia z tych gier.
+ */
+typedef struct game_mapping {
+    atomic_uint_fast32_t references;
+    void *data;
+    size_t size;
+} game_mapping_t;
+
+/**
+ * To jest struktura opisująca zapis migawki w tle.
+ */
+struct game_save {
+    pthread_t thread;
+    game_t *fork;   /* Zapisywana kopia gry, usuwana po zapisie. */
+    int fd;
+    bool ok;
+    int error;      /* Wartość @p errno po nieudanym zapisie. */
+};
+
+/**
+ * Stan gry leży w jednym zmapowanym bloku pamięci: po strukturze gry
+ * następują tablica graczy i plansza. Osobno alokowane są kafelki planszy,
+ * które mogą być współdzielone z kopiami gry, oraz indeks dozwolonych
+ * ruchów, historia i statystyki, które są tworzone dopiero wtedy, gdy są
+ * potrzebne.
+ */
 struct game {
     uint32_t width;
     uint32_t height;
@@ -22,6 +104,23 @@ struct game {
     uint64_t free_fields;
     board_t board;
     player_t *player;
+    moves_t moves; /* Indeks dozwolonych ruchów, tworzony przy pierwszym użyciu. */
+    uint64_t history_limit;    /* Maksymalna liczba pamiętanych ruchów. */
+    uint64_t history_capacity;
+    uint64_t history_start;    /* Pozycja najstarszego ruchu w buforze. */
+    uint64_t history_count;
+    game_record_t *history;    /* Bufor cykliczny ostatnich ruchów. */
+    game_counters_t *stats;    /* Statystyki lub NULL, gdy są wyłączone. */
+    replay_writer_t *replay;   /* Dziennik ruchów lub NULL. */
+    size_t block_size;         /* Rozmiar bloku pamięci gry. */
+    bool huge_pages;
+    game_mapping_t *mapping;   /* Migawka, z której plansza czyta kafelki,
+                                  lub NULL. */
+    uint64_t below_limit;      /* Gracze mający mniej obszarów niż limit. */
+    uint64_t with_neighbours;  /* Gracze mający wolne pola sąsiednie. */
+    uint8_t ranking[MAX_NUMBER_OF_PLAYERS];     /* Gracze w kolejności
+                                                   malejącej liczby pól. */
+    uint8_t rank[MAX_NUMBER_OF_PLAYERS + 1];    /* Pozycje graczy w rankingu. */
 };
 
 /* FUNKCJE POMOCNICZE */
@@ -39,10 +138,231 @@ static bool game_parameters_correct(uint32_t width, uint32_t height,
     return true;
 }
 
+/**
+ * Zaokrągla rozmiar w górę do wielokrotności @p alignment, która jest
+ * potęgą dwójki.
+ */
+static size_t game_align(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Zwraca przesunięcie tablicy graczy w bloku pamięci gry.
+ */
+static size_t game_player_offset(void) {
+    return game_align(sizeof(struct game), GAME_ALIGNMENT);
+}
+
+/**
+ * Zwraca przesunięcie planszy w bloku pamięci gry.
+ */
+static size_t game_board_offset(uint32_t players) {
+    return game_player_offset()
+           + game_align((players + 1) * sizeof(player_t), GAME_ALIGNMENT);
+}
+
+/**
+ * Mapuje wyzerowany blok pamięci gry o zadanych parametrach i ustawia
+ * w nim wskaźniki na tablicę graczy i planszę. Pozostałe pola struktury
+ * są wyzerowane. Zwraca NULL, gdy nie udało się zmapować pamięci.
+ */
+static game_t* game_map(uint32_t width, uint32_t height, uint32_t players,
+                        board_order_t order, bool huge_pages) {
+    size_t size = game_board_offset(players)
+                  + board_size(width, height, order);
+    if (huge_pages) {
+        size = game_align(size, GAME_HUGE_PAGE_SIZE);
+    }
+    char *block = safe_map(size, huge_pages);
+    if (block == NULL) {
+        return NULL;
+    }
+    game_t *g = (game_t*)block;
+    g->block_size = size;
+    g->huge_pages = huge_pages;
+    g->player = (player_t*)(block + game_player_offset());
+    g->board = board_init(block + game_board_offset(players), width, height,
+                          order);
+    return g;
+}
+
+/**
+ * Zwalnia odwołanie do zmapowanej migawki i odmapowuje ją, gdy było
+ * ostatnie. Musi zostać wywołana po zwolnieniu kafelków planszy.
+ */
+static void game_mapping_release(game_mapping_t *mapping) {
+    if (mapping != NULL && atomic_fetch_sub(&mapping->references, 1) == 1) {
+        munmap(mapping->data, mapping->size);
+        free(mapping);
+    }
+}
+
+/**
+ * Sprawdza poprawność nagłówka migawki o rozmiarze @p size. Zwraca true,
+ * jeśli jest poprawny lub false w przeciwnym wypadku.
+ */
+static bool game_snapshot_correct(const snapshot_header_t *h, uint64_t size) {
+    snapshot_header_t copy = *h;
+    copy.checksum = 0;
+    return memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) == 0
+           && h->version == SNAPSHOT_VERSION
+           && h->byte_order == SNAPSHOT_BYTE_ORDER && h->size == size
+           && h->checksum == snapshot_checksum(&copy, sizeof(copy))
+           && game_parameters_correct(h->width, h->height, h->players,
+                                      h->areas)
+           && h->order < BOARD_ORDERS
+           && h->free_fields <= (uint64_t)h->width * h->height
+           && h->players_size == (h->players + 1) * sizeof(player_t)
+           && snapshot_section_correct(h->players_offset, h->players_size,
+                                       size)
+           && snapshot_section_correct(h->board_offset, 0, size)
+           && snapshot_section_correct(h->trailer_offset,
+                                       sizeof(snapshot_trailer_t), size)
+           && h->players_offset + h->players_size <= h->board_offset
+           && h->board_offset <= h->trailer_offset
+           && h->trailer_offset + sizeof(snapshot_trailer_t) == size;
+}
+
+/**
+ * Sprawdza sumy kontrolne sekcji migawki @p data o poprawnym nagłówku.
+ */
+static bool game_snapshot_checksums_correct(const char *data) {
+    const snapshot_header_t *h = (const snapshot_header_t*)data;
+    const snapshot_trailer_t *t =
+        (const snapshot_trailer_t*)(data + h->trailer_offset);
+    return t->players_checksum
+           == snapshot_checksum(data + h->players_offset,
+                                h->board_offset - h->players_offset)
+           && t->board_checksum
+              == snapshot_checksum(data + h->board_offset,
+                                   h->trailer_offset - h->board_offset);
+}
+
+/**
+ * Sprawdza liczniki graczy wczytane z migawki: gracz nie może mieć więcej
+ * obszarów niż pól ani więcej zajętych lub sąsiednich pól niż plansza.
+ */
+static bool game_counters_correct(game_t const *g) {
+    uint64_t cells = (uint64_t)g->width * g->height;
+    uint64_t busy = 0;
+    for (uint32_t i = 1; i <= g->players; i++) {
+        const player_t *p = &g->player[i];
+        if (p->areas > p->busy_fields || p->free_neighbours > cells) {
+            return false;
+        }
+        busy += p->busy_fields;
+    }
+    return busy + g->free_fields == cells;
+}
+
+/**
+ * Zapisuje grę do migawki w wątku w tle.
+ */
+static void* game_save_thread(void *arg) {
+    game_save_t *save = arg;
+    save->ok = game_save(save->fork, save->fd);
+    save->error = errno;
+    game_delete(save->fork);
+    return NULL;
+}
+
+/**
+ * Zwraca maskę graczy, którzy mogą wykonać ruch.
+ */
+static inline uint64_t game_active_players(game_t const *g) {
+	return g->free_fields > 0 ? g->below_limit | g->with_neighbours : 0;
+}
+
+/**
+ * Aktualizuje bity gracza w maskach graczy mających mniej obszarów niż
+ * limit i graczy mających wolne pola sąsiednie.
+ */
+static inline void game_update_player(game_t *g, uint32_t player) {
+	uint64_t bit = (uint64_t)1 << player;
+	const player_t *p = &g->player[player];
+	g->below_limit = p->areas < g->areas
+					 ? g->below_limit | bit : g->below_limit & ~bit;
+	g->with_neighbours = p->free_neighbours > 0
+						 ? g->with_neighbours | bit : g->with_neighbours & ~bit;
+}
+
+/**
+ * Zamienia miejscami w rankingu gracza @p player z graczem na pozycji
+ * @p position.
+ */
+static inline void game_rank_swap(game_t *g, uint32_t player,
+								  uint32_t position) {
+	uint32_t other = g->ranking[position];
+	g->ranking[g->rank[player]] = (uint8_t)other;
+	g->rank[other] = g->rank[player];
+	g->ranking[position] = (uint8_t)player;
+	g->rank[player] = (uint8_t)position;
+}
+
+/**
+ * Przygotowuje ranking do zwiększenia liczby pól gracza o jeden: przesuwa
+ * gracza na początek grupy graczy z tą samą liczbą pól, znajdując go
+ * wyszukiwaniem binarnym.
+ */
+static inline void game_rank_up(game_t *g, uint32_t player) {
+	uint32_t busy = g->player[player].busy_fields;
+	uint32_t low = 0, high = g->rank[player];
+	while (low < high) {
+		uint32_t middle = (low + high) / 2;
+		if (g->player[g->ranking[middle]].busy_fields > busy) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	game_rank_swap(g, player, low);
+}
+
+/**
+ * Przygotowuje ranking do zmniejszenia liczby pól gracza o jeden: przesuwa
+ * gracza na koniec grupy graczy z tą samą liczbą pól.
+ */
+static inline void game_rank_down(game_t *g, uint32_t player) {
+	uint32_t busy = g->player[player].busy_fields;
+	uint32_t low = g->rank[player], high = g->players - 1;
+	while (low < high) {
+		uint32_t middle = (low + high + 1) / 2;
+		if (g->player[g->ranking[middle]].busy_fields < busy) {
+			high = middle - 1;
+		}
+		else {
+			low = middle;
+		}
+	}
+	game_rank_swap(g, player, low);
+}
+
+/**
+ * Wyznacza od nowa maski graczy i ranking z liczników graczy.
+ */
+static void game_rebuild_players(game_t *g) {
+	g->below_limit = 0;
+	g->with_neighbours = 0;
+	for (uint32_t i = 1; i <= g->players; i++) {
+		game_update_player(g, i);
+		uint32_t position = i - 1;
+		while (position > 0 && g->player[g->ranking[position - 1]].busy_fields
+							   < g->player[i].busy_fields) {
+			g->ranking[position] = g->ranking[position - 1];
+			position--;
+		}
+		g->ranking[position] = (uint8_t)i;
+	}
+	for (uint32_t i = 0; i < g->players; i++) {
+		g->rank[g->ranking[i]] = (uint8_t)i;
+	}
+}
+
 /**
  * Ustawia parametry gry.
  */
-static bool game_set_parameters(game_t *g, uint32_t width, uint32_t height,
+static void game_set_parameters(game_t *g, uint32_t width, uint32_t height,
 								uint32_t players, uint32_t areas) {
 	assert(g != NULL);
 
@@ -51,25 +371,10 @@ static bool game_set_parameters(game_t *g, uint32_t width, uint32_t height,
 	g->players = players;
 	g->areas = areas;
 	g->free_fields = (uint64_t)width * (uint64_t)height;
-	g->player = safe_malloc((players + 1) * sizeof(player_t));
-	if (g->player) {
-		g->player[0] = player_new(EMPTY_FIELD_SYMBOL);
-		for (uint32_t i = 1; i < players + 1; i++) {
-			g->player[i] = player_new((i < 10) ? '0' + i : 'A' + i - 10);
-		}
-		g->board = board_new(width, height);
-		if (g->board == NULL) {
-			printf("board to null przy tworzeniu\n");
-			free(g->player);
-			free(g);
-			return false;
-		}
+	for (uint32_t i = 0; i < players + 1; i++) {
+		g->player[i] = player_new(player_symbol(i));
 	}
-	else {
-		free(g);
-		return false;
-	}
-	return true;
+	game_rebuild_players(g);
 }
 
 /**
@@ -96,26 +401,63 @@ static bool game_field_correct(game_t const *g, uint32_t x, uint32_t y) {
 }
 
 /**
- * Aktualizuje liczbę sąsiednich wolnych pól, dla pól będących sąsiadami pola
- * o współrzędnych (x, y).
+ * Aktualizuje liczbę sąsiednich wolnych pól graczy, których obszary
+ * sąsiadują z zajmowanym polem. Maska @p players opisuje tych graczy.
  */
-static void game_update_neighbours(game_t *g, uint32_t x, uint32_t y) {
-	assert(game_field_correct(g, x, y));
-
-	uint32_t player_right = board_right_neighbour_player(g->board, x, y);
-	uint32_t player_left = board_left_neighbour_player(g->board, x, y);
-	uint32_t player_up = board_up_neighbour_player(g->board, x, y);
-	uint32_t player_down = board_down_neighbour_player(g->board, x, y);
+static void game_update_neighbours(game_t *g, uint64_t players) {
+	while (players != 0) {
+		uint32_t player = (uint32_t)__builtin_ctzll(players);
+		players &= players - 1;
+		player_remove_neighbour(&g->player[player]);
+		if (g->player[player].free_neighbours == 0) {
+			g->with_neighbours &= ~((uint64_t)1 << player);
+		}
+	}
+}
 
-	player_set_neighbour_to_remove(&g->player[player_right]);
-	player_set_neighbour_to_remove(&g->player[player_left]);
-	player_set_neighbour_to_remove(&g->player[player_up]);
-	player_set_neighbour_to_remove(&g->player[player_down]);
+/**
+ * Zapewnia miejsce w historii na kolejny ruch. Gdy historia osiągnęła
+ * maksymalną długość, zapomina najstarszy ruch.
+ */
+static bool game_reserve_record(game_t *g) {
+	if (g->history_limit == 0 || g->history_count < g->history_capacity) {
+		return true;
+	}
+	if (g->history_capacity == g->history_limit) {
+		g->history_start = (g->history_start + 1) % g->history_capacity;
+		g->history_count--;
+		return true;
+	}
+	uint64_t capacity = g->history_capacity > 0
+						? 2 * g->history_capacity : INITIAL_HISTORY_CAPACITY;
+	if (capacity > g->history_limit) {
+		capacity = g->history_limit;
+	}
+	game_record_t *history = safe_malloc(capacity * sizeof(game_record_t));
+	if (history == NULL) {
+		return false;
+	}
+	for (uint64_t i = 0; i < g->history_count; i++) {
+		history[i] = g->history[(g->history_start + i) % g->history_capacity];
+	}
+	free(g->history);
+	g->history = history;
+	g->history_capacity = capacity;
+	g->history_start = 0;
+	return true;
+}
 
-	player_remove_neighbour(&g->player[player_right]);
-	player_remove_neighbour(&g->player[player_left]);
-	player_remove_neighbour(&g->player[player_up]);
-	player_remove_neighbour(&g->player[player_down]);
+/**
+ * Zwraca miejsce w historii na opis wykonywanego ruchu lub NULL, gdy
+ * historia jest wyłączona.
+ */
+static game_record_t* game_push_record(game_t *g) {
+	if (g->history_limit == 0) {
+		return NULL;
+	}
+	assert(g->history_count < g->history_capacity);
+	uint64_t i = (g->history_start + g->history_count++) % g->history_capacity;
+	return &g->history[i];
 }
 
 /**
@@ -127,57 +469,422 @@ static void game_make_move(game_t *g, uint32_t player, uint32_t x, uint32_t y) {
 	assert(g->free_fields > 0);
 
 	g->free_fields--;
-	game_update_neighbours(g, x, y);
+	uint64_t neighbour_players = board_neighbour_players(g->board, x, y);
+	game_update_neighbours(g, neighbour_players);
 
-	char symbol = game_player(g, player);
-	uint32_t new_neighbours = board_new_free_neighbours(g->board, x, y, symbol);
-	uint32_t merged_areas = board_move(g->board, x, y, symbol, player);
+	game_record_t *record = game_push_record(g);
+	uint32_t new_neighbours;
+	uint32_t merged_areas = board_move(g->board, x, y, player, &new_neighbours,
+									   record != NULL ? &record->board : NULL);
+	game_rank_up(g, player);
 	player_move(&g->player[player], new_neighbours, merged_areas);
+	game_update_player(g, player);
+	if (record != NULL) {
+		record->moves.valid = false;
+	}
+	if (g->moves != NULL) {
+		moves_move(g->moves, g->board, x, y, player, neighbour_players,
+				   record != NULL ? &record->moves : NULL);
+	}
+	if (g->stats != NULL) {
+		g->stats->game.merged[merged_areas]++;
+		g->stats->game.merges += merged_areas;
+	}
+	if (record != NULL) {
+		record->neighbour_players = neighbour_players;
+		record->new_neighbours = new_neighbours;
+		record->merged_areas = merged_areas;
+	}
+}
+
+/**
+ * Wykonuje ruch, jeśli jest dozwolony. Zwraca powód odrzucenia ruchu lub
+ * GAME_REJECT_NONE, gdy ruch został wykonany.
+ */
+static game_reject_t game_try_move(game_t *g, uint32_t player,
+								   uint32_t x, uint32_t y) {
+	if (!game_player_correct(g, player)) {
+		return GAME_REJECT_PLAYER;
+	}
+	if (x >= g->width || y >= g->height) {
+		return GAME_REJECT_FIELD;
+	}
+	if (game_free_fields(g, player) == 0) {
+		return GAME_REJECT_NO_MOVES;
+	}
+	if (!board_field_free(g->board, x, y)) {
+		return GAME_REJECT_BUSY;
+	}
+	bool neighbour = board_has_neighbour_with_player(g->board, x, y, player);
+	if (!player_can_move(&g->player[player], g->areas,
+						 g->free_fields, neighbour)) {
+		return GAME_REJECT_AREAS;
+	}
+	if (!board_reserve_move(g->board, x, y, player)
+		|| (g->moves != NULL && !moves_reserve(g->moves, x, y, player))
+		|| !game_reserve_record(g)) {
+		return GAME_REJECT_MEMORY;
+	}
+	game_make_move(g, player, x, y);
+	return GAME_REJECT_NONE;
+}
+
+/**
+ * Zwraca czas monotoniczny w nanosekundach.
+ */
+static uint64_t game_clock(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Zwraca numer przedziału histogramu czasu ruchu, do którego należy czas
+ * @p ns. Czasy mniejsze od podwojonej liczby podprzedziałów mają własne
+ * przedziały, a każda kolejna potęga dwójki jest dzielona na równe
+ * podprzedziały.
+ */
+static uint32_t game_latency_bucket(uint64_t ns) {
+	if (ns < 2 * GAME_STATS_LATENCY_SUB_BUCKETS) {
+		return (uint32_t)ns;
+	}
+	uint32_t exponent = 63 - (uint32_t)__builtin_clzll(ns);
+	uint32_t shift = exponent - GAME_STATS_LATENCY_SUB_BITS;
+	uint32_t bucket = (shift + 1) * GAME_STATS_LATENCY_SUB_BUCKETS
+					  + (uint32_t)((ns >> shift) & (GAME_STATS_LATENCY_SUB_BUCKETS - 1));
+	return bucket < GAME_STATS_LATENCY_BUCKETS
+		   ? bucket : GAME_STATS_LATENCY_BUCKETS - 1;
+}
+
+/**
+ * Wykonuje ruch, jeśli jest dozwolony, i dolicza go do statystyk.
+ */
+static bool game_measured_move(game_t *g, uint32_t player,
+							   uint32_t x, uint32_t y) {
+	uint64_t start = game_clock();
+	game_reject_t reason = game_try_move(g, player, x, y);
+	uint64_t ns = game_clock() - start;
+
+	game_stats_t *stats = &g->stats->game;
+	stats->calls++;
+	if (reason == GAME_REJECT_NONE) {
+		stats->moves++;
+	}
+	else {
+		stats->rejected[reason]++;
+	}
+	stats->latency_ns += ns;
+	if (ns > stats->latency_max) {
+		stats->latency_max = ns;
+	}
+	stats->latency[game_latency_bucket(ns)]++;
+	return reason == GAME_REJECT_NONE;
 }
 
 /* FUNKCJE MODUŁU GRY */
 
 game_t* game_new(uint32_t width, uint32_t height,
                  uint32_t players, uint32_t areas) {
-    if (!game_parameters_correct(width, height, players, areas)) {
+    return game_new_with_options(width, height, players, areas, NULL);
+}
+
+game_t* game_new_with_options(uint32_t width, uint32_t height,
+                              uint32_t players, uint32_t areas,
+                              game_options_t const *options) {
+    if (!game_parameters_correct(width, height, players, areas)
+        || (options != NULL && options->order >= BOARD_ORDERS)) {
         return NULL;
     }
 
-    game_t *g = safe_malloc(sizeof(struct game));
-	if (g != NULL) {
-		if(!game_set_parameters(g, width, height, players, areas)) {
-			return NULL;
-		}
-	}
+    game_t *g = game_map(width, height, players,
+                         options != NULL ? options->order : BOARD_ORDER_TILES,
+                         options != NULL && options->huge_pages);
+    if (g != NULL) {
+        game_set_parameters(g, width, height, players, areas);
+    }
+    return g;
+}
+
+game_t* game_fork(game_t const *g) {
+    if (g == NULL) {
+        return NULL;
+    }
+    game_t *copy = game_map(g->width, g->height, g->players,
+                            board_order(g->board), g->huge_pages);
+    if (copy == NULL) {
+        return NULL;
+    }
+    copy->width = g->width;
+    copy->height = g->height;
+    copy->players = g->players;
+    copy->areas = g->areas;
+    copy->free_fields = g->free_fields;
+    memcpy(copy->player, g->player, (g->players + 1) * sizeof(player_t));
+    copy->below_limit = g->below_limit;
+    copy->with_neighbours = g->with_neighbours;
+    memcpy(copy->ranking, g->ranking, sizeof(g->ranking));
+    memcpy(copy->rank, g->rank, sizeof(g->rank));
+    board_copy(copy->board, g->board);
+    copy->mapping = g->mapping;
+    if (copy->mapping != NULL) {
+        atomic_fetch_add(&copy->mapping->references, 1);
+    }
+    return copy;
+}
+
+bool game_save(game_t const *g, int fd) {
+    if (g == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    snapshot_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.byte_order = SNAPSHOT_BYTE_ORDER;
+    h.width = g->width;
+    h.height = g->height;
+    h.players = g->players;
+    h.areas = g->areas;
+    h.order = board_order(g->board);
+    h.free_fields = g->free_fields;
+    h.players_offset = snapshot_align(sizeof(h));
+    h.players_size = (g->players + 1) * sizeof(player_t);
+    h.board_offset = snapshot_align(h.players_offset + h.players_size);
+    h.trailer_offset = h.board_offset
+                       + board_snapshot_size(g->board, h.board_offset);
+    h.size = h.trailer_offset + sizeof(snapshot_trailer_t);
+    h.checksum = snapshot_checksum(&h, sizeof(h));
+
+    snapshot_writer_t w;
+    if (!snapshot_writer_init(&w, fd)) {
+        return false;
+    }
+    snapshot_trailer_t t;
+    bool ok = snapshot_write(&w, &h, sizeof(h)) && snapshot_write_padding(&w);
+    snapshot_writer_section(&w);
+    ok = ok && snapshot_write(&w, g->player, h.players_size)
+         && snapshot_write_padding(&w);
+    t.players_checksum = snapshot_writer_section(&w);
+    ok = ok && board_save(g->board, &w);
+    t.board_checksum = snapshot_writer_section(&w);
+    ok = ok && snapshot_write(&w, &t, sizeof(t));
+    int error = errno;
+    if (!snapshot_writer_finish(&w)) {
+        return false;
+    }
+    if (!ok) {
+        errno = error;
+    }
+    return ok;
+}
+
+game_t* game_load(const char *path) {
+    if (path == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    if ((uint64_t)st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    const snapshot_header_t *h = data;
+    if (!game_snapshot_correct(h, size)
+        || !game_snapshot_checksums_correct(data)) {
+        munmap(data, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    game_mapping_t *mapping = safe_malloc(sizeof(game_mapping_t));
+    game_t *g = game_map(h->width, h->height, h->players, h->order, false);
+    if (mapping == NULL || g == NULL) {
+        free(mapping);
+        if (g != NULL) {
+            safe_unmap(g, g->block_size);
+        }
+        munmap(data, size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    atomic_init(&mapping->references, 1);
+    mapping->data = data;
+    mapping->size = size;
+    g->mapping = mapping;
+    g->width = h->width;
+    g->height = h->height;
+    g->players = h->players;
+    g->areas = h->areas;
+    g->free_fields = h->free_fields;
+    memcpy(g->player, (char*)data + h->players_offset, h->players_size);
+    for (uint32_t i = 0; i < g->players + 1; i++) {
+        g->player[i].symbol = player_symbol(i);
+    }
+    if (!game_counters_correct(g)) {
+        game_delete(g);
+        errno = EINVAL;
+        return NULL;
+    }
+    game_rebuild_players(g);
+    if (!board_load(g->board, data, h->trailer_offset, h->board_offset,
+                    g->players)) {
+        game_delete(g);
+        errno = EINVAL;
+        return NULL;
+    }
     return g;
 }
 
+game_save_t* game_save_async(game_t const *g, int fd) {
+    game_save_t *save = safe_malloc(sizeof(game_save_t));
+    if (save == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    save->fd = fd;
+    save->fork = game_fork(g);
+    if (save->fork == NULL) {
+        free(save);
+        return NULL;
+    }
+    int error = pthread_create(&save->thread, NULL, game_save_thread, save);
+    if (error != 0) {
+        game_delete(save->fork);
+        free(save);
+        errno = error;
+        return NULL;
+    }
+    return save;
+}
+
+bool game_save_wait(game_save_t *save) {
+    if (save == NULL) {
+        return false;
+    }
+    pthread_join(save->thread, NULL);
+    bool ok = save->ok;
+    if (!ok) {
+        errno = save->error;
+    }
+    free(save);
+    return ok;
+}
+
+void game_reset(game_t *g) {
+    if (g == NULL) {
+        return;
+    }
+    g->free_fields = (uint64_t)g->width * (uint64_t)g->height;
+    for (uint32_t i = 0; i < g->players + 1; i++) {
+        g->player[i] = player_new(player_symbol(i));
+    }
+    game_rebuild_players(g);
+    board_reset(g->board);
+    if (g->moves != NULL) {
+        moves_reset(g->moves);
+    }
+    g->history_start = 0;
+    g->history_count = 0;
+    if (g->replay != NULL) {
+        replay_writer_control(g->replay, REPLAY_RESET);
+    }
+}
+
 void game_delete(game_t *g) {
     if (g != NULL) {
-        board_delete(g->board);
-		if (g->player != NULL) {
-			free(g->player);
-		}
-        free(g);
+        moves_delete(g->moves);
+        free(g->history);
+        free(g->stats);
+        board_release(g->board);
+        game_mapping_release(g->mapping);
+        safe_unmap(g, g->block_size);
     }
 }
 
-bool game_move(game_t *g, uint32_t player, uint32_t x, uint32_t y) {
-	if (!game_player_correct(g, player)
-		|| game_free_fields(g, player) == 0
-		|| !game_field_correct(g, x, y)
-		|| !board_field_free(g->board, x, y)) {
-		return false;
+/**
+ * Wykonuje ruch, jeśli jest dozwolony, dolicza go do statystyk, o ile są
+ * włączone, i dopisuje wykonany ruch do dziennika, o ile jest ustawiony.
+ */
+static bool game_recorded_move(game_t *g, uint32_t player,
+							   uint32_t x, uint32_t y) {
+	bool moved = g->stats != NULL
+				 ? game_measured_move(g, player, x, y)
+				 : game_try_move(g, player, x, y) == GAME_REJECT_NONE;
+	if (moved && g->replay != NULL) {
+		replay_writer_move(g->replay, player, x, y);
 	}
-	printf("jestem w game_move\n");
-	char symbol = game_player(g, player);
-	bool neighbour = board_has_neighbour_with_symbol(g->board, x, y, symbol);
-	if (!player_can_move(&g->player[player], g->areas,
-						 g->free_fields, neighbour)) {
-		return false;
+	return moved;
+}
+
+bool game_move(game_t *g, uint32_t player, uint32_t x, uint32_t y) {
+	if (g != NULL && (g->stats != NULL || g->replay != NULL)) {
+		return game_recorded_move(g, player, x, y);
 	}
-	game_make_move(g, player, x, y);
-	return true;
+	return game_try_move(g, player, x, y) == GAME_REJECT_NONE;
+}
+
+bool game_set_history(game_t *g, uint64_t length) {
+    if (g == NULL) {
+        return false;
+    }
+    free(g->history);
+    g->history = NULL;
+    g->history_limit = length;
+    g->history_capacity = 0;
+    g->history_start = 0;
+    g->history_count = 0;
+    board_set_rollback(g->board, length > 0);
+    return true;
+}
+
+bool game_undo(game_t *g) {
+    if (g == NULL || g->history_count == 0) {
+        return false;
+    }
+    const game_record_t *r = &g->history[(g->history_start + g->history_count - 1)
+                                         % g->history_capacity];
+    const board_undo_t *u = &r->board;
+    if (!board_reserve_undo(g->board, u)
+        || (g->moves != NULL
+            && !moves_reserve_undo(g->moves, r->neighbour_players))) {
+        return false;
+    }
+    g->history_count--;
+    board_undo(g->board, u);
+    game_rank_down(g, u->player);
+    player_undo_move(&g->player[u->player], r->new_neighbours, r->merged_areas);
+    game_update_player(g, u->player);
+    uint64_t players = r->neighbour_players;
+    g->with_neighbours |= players;
+    while (players != 0) {
+        uint32_t player = (uint32_t)__builtin_ctzll(players);
+        players &= players - 1;
+        player_add_neighbour(&g->player[player]);
+    }
+    g->free_fields++;
+    if (g->moves != NULL) {
+        moves_undo(g->moves, g->board, u->x, u->y, u->player,
+                   r->neighbour_players, &r->moves);
+    }
+    if (g->replay != NULL) {
+        replay_writer_control(g->replay, REPLAY_UNDO);
+    }
+    return true;
 }
 
 uint64_t game_busy_fields(game_t const *g, uint32_t player) {
@@ -194,6 +901,127 @@ uint64_t game_free_fields(game_t const *g, uint32_t player) {
     return player_free_fields(&g->player[player], g->areas, g->free_fields);
 }
 
+bool game_legal_move(game_t *g, uint32_t player, uint64_t n,
+                     uint32_t *x, uint32_t *y) {
+    if (!game_player_correct(g, player) || x == NULL || y == NULL
+        || n >= game_free_fields(g, player)) {
+        return false;
+    }
+    uint32_t set = g->player[player].areas < g->areas ? NO_PLAYER : player;
+    bitboard_t bits = board_bitboard(g->board);
+    if (bits != NULL) {
+        return bitboard_select(bits, set, n, x, y);
+    }
+    if (g->moves == NULL) {
+        g->moves = moves_new(g->board, g->width, g->height, g->players);
+        if (g->moves == NULL) {
+            return false;
+        }
+    }
+    if (set == NO_PLAYER) {
+        return moves_free_field(g->moves, n, x, y);
+    }
+    return moves_frontier_field(g->moves, player, n, x, y);
+}
+
+bool game_set_stats(game_t *g, bool enabled) {
+    if (g == NULL) {
+        return false;
+    }
+    free(g->stats);
+    g->stats = NULL;
+    board_set_stats(g->board, NULL);
+    if (enabled) {
+        g->stats = safe_calloc(1, sizeof(game_counters_t));
+        if (g->stats == NULL) {
+            return false;
+        }
+        board_set_stats(g->board, &g->stats->board);
+    }
+    return true;
+}
+
+void game_set_replay(game_t *g, replay_writer_t *log) {
+    if (g != NULL) {
+        g->replay = log;
+    }
+}
+
+bool game_stats(game_t const *g, game_stats_t *stats) {
+    if (g == NULL || g->stats == NULL || stats == NULL) {
+        return false;
+    }
+    const board_stats_t *board = &g->stats->board;
+    *stats = g->stats->game;
+    stats->relabels = board->relabels;
+    stats->relabel_cells = board->cells;
+    stats->relabel_max = board->max_cells;
+    memcpy(stats->relabel_sizes, board->sizes, sizeof(stats->relabel_sizes));
+    return true;
+}
+
+uint64_t game_stats_latency_bucket(uint32_t bucket) {
+    if (bucket < 2 * GAME_STATS_LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    uint32_t shift = bucket / GAME_STATS_LATENCY_SUB_BUCKETS - 1;
+    uint64_t mantissa = GAME_STATS_LATENCY_SUB_BUCKETS
+                        + bucket % GAME_STATS_LATENCY_SUB_BUCKETS;
+    return mantissa << shift;
+}
+
+uint64_t game_stats_latency_quantile(game_stats_t const *stats, double q) {
+    if (stats == NULL) {
+        return 0;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < GAME_STATS_LATENCY_BUCKETS; i++) {
+        total += stats->latency[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)total);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < GAME_STATS_LATENCY_BUCKETS; i++) {
+        seen += stats->latency[i];
+        if (seen > rank) {
+            uint64_t limit = game_stats_latency_bucket(i + 1);
+            return limit < stats->latency_max ? limit : stats->latency_max;
+        }
+    }
+    return stats->latency_max;
+}
+
+uint64_t game_memory(game_t const *g) {
+    if (g == NULL) {
+        return 0;
+    }
+    return sizeof(struct game) + (g->players + 1) * sizeof(player_t)
+           + board_memory(g->board) + moves_memory(g->moves)
+           + g->history_capacity * sizeof(game_record_t);
+}
+
+uint64_t game_hash(game_t const *g) {
+    if (g == NULL) {
+        return 0;
+    }
+    return board_hash(g->board);
+}
+
+uint64_t game_area_size(game_t const *g, uint32_t x, uint32_t y) {
+    if (g == NULL || x >= g->width || y >= g->height) {
+        return 0;
+    }
+    return board_area_size(g->board, x, y);
+}
+
+uint32_t game_field_player(game_t const *g, uint32_t x, uint32_t y) {
+    if (g == NULL || x >= g->width || y >= g->height) {
+        return NO_PLAYER;
+    }
+    return board_field_player(g->board, x, y);
+}
 
 uint32_t game_board_width(game_t const *g) {
     if (g == NULL) {
@@ -223,9 +1051,102 @@ char* game_board(game_t const *g) {
     return board_draw(g->board);
 }
 
+uint64_t game_board_read(game_t const *g, uint64_t offset, char *buffer,
+                         uint64_t size) {
+    if (g == NULL || buffer == NULL) {
+        return 0;
+    }
+    uint64_t line = (uint64_t)g->width + 1;
+    uint64_t total = line * g->height;
+    uint64_t written = 0;
+    while (written < size && offset < total) {
+        uint64_t column = offset % line;
+        if (column == g->width) {
+            buffer[written++] = '\n';
+            offset++;
+            continue;
+        }
+        uint64_t count = g->width - column;
+        if (count > size - written) {
+            count = size - written;
+        }
+        uint32_t y = g->height - 1 - (uint32_t)(offset / line);
+        board_draw_row(g->board, y, (uint32_t)column, (uint32_t)count,
+                       buffer + written);
+        written += count;
+        offset += count;
+    }
+    return written;
+}
+
+bool game_board_write(game_t const *g, int fd) {
+    if (g == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+    char chunk[GAME_BOARD_CHUNK];
+    uint64_t offset = 0;
+    uint64_t length;
+    while ((length = game_board_read(g, offset, chunk, sizeof(chunk))) > 0) {
+        uint64_t done = 0;
+        while (done < length) {
+            ssize_t n = write(fd, chunk + done, length - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                if (n == 0) {
+                    errno = EIO;
+                }
+                return false;
+            }
+            done += (uint64_t)n;
+        }
+        offset += length;
+    }
+    return true;
+}
+
 uint32_t game_players(game_t const *g) {
     if (g == NULL) {
         return 0;
     }
     return g->players;
 }
+
+uint32_t game_areas(game_t const *g) {
+    if (g == NULL) {
+        return 0;
+    }
+    return g->areas;
+}
+
+bool game_is_over(game_t const *g) {
+    return g == NULL || game_active_players(g) == 0;
+}
+
+uint32_t game_next_active_player(game_t const *g, uint32_t player) {
+    if (g == NULL || player > g->players) {
+        return NO_PLAYER;
+    }
+    uint64_t active = game_active_players(g);
+    uint64_t after = active & ~(((uint64_t)2 << player) - 1);
+    if (after != 0) {
+        return (uint32_t)__builtin_ctzll(after);
+    }
+    return active != 0 ? (uint32_t)__builtin_ctzll(active) : NO_PLAYER;
+}
+
+uint32_t game_leaderboard(game_t const *g, uint32_t rank) {
+    if (g == NULL || rank == 0 || rank > g->players) {
+        return NO_PLAYER;
+    }
+    return g->ranking[rank - 1];
+}
+
+uint32_t game_rank(game_t const *g, uint32_t player) {
+    if (!game_player_correct(g, player)) {
+        return 0;
+    }
+    return g->rank[player] + 1;
+}
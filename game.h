@@ -11,12 +11,77 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "board_order.h"
 
 /**
  * To jest deklaracja struktury przechowującej stan gry.
  */
 typedef struct game game_t;
 
+/**
+ * To jest deklaracja struktury opisującej zapis dziennika ruchów
+ * (zobacz replay.h).
+ */
+typedef struct replay_writer replay_writer_t;
+
+/**
+ * Liczba przedziałów histogramu rozmiarów przekolorowanych obszarów.
+ * Przedział i obejmuje obszary od 2^i do 2^(i+1) - 1 pól, a ostatni
+ * przedział wszystkie większe obszary.
+ */
+#define GAME_STATS_RELABEL_SIZES 16
+
+/**
+ * Liczba bitów numeru podprzedziału potęgi dwójki w histogramie czasu ruchu.
+ */
+#define GAME_STATS_LATENCY_SUB_BITS 4
+
+/**
+ * Liczba podprzedziałów każdej potęgi dwójki w histogramie czasu ruchu.
+ */
+#define GAME_STATS_LATENCY_SUB_BUCKETS (1 << GAME_STATS_LATENCY_SUB_BITS)
+
+/**
+ * Liczba przedziałów histogramu czasu ruchu. Obejmują one czasy do 2^40 ns.
+ */
+#define GAME_STATS_LATENCY_BUCKETS \
+    ((41 - GAME_STATS_LATENCY_SUB_BITS) * GAME_STATS_LATENCY_SUB_BUCKETS)
+
+/**
+ * To jest typ wyliczeniowy opisujący powód odrzucenia ruchu.
+ */
+typedef enum game_reject {
+    GAME_REJECT_NONE,       /**< ruch został wykonany */
+    GAME_REJECT_PLAYER,     /**< niepoprawny numer gracza */
+    GAME_REJECT_FIELD,      /**< pole poza planszą */
+    GAME_REJECT_NO_MOVES,   /**< gracz nie może wykonać żadnego ruchu */
+    GAME_REJECT_BUSY,       /**< pole jest zajęte */
+    GAME_REJECT_AREAS,      /**< ruch przekroczyłby limit obszarów */
+    GAME_REJECT_MEMORY,     /**< nie udało się alokować pamięci */
+    GAME_REJECT_REASONS     /**< liczba powodów */
+} game_reject_t;
+
+/**
+ * To jest struktura przechowująca statystyki gry. Histogram czasu ruchu
+ * ma przedziały o stałej względnej dokładności: przedział @p i obejmuje
+ * czasy od @ref game_stats_latency_bucket(i) do
+ * @ref game_stats_latency_bucket(i + 1) nanosekund.
+ */
+typedef struct game_stats {
+    uint64_t calls;                             /**< wywołania game_move */
+    uint64_t moves;                             /**< wykonane ruchy */
+    uint64_t rejected[GAME_REJECT_REASONS];     /**< odrzucone ruchy */
+    uint64_t merged[5];                         /**< ruchy łączące n obszarów */
+    uint64_t merges;                            /**< łącznie połączone obszary */
+    uint64_t relabels;                          /**< przekolorowane obszary */
+    uint64_t relabel_cells;                     /**< przekolorowane pola */
+    uint64_t relabel_max;                       /**< największy z obszarów */
+    uint64_t relabel_sizes[GAME_STATS_RELABEL_SIZES];
+    uint64_t latency_ns;                        /**< łączny czas ruchów */
+    uint64_t latency_max;                       /**< najdłuższy ruch */
+    uint64_t latency[GAME_STATS_LATENCY_BUCKETS];
+} game_stats_t;
+
 /** @brief Tworzy strukturę przechowującą stan gry.
  * Alokuje pamięć na nową strukturę przechowującą stan gry.
  * Inicjuje tę strukturę, tak aby reprezentowała początkowy stan gry.
@@ -32,6 +97,115 @@ typedef struct game game_t;
 game_t* game_new(uint32_t width, uint32_t height,
                  uint32_t players, uint32_t areas);
 
+/**
+ * To jest struktura przechowująca dodatkowe opcje tworzenia gry.
+ */
+typedef struct game_options {
+    bool huge_pages;    /**< mapuje stan gry dużymi stronami pamięci, o ile
+                             system je udostępnia */
+    board_order_t order; /**< kolejność pól planszy w pamięci; nie zmienia
+                              zachowania gry, tylko jej wydajność */
+} game_options_t;
+
+/** @brief Tworzy strukturę przechowującą stan gry z dodatkowymi opcjami.
+ * Działa jak @ref game_new. Cały stan gry poza indeksem dozwolonych ruchów,
+ * historią i statystykami leży w jednym bloku pamięci, którego rozmiar
+ * wynika z parametrów gry; strony tego bloku są przydzielane przy pierwszym
+ * zapisie.
+ * @param[in] width   – szerokość planszy, liczba dodatnia,
+ * @param[in] height  – wysokość planszy, liczba dodatnia,
+ * @param[in] players – liczba graczy, liczba dodatnia,
+ * @param[in] areas   – maksymalna liczba obszarów, które może zająć jeden
+ *                      gracz, liczba dodatnia,
+ * @param[in] options – wskaźnik na opcje lub NULL dla opcji domyślnych.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się alokować
+ * pamięci lub któryś z parametrów jest niepoprawny.
+ */
+game_t* game_new_with_options(uint32_t width, uint32_t height,
+                              uint32_t players, uint32_t areas,
+                              game_options_t const *options);
+
+/** @brief Rozgałęzia stan gry.
+ * Tworzy nową strukturę przechowującą stan gry @p g. Obie gry współdzielą
+ * niezmienione kafelki planszy i strony struktury obszarów; gra, która
+ * pierwsza zmienia współdzielony kafelek, kopiuje go. Rozgałęzienie działa
+ * w czasie proporcjonalnym do liczby kafelków (kwadratów 64 na 64 pola),
+ * a pamięć gier rośnie tylko o kafelki zmienione w każdej z nich. Historia
+ * ruchów, statystyki i indeks dozwolonych ruchów nie są kopiowane. Gry
+ * współdzielące kafelki mogą być używane jednocześnie w różnych wątkach.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in] g       – wskaźnik na rozgałęzianą strukturę.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się alokować
+ * pamięci lub wskaźnik @p g ma wartość NULL.
+ */
+game_t* game_fork(game_t const *g);
+
+/**
+ * To jest deklaracja struktury opisującej zapis migawki gry w tle.
+ */
+typedef struct game_save game_save_t;
+
+/** @brief Zapisuje migawkę gry.
+ * Zapisuje stan gry @p g do deskryptora @p fd jednym sekwencyjnym
+ * przebiegiem, od bieżącej pozycji deskryptora. Migawka jest wersjonowanym
+ * plikiem binarnym zawierającym liczniki graczy, liczbę wolnych pól, pola
+ * graczy i strukturę obszarów; historia ruchów, statystyki i indeks
+ * dozwolonych ruchów nie są zapisywane. Gdy zapis się nie powiódł, @p errno
+ * opisuje błąd.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] fd      – deskryptor otwarty do zapisu.
+ * @return Wartość @p true, jeśli migawka została zapisana, a @p false
+ * w przeciwnym przypadku.
+ */
+bool game_save(game_t const *g, int fd);
+
+/** @brief Wczytuje migawkę gry.
+ * Mapuje do pamięci migawkę zapisaną przez @ref game_save i tworzy grę
+ * w zapisanym stanie. Sprawdza nagłówek, położenie i sumy kontrolne sekcji
+ * migawki oraz zawartość liczników graczy, kafelków i stron (numery graczy
+ * i kolory), więc czyta cały plik, ale nie odtwarza stanu pole po polu:
+ * plansza czyta kafelki bezpośrednio z migawki i kopiuje je dopiero przy
+ * pierwszej zmianie, tak jak kopie tworzone przez @ref game_fork. Migawka
+ * pozostaje zmapowana, dopóki istnieje wczytana gra lub któraś z jej kopii.
+ * Pliku nie należy w tym czasie nadpisywać ani skracać; nową migawkę
+ * należy zapisać do innego pliku i podmienić nim stary funkcją @p rename.
+ * Gdy plik nie jest poprawną migawką, ustawia @p errno na @p EINVAL.
+ * @param[in] path    – ścieżka do pliku z migawką.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ * wczytać migawki; @p errno opisuje wtedy błąd.
+ */
+game_t* game_load(const char *path);
+
+/** @brief Rozpoczyna zapis migawki gry w tle.
+ * Rozgałęzia grę @p g przez @ref game_fork i zapisuje kopię do deskryptora
+ * @p fd w osobnym wątku, więc gra @p g może być dalej zmieniana podczas
+ * zapisu. Migawka opisuje stan z chwili wywołania. Deskryptor nie może być
+ * używany do czasu wywołania @ref game_save_wait.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] fd      – deskryptor otwarty do zapisu.
+ * @return Wskaźnik na strukturę opisującą zapis lub NULL, gdy nie udało się
+ * go rozpocząć; @p errno opisuje wtedy błąd.
+ */
+game_save_t* game_save_async(game_t const *g, int fd);
+
+/** @brief Czeka na zakończenie zapisu migawki w tle.
+ * Czeka na zakończenie zapisu rozpoczętego przez @ref game_save_async
+ * i zwalnia strukturę @p save.
+ * @param[in] save    – wskaźnik na strukturę opisującą zapis.
+ * @return Wartość @p true, jeśli migawka została zapisana, a @p false
+ * w przeciwnym przypadku; @p errno opisuje wtedy błąd.
+ */
+bool game_save_wait(game_save_t *save);
+
+/** @brief Przywraca grę do stanu początkowego.
+ * Przywraca strukturę wskazywaną przez @p g do stanu zaraz po wywołaniu
+ * @ref game_new z tymi samymi parametrami, nie zwalniając zaalokowanej
+ * pamięci. Długość historii ruchów pozostaje bez zmian, a zapamiętane
+ * ruchy są zapominane. Nic nie robi, jeśli wskaźnik @p g ma wartość NULL.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ */
+void game_reset(game_t *g);
+
 /** @brief Usuwa strukturę przechowującą stan gry.
  * Usuwa z pamięci strukturę wskazywaną przez @p g.
  * Nic nie robi, jeśli wskaźnik ten ma wartość NULL.
@@ -54,6 +228,31 @@ void game_delete(game_t *g);
  */
 bool game_move(game_t *g, uint32_t player, uint32_t x, uint32_t y);
 
+/** @brief Ustawia długość historii ruchów.
+ * Ustala, ile ostatnich ruchów można wycofać funkcją @ref game_undo.
+ * Zapomina dotychczas zapamiętane ruchy. Gdy historia jest pełna, kolejny
+ * ruch wypiera z niej najstarszy. Gdy historia jest włączona, struktura
+ * obszarów nie skraca ścieżek, więc ruchy mogą być nieco wolniejsze.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] length  – maksymalna liczba pamiętanych ruchów, zero wyłącza
+ *                      historię.
+ * @return Wartość @p true, jeśli historia została ustawiona, a @p false,
+ * gdy wskaźnik @p g ma wartość NULL.
+ */
+bool game_set_history(game_t *g, uint64_t length);
+
+/** @brief Wycofuje ostatni ruch.
+ * Przywraca stan gry sprzed ostatniego zapamiętanego w historii ruchu.
+ * Działa w czasie proporcjonalnym do pracy wykonanej przez ten ruch.
+ * Gdy wycofanie wymaga skopiowania kafelka współdzielonego z inną grą,
+ * a nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli ruch został wycofany, a @p false,
+ * gdy historia jest pusta, nie udało się alokować pamięci lub wskaźnik
+ * @p g ma wartość NULL.
+ */
+bool game_undo(game_t *g);
+
 /** @brief Podaje liczbę pól zajętych przez gracza.
  * Podaje liczbę pól zajętych przez gracza @p player.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
@@ -75,6 +274,126 @@ uint64_t game_busy_fields(game_t const *g, uint32_t player);
  */
 uint64_t game_free_fields(game_t const *g, uint32_t player);
 
+/** @brief Wyznacza pole, na którym gracz może postawić pionek.
+ * Pola, na których gracz @p player może postawić pionek w następnym ruchu,
+ * mają numery od 0 do wartości @ref game_free_fields pomniejszonej o jeden.
+ * Funkcja zapisuje współrzędne pola o numerze @p n. Numeracja nie zmienia
+ * się do następnego ruchu, więc wywołania dla kolejnych @p n wyliczają
+ * wszystkie takie pola, a wywołanie dla losowego @p n losuje jedno z nich
+ * z rozkładem jednostajnym. Dla dużej planszy pierwsze wywołanie buduje
+ * indeks pól, który jest potem aktualizowany przy każdym ruchu.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref game_new,
+ * @param[in] n       – numer pola, liczba nieujemna mniejsza od wartości
+ *                      @ref game_free_fields dla gracza @p player,
+ * @param[out] x      – wskaźnik na numer kolumny pola,
+ * @param[out] y      – wskaźnik na numer wiersza pola.
+ * @return Wartość @p true, jeśli pole zostało wyznaczone, a @p false,
+ * gdy któryś z parametrów jest niepoprawny, wskaźnik @p g ma wartość NULL
+ * lub nie udało się alokować pamięci.
+ */
+bool game_legal_move(game_t *g, uint32_t player, uint64_t n,
+                     uint32_t *x, uint32_t *y);
+
+/** @brief Włącza lub wyłącza zbieranie statystyk.
+ * Włączenie zeruje statystyki. Gdy statystyki są wyłączone, ich obsługa
+ * kosztuje jedno porównanie na ruch.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] enabled – czy zbierać statystyki.
+ * @return Wartość @p true, jeśli operacja się powiodła, a @p false,
+ * gdy wskaźnik @p g ma wartość NULL lub nie udało się alokować pamięci.
+ */
+bool game_set_stats(game_t *g, bool enabled);
+
+/** @brief Ustawia dziennik ruchów.
+ * Od tej chwili każdy wykonany ruch, wycofanie ruchu i przywrócenie gry do
+ * stanu początkowego jest dopisywane do dziennika @p log, utworzonego dla
+ * gry o tych samych parametrach. Gra nie staje się właścicielem dziennika;
+ * musi on istnieć, dopóki jest ustawiony. Błędy zapisu są zapamiętywane
+ * w dzienniku i zgłaszane przez @ref replay_writer_close. Kopie gry nie
+ * dziedziczą dziennika. Gdy dziennik nie jest ustawiony, jego obsługa
+ * kosztuje jedno porównanie na ruch. Wartość NULL wyłącza zapisywanie.
+ * Nic nie robi, jeśli wskaźnik @p g ma wartość NULL.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] log     – wskaźnik na dziennik lub NULL.
+ */
+void game_set_replay(game_t *g, replay_writer_t *log);
+
+/** @brief Podaje statystyki gry.
+ * Kopiuje zebrane statystyki do struktury wskazywanej przez @p stats.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[out] stats  – wskaźnik na strukturę statystyk.
+ * @return Wartość @p true, jeśli statystyki zostały skopiowane, a @p false,
+ * gdy zbieranie statystyk jest wyłączone lub któryś ze wskaźników ma
+ * wartość NULL.
+ */
+bool game_stats(game_t const *g, game_stats_t *stats);
+
+/** @brief Podaje dolną granicę przedziału histogramu czasu ruchu.
+ * @param[in] bucket  – numer przedziału, liczba nieujemna niewiększa od
+ *                      @ref GAME_STATS_LATENCY_BUCKETS.
+ * @return Najmniejszy czas w nanosekundach należący do przedziału.
+ */
+uint64_t game_stats_latency_bucket(uint32_t bucket);
+
+/** @brief Podaje kwantyl czasu ruchu.
+ * @param[in] stats   – wskaźnik na strukturę statystyk,
+ * @param[in] q       – rząd kwantyla, liczba z przedziału [0, 1].
+ * @return Górne oszacowanie kwantyla w nanosekundach lub zero, gdy nie
+ * zmierzono żadnego ruchu.
+ */
+uint64_t game_stats_latency_quantile(game_stats_t const *stats, double q);
+
+/** @brief Podaje rozmiar pamięci zajmowanej przez grę.
+ * Podaje łączną liczbę bajtów zaalokowanych dla struktury przechowującej
+ * stan gry, w tym dla planszy, indeksu dozwolonych ruchów i historii.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Liczba bajtów lub zero, gdy wskaźnik @p g ma wartość NULL.
+ */
+uint64_t game_memory(game_t const *g);
+
+/** @brief Podaje skrót pozycji.
+ * Zwraca 64-bitowy skrót Zobrista planszy, aktualizowany przy każdym ruchu
+ * i jego wycofaniu, więc działa w czasie stałym. Pozycje o tych samych
+ * zajętych polach mają ten sam skrót niezależnie od kolejności ruchów
+ * i opcji gry, a różne pozycje mają różne skróty z prawdopodobieństwem
+ * bliskim jedności. Skrót jest zachowywany przez @ref game_fork i migawki,
+ * a pusta plansza ma skrót zero. Gra nie przechowuje gracza, który ma
+ * wykonać ruch, więc skrót go nie obejmuje.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Skrót pozycji lub zero, gdy wskaźnik @p g ma wartość NULL.
+ */
+uint64_t game_hash(game_t const *g);
+
+/** @brief Podaje wielkość obszaru.
+ * Podaje liczbę pól obszaru, do którego należy pole (@p x, @p y).
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
+ *                      @p width z funkcji @ref game_new,
+ * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
+ *                      @p height z funkcji @ref game_new.
+ * @return Liczba pól obszaru lub zero, gdy pole jest puste, któryś
+ * z parametrów jest niepoprawny lub wskaźnik @p g ma wartość NULL.
+ */
+uint64_t game_area_size(game_t const *g, uint32_t x, uint32_t y);
+
+/** @brief Podaje gracza zajmującego pole.
+ * Pozwala odczytać pojedyncze pola planszy bez tworzenia napisu
+ * @ref game_board.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
+ *                      @p width z funkcji @ref game_new,
+ * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
+ *                      @p height z funkcji @ref game_new.
+ * @return Numer gracza zajmującego pole lub @p NO_PLAYER, gdy pole jest
+ * puste, któryś z parametrów jest niepoprawny lub wskaźnik @p g ma wartość
+ * NULL.
+ */
+uint32_t game_field_player(game_t const *g, uint32_t x, uint32_t y);
+
 /** Podaje szerokość planszy.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Szerokość planszy lub zero, gdy wskaźnik @p g ma wartość NULL.
@@ -93,6 +412,59 @@ uint32_t game_board_height(game_t const *g);
  */
 uint32_t game_players(game_t const *g);
 
+/** Podaje maksymalną liczbę obszarów gracza.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Maksymalna liczba obszarów lub zero, gdy wskaźnik @p g ma wartość
+ * NULL.
+ */
+uint32_t game_areas(game_t const *g);
+
+/** @brief Sprawdza, czy gra się zakończyła.
+ * Gra kończy się, gdy żaden gracz nie może wykonać ruchu. Działa w czasie
+ * stałym: silnik aktualizuje zbiór graczy, którzy mogą wykonać ruch,
+ * przy każdym ruchu.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli żaden gracz nie może wykonać ruchu lub
+ * wskaźnik @p g ma wartość NULL, a @p false w przeciwnym przypadku.
+ */
+bool game_is_over(game_t const *g);
+
+/** @brief Podaje kolejnego gracza, który może wykonać ruch.
+ * Szuka gracza, dla którego @ref game_free_fields jest dodatnie, zaczynając
+ * od gracza o numerze o jeden większym od @p player i wracając cyklicznie do
+ * gracza numer 1; gracz @p player jest sprawdzany jako ostatni. Działa
+ * w czasie stałym.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, który wykonał ostatni ruch, lub
+ *                      @p NO_PLAYER, aby znaleźć pierwszego takiego gracza.
+ * @return Numer gracza lub @p NO_PLAYER, gdy gra się zakończyła, numer
+ * gracza jest niepoprawny lub wskaźnik @p g ma wartość NULL.
+ */
+uint32_t game_next_active_player(game_t const *g, uint32_t player);
+
+/** @brief Podaje gracza zajmującego zadane miejsce w rankingu.
+ * Ranking porządkuje graczy malejąco według liczby zajętych pól. Gracze
+ * z tą samą liczbą pól zajmują kolejne miejsca w nieokreślonej kolejności.
+ * Silnik aktualizuje ranking przy każdym ruchu w czasie logarytmicznym
+ * względem liczby graczy, a zapytanie działa w czasie stałym.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] rank    – miejsce w rankingu, liczba dodatnia niewiększa od
+ *                      liczby graczy.
+ * @return Numer gracza lub @p NO_PLAYER, gdy miejsce jest niepoprawne lub
+ * wskaźnik @p g ma wartość NULL.
+ */
+uint32_t game_leaderboard(game_t const *g, uint32_t rank);
+
+/** @brief Podaje miejsce gracza w rankingu.
+ * Działa w czasie stałym; zobacz @ref game_leaderboard.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref game_new.
+ * @return Miejsce gracza, liczone od 1, lub zero, gdy numer gracza jest
+ * niepoprawny lub wskaźnik @p g ma wartość NULL.
+ */
+uint32_t game_rank(game_t const *g, uint32_t player);
+
 /** Daje symbole wykorzystywane w funkcji @ref game_board.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
  * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
@@ -114,4 +486,32 @@ char game_player(game_t const *g, uint32_t player);
  */
 char* game_board(game_t const *g);
 
+/** @brief Kopiuje fragment napisu opisującego stan planszy.
+ * Zapisuje do bufora @p buffer kolejne bajty napisu z funkcji
+ * @ref game_board (bez kończącego go znaku '\0'), zaczynając od bajtu
+ * @p offset. Nie alokuje pamięci, więc planszę dowolnego rozmiaru można
+ * wypisać kawałkami w buforze stałego rozmiaru. Wiersz
+ * napisu ma @p width + 1 bajtów, a cały napis (@p width + 1) * @p height.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] offset  – numer pierwszego kopiowanego bajtu napisu,
+ * @param[out] buffer – bufor na skopiowane bajty,
+ * @param[in] size    – rozmiar bufora.
+ * @return Liczba skopiowanych bajtów: @p size lub mniej, gdy napis się
+ * skończył, albo zero, gdy wskaźnik @p g lub @p buffer ma wartość NULL.
+ */
+uint64_t game_board_read(game_t const *g, uint64_t offset, char *buffer,
+                         uint64_t size);
+
+/** @brief Zapisuje napis opisujący stan planszy do deskryptora.
+ * Zapisuje do deskryptora @p fd napis z funkcji @ref game_board (bez
+ * kończącego go znaku '\0') fragmentami stałego rozmiaru, korzystając
+ * z @ref game_board_read, więc nie alokuje pamięci zależnej od rozmiaru
+ * planszy.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] fd      – deskryptor otwarty do zapisu.
+ * @return Wartość @p true lub @p false, gdy wskaźnik @p g ma wartość NULL
+ * lub zapis się nie powiódł; @p errno opisuje wtedy błąd.
+ */
+bool game_board_write(game_t const *g, int fd);
+
 #endif /* GAME_H */
\ No newline at end of file
@@ -5,12 +5,22 @@
  * @date 2023
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "batch_mode.h"
 #include "constants.h"
 #include "game.h"
 #include "interactive_mode.h"
+#include "mcts.h"
+#include "replay.h"
 #include "safe_memory_allocation.h"
+#include "selfplay.h"
 
 typedef struct game game_t;
 
@@ -27,37 +37,251 @@ static uint32_t parse_uint32(const char* str) {
     return number;
 }
 
+/**
+ * Konwertuje listę numerów graczy oddzielonych przecinkami na maskę bitową.
+ * Zwraca 0, jeśli lista jest niepoprawna.
+ */
+static uint64_t parse_players(const char* str) {
+    uint64_t mask = 0;
+    while (*str != '\0') {
+        char *endptr;
+        errno = 0;
+        unsigned long player = strtoul(str, &endptr, 10);
+        if (errno != 0 || endptr == str || player == 0
+            || player > MAX_NUMBER_OF_PLAYERS
+            || (*endptr != ',' && *endptr != '\0')) {
+            return 0;
+        }
+        mask |= (uint64_t)1 << player;
+        str = *endptr == ',' ? endptr + 1 : endptr;
+    }
+    return mask;
+}
+
+/**
+ * Rozgrywa losowe gry i wypisuje ich podsumowanie.
+ */
+static int run_selfplay(const selfplay_params_t *params) {
+    selfplay_result_t result;
+    if (!selfplay_run(params, &result)) {
+        fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+        return MEMORY_ERROR;
+    }
+    printf("gry: %lu\nruchy: %lu\nwątki: %u\nczas: %.3f s\n"
+           "gry/s: %.1f\nruchy/s: %.0f\nremisy: %lu\n",
+           result.games, result.moves, result.threads, result.seconds,
+           (double)result.games / result.seconds,
+           (double)result.moves / result.seconds, result.draws);
+    for (uint32_t p = 1; p <= params->players; p++) {
+        printf("gracz %u: wygrane %lu, średnio pól %.2f\n", p, result.wins[p],
+               result.games > 0
+               ? (double)result.fields[p] / (double)result.games : 0.0);
+    }
+    return 0;
+}
+
+/**
+ * Otwiera dziennik ruchów @p path do dopisywania i ustawia go w grze @p g.
+ * Zwraca NULL, gdy się to nie udało.
+ */
+static replay_writer_t* open_replay(game_t *g, const char *path, int *fd) {
+    *fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (*fd < 0) {
+        return NULL;
+    }
+    replay_writer_t *log = replay_writer_open(*fd, game_board_width(g),
+                                              game_board_height(g),
+                                              game_players(g), game_areas(g));
+    if (log == NULL) {
+        close(*fd);
+        return NULL;
+    }
+    game_set_replay(g, log);
+    return log;
+}
+
+/**
+ * Zapisuje resztę dziennika ruchów i zamyka go. Zwraca false, gdy któryś
+ * zapis się nie powiódł.
+ */
+static bool close_replay(replay_writer_t *log, int fd) {
+    if (log == NULL) {
+        return true;
+    }
+    bool ok = replay_writer_close(log);
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "Nie udało się zapisać dziennika ruchów.\n");
+    }
+    return ok;
+}
+
+/**
+ * Wypisuje sposób użycia programu.
+ */
+static int usage(const char *name) {
+    fprintf(stderr, "Użycie:\n%s [-b] [-i plik] [-a gracze] [-n symulacje] "
+                    "[-t ms] [-j wątki] [-s gry] [-S] [-l plik] [-D] "
+                    "[-w plik] width height players areas\n"
+                    "%s [opcje] -r plik\n"
+                    "  -b       tryb wsadowy (polecenia ze standardowego wejścia)\n"
+                    "  -i plik  tryb wsadowy (polecenia z pliku)\n"
+                    "  -a lista numery komputerowych graczy, np. 2,3\n"
+                    "  -n liczba symulacji na ruch komputerowego gracza\n"
+                    "  -t ms    limit czasu na ruch komputerowego gracza\n"
+                    "  -j liczba wątków komputerowego gracza lub symulacji\n"
+                    "  -s liczba losowych gier do rozegrania (symulacja)\n"
+                    "  -S       zbiera statystyki ruchów (tryb wsadowy)\n"
+                    "  -l plik  dopisuje ruchy do dziennika ruchów\n"
+                    "  -D       wypisuje opóźnienie klatek (tryb interaktywny)\n"
+                    "  -r plik  wczytuje grę z migawki zamiast tworzyć nową\n"
+                    "  -w plik  plik migawki zapisywanej poleceniem z "
+                    "(tryb wsadowy)\n",
+            name, name);
+    return WRONG_INPUT;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc == 5) {
-        uint32_t w = parse_uint32(argv[1]);
+    bool batch = false;
+    const char *input = NULL;
+    uint64_t bots = 0;
+    uint64_t games = 0;
+    bool stats = false;
+    const char *replay = NULL;
+    bool overlay = false;
+    const char *restore = NULL;
+    const char *snapshot = NULL;
+    mcts_params_t bot = mcts_default_params();
+    int opt;
+    while ((opt = getopt(argc, argv, "bi:a:n:t:j:s:Sl:Dr:w:")) != -1) {
+        switch (opt) {
+            case 'b':
+                batch = true;
+                break;
+            case 'i':
+                batch = true;
+                input = optarg;
+                break;
+            case 'a':
+                bots = parse_players(optarg);
+                if (bots == 0) {
+                    return usage(argv[0]);
+                }
+                break;
+            case 'n':
+                bot.playouts = parse_uint32(optarg);
+                break;
+            case 't':
+                bot.time_ms = parse_uint32(optarg);
+                break;
+            case 'j':
+                bot.threads = parse_uint32(optarg);
+                break;
+            case 's':
+                games = parse_uint32(optarg);
+                if (games == 0) {
+                    return usage(argv[0]);
+                }
+                break;
+            case 'S':
+                stats = true;
+                break;
+            case 'l':
+                replay = optarg;
+                break;
+            case 'D':
+                overlay = true;
+                break;
+            case 'r':
+                restore = optarg;
+                break;
+            case 'w':
+                snapshot = optarg;
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (argc - optind != (restore != NULL ? 0 : 4)
+        || (restore != NULL && games > 0)) {
+        return usage(argv[0]);
+    }
+    argv += optind;
+
+    uint32_t w = 0, h = 0, players = 0, areas = 0;
+    if (restore == NULL) {
+        w = parse_uint32(argv[0]);
         if (w == 0) {
             fprintf(stderr, "Niepoprawna szerokość.\n");
             return WRONG_INPUT;
         }
-        uint32_t h = parse_uint32(argv[2]);
+        h = parse_uint32(argv[1]);
         if (h == 0) {
             fprintf(stderr, "Niepoprawna wysokość.\n");
             return WRONG_INPUT;
         }
-        uint32_t players = parse_uint32(argv[3]);
+        players = parse_uint32(argv[2]);
         if (players == 0 || players > MAX_NUMBER_OF_PLAYERS) {
             fprintf(stderr, "Niepoprawna liczba graczy.\n");
             return WRONG_INPUT;
         }
-        uint32_t areas = parse_uint32(argv[4]);
+        areas = parse_uint32(argv[3]);
         if (areas == 0) {
             fprintf(stderr, "Niepoprawna liczba obszarów.\n");
             return WRONG_INPUT;
         }
+    }
+
+    if (games > 0) {
+        selfplay_params_t params = {.width = w, .height = h, .players = players,
+                                    .areas = areas, .games = games,
+                                    .threads = bot.threads, .seed = bot.seed};
+        return run_selfplay(&params);
+    }
 
-        game_t *g = game_new(w, h, players, areas);
-        if (g == NULL) {
-            fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
-            return MEMORY_ERROR;
+    int fd = STDIN_FILENO;
+    if (input != NULL) {
+        fd = open(input, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Nie udało się otworzyć pliku.\n");
+            return WRONG_INPUT;
         }
-        run_interactive(g);
-        return 0;
     }
-    fprintf(stderr, "Użycie:\n%s width height players areas\n", argv[0]);
-    return WRONG_INPUT;
-}
\ No newline at end of file
+
+    game_t *g;
+    if (restore != NULL) {
+        g = game_load(restore);
+        if (g == NULL && errno != ENOMEM) {
+            fprintf(stderr, "Nie udało się wczytać migawki.\n");
+            return WRONG_INPUT;
+        }
+    }
+    else {
+        g = game_new(w, h, players, areas);
+    }
+    if (g == NULL || (stats && !game_set_stats(g, true))) {
+        game_delete(g);
+        fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+        return MEMORY_ERROR;
+    }
+    int log_fd = -1;
+    replay_writer_t *log = NULL;
+    if (replay != NULL && (log = open_replay(g, replay, &log_fd)) == NULL) {
+        game_delete(g);
+        fprintf(stderr, "Nie udało się otworzyć dziennika ruchów.\n");
+        return WRONG_INPUT;
+    }
+    if (!batch) {
+        run_interactive(g, bots, &bot, overlay);
+        return close_replay(log, log_fd) ? 0 : WRONG_INPUT;
+    }
+    int status = run_batch(g, fd, &bot, snapshot);
+    game_delete(g);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (!close_replay(log, log_fd) && status == 0) {
+        status = WRONG_INPUT;
+    }
+    return status;
+}
@@ -5,8 +5,13 @@
  * @date 2023
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
+#include <poll.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <termios.h>
@@ -15,8 +20,52 @@
 #include <sys/ioctl.h>
 #include "game.h"
 #include "interactive_mode.h"
+#include "mcts.h"
+#include "screen.h"
 #include "constants.h"
 
+/**
+ * Maksymalna długość tekstu ze statystykami gry.
+ */
+#define STATUS_LENGTH 512
+
+/**
+ * Maksymalna długość wiersza wyniku gry.
+ */
+#define RESULT_LENGTH 64
+
+/**
+ * Rozmiar bufora wczytanych i jeszcze nieobsłużonych klawiszy.
+ */
+#define INPUT_LENGTH 4096
+
+/**
+ * Najkrótszy odstęp między klatkami w nanosekundach (60 klatek na sekundę).
+ */
+#define FRAME_INTERVAL_NS 16666667
+
+/**
+ * Czas w milisekundach, po którym niedokończona sekwencja strzałki jest
+ * odrzucana.
+ */
+#define ESCAPE_TIMEOUT_MS 50
+
+/**
+ * To jest struktura przechowująca pomiary klatek: opóźnienie między
+ * wczytaniem najstarszego klawisza a zapisaniem klatki, która go
+ * uwzględnia, i liczbę klawiszy obsłużonych w jednej klatce.
+ */
+typedef struct latency {
+    bool overlay;           /* Czy wypisywać pomiary pod planszą. */
+    uint64_t input;         /* Czas wczytania najstarszego klawisza lub 0. */
+    uint32_t keys;          /* Klawisze od poprzedniej klatki. */
+    uint32_t last_keys;     /* Klawisze poprzedniej klatki z klawiszami. */
+    uint64_t last;          /* Opóźnienie tej klatki w nanosekundach. */
+    uint64_t max;           /* Największe opóźnienie. */
+    uint64_t frames;        /* Liczba narysowanych klatek. */
+    uint64_t frame;         /* Czas zapisania poprzedniej klatki. */
+} latency_t;
+
 /**
 * Czyści terminal.
 */
@@ -25,114 +74,135 @@ static void clear() {
 }
 
 /**
- * Wypisuje komórkę planszy.
+ * Zwraca czas zegara monotonicznego w nanosekundach.
  */
-static void print_board_cell(char* board, uint64_t* i, int64_t current_player) {
-    uint32_t player;
-    if (board[*i] == '.') {
-        player = 0;
-    }
-    else if (board[*i] >= '1' && board[*i] <= '9') {
-        player = board[*i] - '0';
-    }
-    else if (board[*i] >= 'A' && board[*i] <= 'Z') {
-        player = board[*i] - 'A' + 10;
-    }
-    else {
-        player = -1;
-    }
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
 
-    if (current_player != -1 && player == current_player) {
-        printf("\x1b[38;2;%sm", DARK_ORCHID);
+/**
+ * Zwraca liczbę milisekund (zaokrągloną w górę), po której można narysować
+ * kolejną klatkę, lub 0, gdy można ją narysować od razu.
+ */
+static int frame_wait(const latency_t *latency) {
+    uint64_t elapsed = now_ns() - latency->frame;
+    if (latency->frames == 0 || elapsed >= FRAME_INTERVAL_NS) {
+        return 0;
     }
-    else if (player == 0) {
-        printf("\x1b[38;2;%sm", MINT_GREEN);
+    return (int)((FRAME_INTERVAL_NS - elapsed + 999999) / 1000000);
+}
+
+/**
+ * Dopisuje do @p status pomiary poprzednich klatek.
+ */
+static void format_latency(const latency_t *latency, char *status) {
+    size_t length = strlen(status);
+    snprintf(status + length, STATUS_LENGTH - length,
+             "\x1b[38;2;%smOpóźnienie: %lu us (maks. %lu us), klawisze: %u, "
+             "klatki: %lu\n\x1b[0m", DARK_WASHED_BLUE, latency->last / 1000,
+             latency->max / 1000, latency->last_keys, latency->frames);
+}
+
+/**
+ * Zapisuje w @p status statystyki gry.
+ */
+static void format_stats(game_t *g, uint32_t current_player, bool move_failed,
+                         char *status) {
+    int length = snprintf(status, STATUS_LENGTH,
+                          "\x1b[38;2;%smWykonaj ruch! Gracz: %d\nSymbol: %c\n"
+                          "Dostępne pola: %lu\n\x1b[0m", DARK_ORCHID,
+                          current_player, game_player(g, current_player),
+                          game_free_fields(g, current_player));
+    if (move_failed && length > 0 && length < STATUS_LENGTH) {
+        snprintf(status + length, STATUS_LENGTH - (size_t)length,
+                 "\x1b[38;2;%smNiemożliwy do wykonania ruch.\n\x1b[0m",
+                 DARK_WASHED_BLUE);
     }
-    printf("%c", board[*i]);
-    printf("\x1b[0m");
 }
 
 /**
- * Wypisuje planszę.
+ * Ustawia tekst pod planszą i rysuje klatkę. Kończy program, gdy się
+ * to nie udało.
  */
-static void print_board(game_t *g, uint32_t cursor_x, uint32_t cursor_y, int64_t current_player) {
-    clear();
-    char* board = game_board(g);
-    if (!board) {
+static void flush_frame(screen_t *s, game_t *g, const char *status) {
+    if (!screen_set_status(s, status) || !screen_flush(s)) {
+        screen_delete(s);
         game_delete(g);
-        fprintf(stderr, "Nie udało się wczytać planszy.\n");
+        fprintf(stderr, "Nie udało się narysować planszy.\n");
         exit(1);
     }
-    uint64_t i = 0;
-    uint32_t current_x_pos = 0;
-    uint32_t current_y_pos = 0;
-    while (board[i] != '\0') {
-        //nowy wiersz
-        if (board[i] == '\n') {
-            current_y_pos++;
-            current_x_pos = 0;
-            i++;
-            printf("\n");
-            continue;
-        }
-        //kolorowanie kursora
-        if (cursor_x == current_x_pos && cursor_y == current_y_pos) {
-            printf("\x1b[48;2;%sm", DARK_ORCHID);
-            printf("\x1b[30m");
-        }
-        print_board_cell(board, &i, current_player);
-        printf("\x1b[0m");
-        i++;
-        current_x_pos++;
-    }
-    free(board);
 }
 
 /**
- * Wypisuje statystyki gry.
+ * Rysuje klatkę: planszę z kursorem i wyróżnionymi polami gracza oraz
+ * statystyki gry. Wypisuje tylko zmiany od poprzedniej klatki.
  */
-static void print_stats(game_t *g, uint32_t current_player, bool move_failed) {
-    printf("\x1b[38;2;%sm", DARK_ORCHID);
-    printf("Wykonaj ruch! Gracz: %d\nSymbol: %c\n", current_player,
-           game_player(g, current_player));
-    printf("Dostępne pola: %lu\n",
-           game_free_fields(g, current_player));
-    printf("\x1b[0m");
-    if (move_failed) {
-        printf("\x1b[38;2;%sm", DARK_WASHED_BLUE);
-        printf("Niemożliwy do wykonania ruch.\n");
-        printf("\x1b[0m");
+static void show_frame(screen_t *s, game_t *g, uint32_t cursor_x,
+                       uint32_t cursor_y, uint32_t current_player,
+                       bool move_failed, latency_t *latency) {
+    char status[STATUS_LENGTH];
+    format_stats(g, current_player, move_failed, status);
+    if (latency->overlay) {
+        format_latency(latency, status);
+    }
+    screen_set_cursor(s, true, cursor_x, game_board_height(g) - cursor_y - 1);
+    screen_set_player(s, current_player);
+    flush_frame(s, g, status);
+    latency->frame = now_ns();
+    latency->frames++;
+    if (latency->input != 0) {
+        latency->last = latency->frame - latency->input;
+        if (latency->last > latency->max) {
+            latency->max = latency->last;
+        }
+        latency->last_keys = latency->keys;
+        latency->keys = 0;
+        latency->input = 0;
     }
 }
 
 /** 
-* Wypisuje wynik gry.
+* Wypisuje wynik gry pod widokiem planszy bez kursora.
 */
-static inline void print_game_results(game_t *g) {
-    clear();
-    printf("Finalny stan gry:\n\n");
-    print_board(g, 0, 0, -1);
-    printf("\nWynik:\n");
+static inline void print_game_results(screen_t *s, game_t *g) {
+    char results[(MAX_NUMBER_OF_PLAYERS + 1) * RESULT_LENGTH];
+    size_t length = (size_t)snprintf(results, sizeof(results), "\nWynik:\n");
     for (uint32_t i = 1; i <= game_players(g); i++) {
-        printf("Gracz %u: %lu \n", i, game_busy_fields(g, i));
+        uint32_t player = game_leaderboard(g, i);
+        length += (size_t)snprintf(results + length, sizeof(results) - length,
+                                   "%u. Gracz %u: %lu \n", i, player,
+                                   game_busy_fields(g, player));
     }
+    screen_set_cursor(s, false, 0, 0);
+    screen_set_player(s, NO_PLAYER);
+    flush_frame(s, g, results);
 }
 
 /**
- * Sprawdza, czy znak jest strzałką.
+ * Rozpoznaje sekwencję strzałki na początku bufora @p input o długości
+ * @p length. Zwraca liczbę bajtów do pominięcia lub 0, gdy sekwencja nie
+ * jest jeszcze cała wczytana. Pod @p ch zapisuje kierunek strzałki
+ * albo 0, gdy sekwencja nie jest strzałką.
  */
-static bool arrow_input(char* ch) {
-    *ch = (char) getchar();
-    if (*ch != '[') {
-        return false;
+static size_t arrow_input(const char *input, size_t length, char *ch) {
+    *ch = 0;
+    if (length < 2) {
+        return 0;
     }
-    *ch = (char) getchar();
-    if (*ch == 'A' || *ch == 'B' || *ch == 'C' || *ch == 'D') {
-        return true;
-    } else {
-        return false;
+    if (input[1] != '[') {
+        return 1;
     }
-
+    if (length < 3) {
+        return 0;
+    }
+    if (input[2] == 'A' || input[2] == 'B' || input[2] == 'C'
+        || input[2] == 'D') {
+        *ch = input[2];
+        return 3;
+    }
+    return 2;
 }
 
 /**
@@ -186,14 +256,23 @@ static bool handle_move(char ch, uint32_t player, uint32_t x,
 
 /* FUNKCJE TERMINALA */
 
-static bool correct_terminal(game_t* g) {
+/**
+ * Wyznacza rozmiar widoku planszy: całą szerokość terminala i jego
+ * wysokość bez wierszy na statystyki i wynik gry. Plansza większa od
+ * widoku jest przewijana za kursorem. Zwraca false, gdy w terminalu nie
+ * mieści się żaden wiersz planszy.
+ */
+static bool correct_terminal(game_t* g, bool overlay, uint32_t* columns,
+                             uint32_t* rows) {
     struct winsize terminal;
-    ioctl(0, TIOCGWINSZ, &terminal);
-    if (terminal.ws_col < game_board_width(g) 
-        || terminal.ws_row < game_board_height(g) + game_players(g) + 2
-        || terminal.ws_row < game_board_height(g) + STATS_ROWS + 2) {
+    uint32_t stats = STATS_ROWS + (overlay ? 1 : 0);
+    uint32_t reserved = (game_players(g) > stats ? game_players(g) : stats) + 2;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminal) != 0
+        || terminal.ws_col == 0 || terminal.ws_row <= reserved) {
         return false;
     }
+    *columns = terminal.ws_col;
+    *rows = terminal.ws_row - reserved;
     return true;
 }
 
@@ -223,50 +302,88 @@ static void reset_terminal(struct termios* terminal, game_t* g) {
 /**
  * Zwraca następnego gracza, który może wykonać ruch. Jeśli nie ma takiego gracza zwraca -1.
  */
-static int next_player(int64_t current_player, game_t* game, uint32_t number_of_players) {
-    uint32_t tmp_player = current_player;
-    for (uint32_t i = 0; i < number_of_players + 1; i++) {
-        tmp_player = ((tmp_player + i) % number_of_players) + 1;
-        if (game_free_fields(game, tmp_player)) {
-            return tmp_player;
+static int next_player(int64_t current_player, game_t* game) {
+    uint32_t player = game_next_active_player(game, (uint32_t) current_player);
+    return player == NO_PLAYER ? -1 : (int) player;
+}
+
+/**
+ * Wykonuje ruchy komputerowych graczy, dopóki nie nastąpi kolej gracza
+ * sterowanego z klawiatury. Zwraca false jeśli gra powinna się zakończyć.
+ */
+static bool play_bots(game_t *g, screen_t *s, uint32_t cursor_x,
+                      uint32_t cursor_y, int64_t* player, uint64_t bots,
+                      mcts_params_t* bot, latency_t* latency) {
+    while ((bots >> *player) & 1) {
+        show_frame(s, g, cursor_x, cursor_y, (uint32_t) *player, false,
+                   latency);
+        mcts_result_t result;
+        if (mcts_search(g, (uint32_t) *player, bot, &result)
+            && game_move(g, (uint32_t) *player, result.x, result.y)) {
+            screen_field_changed(s, result.x, result.y);
+        }
+        bot->seed++;
+        *player = next_player(*player, g);
+        if (*player == -1) {
+            return false;
         }
     }
-    return -1;
+    return true;
 }
 
 /**
- * Zwraca false jeśli gra powinna się zakończyć.
+ * Obsługuje wszystkie klawisze z bufora @p input o długości @p *length.
+ * Ruchy kursora zmieniają tylko jego położenie, a klatka jest rysowana
+ * później, raz dla wszystkich wczytanych klawiszy. Niedokończona sekwencja
+ * strzałki zostaje w buforze do kolejnego odczytu. Zwraca false, jeśli gra
+ * powinna się zakończyć.
  */
-static bool interactive_loop_step(game_t *g, char ch, uint32_t* cursor_x,
-                                  uint32_t* cursor_y, int64_t* player,
-                                  bool* skip_read) {
-    print_board(g, *cursor_x, *cursor_y, *player);
-    print_stats(g, *player, false);
-    bool move_failed = false;
-
-    if (ch == ' ' || ch == 'c' || ch == 'C') {
-        if (handle_move(ch, *player, *cursor_x, game_board_height(g) - *cursor_y - 1, g)) {
-            *player = next_player(*player, g, game_players(g));
-            if (*player == -1) {
-                return false;
+static bool handle_input(game_t *g, screen_t *s, char *input, size_t *length,
+                         uint32_t* cursor_x, uint32_t* cursor_y,
+                         int64_t* player, bool* move_failed, uint64_t bots,
+                         mcts_params_t* bot, latency_t* latency) {
+    size_t i = 0;
+    while (i < *length) {
+        char ch = input[i];
+        size_t used = 1;
+        if (ch == 27) {
+            used = arrow_input(input + i, *length - i, &ch);
+            if (used == 0) {
+                break;
             }
-        } else {
-            move_failed = true;
         }
-    } else if (ch == 27) {
-        if (arrow_input(&ch)) {
+        i += used;
+        latency->keys++;
+        *move_failed = false;
+        if (ch == 4) {
+            return false;
+        }
+        if (used == 3) {
             handle_cursor_movement(ch, cursor_x, cursor_y, g);
-        } else {
-            *skip_read = true;
+        } else if (ch == ' ' || ch == 'c' || ch == 'C') {
+            uint32_t y = game_board_height(g) - *cursor_y - 1;
+            if (handle_move(ch, *player, *cursor_x, y, g)) {
+                screen_field_changed(s, *cursor_x, y);
+                *player = next_player(*player, g);
+                if (*player == -1
+                    || !play_bots(g, s, *cursor_x, *cursor_y, player, bots,
+                                  bot, latency)) {
+                    return false;
+                }
+            } else {
+                *move_failed = true;
+            }
         }
     }
-    print_board(g, *cursor_x, *cursor_y, *player);
-    print_stats(g, *player, move_failed);
+    memmove(input, input + i, *length - i);
+    *length -= i;
     return true;
 }
 
-void run_interactive(game_t *g) {
-    if (!correct_terminal(g)) {
+void run_interactive(game_t *g, uint64_t bots, const mcts_params_t *bot,
+                     bool overlay) {
+    uint32_t columns, rows;
+    if (!correct_terminal(g, overlay, &columns, &rows)) {
         game_delete(g);
         fprintf(stderr, "Za mały terminal.\n");
         exit(1);
@@ -274,24 +391,65 @@ void run_interactive(game_t *g) {
 
     struct termios terminal;
     setup_terminal(&terminal, g);
+    fflush(stdout);
+    screen_t *s = screen_new(STDOUT_FILENO, g, columns, rows);
+    if (s == NULL) {
+        reset_terminal(&terminal, g);
+        game_delete(g);
+        fprintf(stderr, "Nie udało się zaalokować pamięci.\n");
+        exit(1);
+    }
 
     uint32_t cursor_x = 0;
     uint32_t cursor_y = 0;
     int64_t player = 1;
+    mcts_params_t params = *bot;
+    latency_t latency = {.overlay = overlay};
 
-    bool skip_read = false;
-    clear();
-    print_board(g, cursor_x, cursor_y, player);
-    print_stats(g, player, false);
-
-    char ch = 1;
-    while ((skip_read && ch != 4) || ((ch = (char) getchar()) && ch != 4)) {
-        skip_read = false;
-        if (!interactive_loop_step(g, ch, &cursor_x, &cursor_y, &player, &skip_read)) {
+    bool running = play_bots(g, s, cursor_x, cursor_y, &player, bots, &params,
+                             &latency);
+    bool pending = running;
+    bool move_failed = false;
+    char input[INPUT_LENGTH];
+    size_t length = 0;
+    struct pollfd in = {.fd = STDIN_FILENO, .events = POLLIN};
+    while (running) {
+        if (pending && frame_wait(&latency) == 0) {
+            show_frame(s, g, cursor_x, cursor_y, (uint32_t) player,
+                       move_failed, &latency);
+            pending = false;
+        }
+        int timeout = pending ? frame_wait(&latency)
+                      : length > 0 ? ESCAPE_TIMEOUT_MS : -1;
+        int ready = poll(&in, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
             break;
         }
+        if (ready == 0 && !pending) {
+            length = 0;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        ssize_t result = read(STDIN_FILENO, input + length,
+                              INPUT_LENGTH - length);
+        if (result == 0 || (result < 0 && errno != EINTR)) {
+            break;
+        }
+        if (result < 0) {
+            continue;
+        }
+        if (latency.input == 0) {
+            latency.input = now_ns();
+        }
+        length += (size_t)result;
+        running = handle_input(g, s, input, &length, &cursor_x, &cursor_y,
+                               &player, &move_failed, bots, &params,
+                               &latency);
+        pending = true;
     }
-    print_game_results(g);
+    print_game_results(s, g);
+    screen_delete(s);
     reset_terminal(&terminal, g);
     game_delete(g);
-}
\ No newline at end of file
+}
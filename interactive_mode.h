@@ -8,11 +8,20 @@
 #ifndef INTERACTIVE_MODE_H
 #define INTERACTIVE_MODE_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "game.h"
+#include "mcts.h"
 
 /**
- * Uruchamia interaktywny tryb tekstowy gry.
+ * Uruchamia interaktywny tryb tekstowy gry. Gracze, których bity są
+ * ustawione w masce @p bots, są komputerowymi graczami o parametrach
+ * @p bot. Wszystkie oczekujące klawisze są obsługiwane przed narysowaniem
+ * klatki, a klatki są rysowane najwyżej 60 razy na sekundę. Gdy @p overlay
+ * ma wartość true, pod planszą są wypisywane opóźnienie między klawiszem
+ * a klatką i liczba klawiszy w klatce.
  */
-void run_interactive(game_t *g);
+void run_interactive(game_t *g, uint64_t bots, const mcts_params_t *bot,
+                     bool overlay);
 
 #endif //INTERACTIVE_MODE_H
\ No newline at end of file
@@ -0,0 +1,429 @@
+/** @file
+ * Implementacja modułu komputerowego gracza
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "constants.h"
+#include "mcts.h"
+#include "rng.h"
+#include "safe_memory_allocation.h"
+
+/**
+ * Współczynnik eksploracji we wzorze UCT.
+ */
+#define MCTS_EXPLORATION 1.4
+
+/**
+ * Maksymalna liczba węzłów drzewa jednego wątku. Po jej osiągnięciu
+ * symulacje startują z liści drzewa bez jego rozwijania.
+ */
+#define MCTS_MAX_NODES (1u << 22)
+
+/**
+ * Początkowa pojemność tablicy węzłów.
+ */
+#define MCTS_INITIAL_NODES 1024
+
+/**
+ * Maksymalna liczba wątków.
+ */
+#define MCTS_MAX_THREADS 256
+
+/**
+ * Numer oznaczający brak węzła.
+ */
+#define NO_NODE UINT32_MAX
+
+/**
+ * To jest struktura przechowująca węzeł drzewa. Dozwolone ruchy węzła są
+ * rozwijane w kolejności pseudolosowej permutacji ich numerów
+ * i -> (offset + i * step) mod moves, gdzie step jest względnie pierwsze
+ * z moves, więc węzeł nie musi pamiętać listy nierozwiniętych ruchów.
+ * Wymaga to, żeby @ref game_legal_move numerowało ruchy w stanie węzła
+ * zawsze tak samo; gra wątku zapewnia to, bo wycofanie ruchu przywraca
+ * numerację sprzed niego.
+ */
+typedef struct node {
+    uint32_t x;
+    uint32_t y;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t mover;     /* Gracz, który wykonał ruch prowadzący do węzła. */
+    uint32_t to_move;   /* Gracz wykonujący ruch w węźle lub NO_PLAYER. */
+    uint64_t moves;     /* Liczba dozwolonych ruchów w węźle. */
+    uint64_t expanded;  /* Liczba rozwiniętych ruchów. */
+    uint64_t step;
+    uint64_t offset;
+    uint64_t visits;
+    double reward;      /* Suma nagród gracza @p mover. */
+} node_t;
+
+/**
+ * To jest struktura przechowująca stan wątku przeszukiwania.
+ */
+typedef struct worker {
+    pthread_t thread;
+    bool started;
+    game_t *game;           /* Kopia gry z włączoną historią ruchów. */
+    uint64_t depth;
+    uint64_t playouts;      /* Limit symulacji wątku, zero oznacza brak. */
+    double deadline;        /* Koniec przeszukiwania, zero oznacza brak. */
+    uint64_t done;
+    rng_t rng;
+    node_t *nodes;
+    uint32_t count;
+    uint32_t capacity;
+    double reward[MAX_NUMBER_OF_PLAYERS + 1];
+} worker_t;
+
+/**
+ * To jest struktura przechowująca liczbę odwiedzin ruchu z korzenia.
+ */
+typedef struct root_move {
+    uint64_t key;
+    uint64_t visits;
+} root_move_t;
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca czas monotoniczny w sekundach.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * Zwraca największy wspólny dzielnik liczb.
+ */
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * Tworzy węzeł drzewa. Liczba dozwolonych ruchów jest odczytywana z gry
+ * wątku, która musi być w stanie odpowiadającym węzłowi. Zwraca NO_NODE,
+ * gdy nie udało się alokować pamięci.
+ */
+static uint32_t node_new(worker_t *w, uint32_t parent, uint32_t x, uint32_t y,
+                         uint32_t mover, uint32_t to_move) {
+    if (w->count == w->capacity) {
+        uint32_t capacity = w->capacity > 0 ? 2 * w->capacity
+                                            : MCTS_INITIAL_NODES;
+        node_t *nodes = safe_realloc(w->nodes, capacity * sizeof(node_t));
+        if (nodes == NULL) {
+            return NO_NODE;
+        }
+        w->nodes = nodes;
+        w->capacity = capacity;
+    }
+    uint32_t n = w->count++;
+    node_t *node = &w->nodes[n];
+    *node = (node_t) {.x = x, .y = y, .parent = parent,
+                      .first_child = NO_NODE, .next_sibling = NO_NODE,
+                      .mover = mover, .to_move = to_move, .step = 1};
+    if (to_move != NO_PLAYER) {
+        node->moves = game_free_fields(w->game, to_move);
+    }
+    if (node->moves > 1) {
+        node->offset = rng_below(&w->rng, node->moves);
+        node->step = 1 + rng_below(&w->rng, node->moves - 1);
+        while (gcd(node->step, node->moves) != 1) {
+            node->step = node->step % (node->moves - 1) + 1;
+        }
+    }
+    if (parent != NO_NODE) {
+        node->next_sibling = w->nodes[parent].first_child;
+        w->nodes[parent].first_child = n;
+    }
+    return n;
+}
+
+/**
+ * Wybiera dziecko węzła według wzoru UCT.
+ */
+static uint32_t select_child(const worker_t *w, uint32_t n) {
+    const node_t *node = &w->nodes[n];
+    double log_visits = log((double)node->visits);
+    uint32_t best = NO_NODE;
+    double best_value = -1;
+    for (uint32_t c = node->first_child; c != NO_NODE;
+         c = w->nodes[c].next_sibling) {
+        const node_t *child = &w->nodes[c];
+        double visits = (double)child->visits;
+        double value = child->reward / visits
+                       + MCTS_EXPLORATION * sqrt(log_visits / visits);
+        if (value > best_value) {
+            best_value = value;
+            best = c;
+        }
+    }
+    assert(best != NO_NODE);
+    return best;
+}
+
+/**
+ * Wylicza nagrody graczy w bieżącym stanie gry wątku: wygrywa gracz
+ * o największej liczbie zajętych pól, remis dzieli nagrodę.
+ */
+static void evaluate(worker_t *w) {
+    uint32_t players = game_players(w->game);
+    uint64_t best = 0;
+    uint32_t winners = 0;
+    for (uint32_t p = 1; p <= players; p++) {
+        uint64_t busy = game_busy_fields(w->game, p);
+        if (busy > best) {
+            best = busy;
+            winners = 0;
+        }
+        if (busy == best) {
+            winners++;
+        }
+    }
+    for (uint32_t p = 1; p <= players; p++) {
+        w->reward[p] = game_busy_fields(w->game, p) == best
+                       ? 1.0 / winners : 0.0;
+    }
+}
+
+/**
+ * Wykonuje ruch wybrany z dozwolonych ruchów gracza o numerze @p index.
+ */
+static bool play(worker_t *w, uint32_t player, uint64_t index,
+                 uint32_t *x, uint32_t *y) {
+    return game_legal_move(w->game, player, index, x, y)
+           && game_move(w->game, player, *x, *y);
+}
+
+/**
+ * Wykonuje jedną iterację przeszukiwania: wybór liścia, rozwinięcie,
+ * symulację i propagację wyniku, po czym wycofuje wszystkie ruchy.
+ * Zwraca false, gdy nie udało się alokować pamięci.
+ */
+static bool worker_iteration(worker_t *w) {
+    game_t *g = w->game;
+    uint64_t depth = 0;
+    bool ok = true;
+    uint32_t n = 0;
+    while (w->nodes[n].to_move != NO_PLAYER
+           && w->nodes[n].expanded == w->nodes[n].moves) {
+        n = select_child(w, n);
+        ok = game_move(g, w->nodes[n].mover, w->nodes[n].x, w->nodes[n].y);
+        assert(ok);
+        depth++;
+    }
+
+    uint32_t player = w->nodes[n].to_move;
+    if (player != NO_PLAYER && w->count < MCTS_MAX_NODES) {
+        node_t *node = &w->nodes[n];
+        uint64_t index = (uint64_t)((node->offset + (unsigned __int128)
+                                     node->expanded * node->step)
+                                    % node->moves);
+        uint32_t x, y;
+        ok = play(w, player, index, &x, &y);
+        if (ok) {
+            depth++;
+            node->expanded++;
+            n = node_new(w, n, x, y, player,
+                         game_next_active_player(g, player));
+            ok = n != NO_NODE;
+            player = ok ? w->nodes[n].to_move : NO_PLAYER;
+        }
+    }
+
+    while (ok && player != NO_PLAYER && (w->depth == 0 || depth < w->depth)) {
+        uint32_t x, y;
+        uint64_t index = rng_below(&w->rng, game_free_fields(g, player));
+        ok = play(w, player, index, &x, &y);
+        if (ok) {
+            depth++;
+            player = game_next_active_player(g, player);
+        }
+    }
+
+    if (ok) {
+        evaluate(w);
+        for (uint32_t m = n; m != NO_NODE; m = w->nodes[m].parent) {
+            w->nodes[m].visits++;
+            if (w->nodes[m].mover != NO_PLAYER) {
+                w->nodes[m].reward += w->reward[w->nodes[m].mover];
+            }
+        }
+    }
+    for (; depth > 0; depth--) {
+        game_undo(g);
+    }
+    return ok;
+}
+
+/**
+ * Wykonuje przeszukiwanie w wątku.
+ */
+static void* worker_run(void *arg) {
+    worker_t *w = arg;
+    while (w->playouts == 0 || w->done < w->playouts) {
+        if (w->deadline > 0 && now() >= w->deadline) {
+            break;
+        }
+        if (!worker_iteration(w)) {
+            break;
+        }
+        w->done++;
+    }
+    return NULL;
+}
+
+/**
+ * Przygotowuje wątek do przeszukiwania.
+ */
+static bool worker_init(worker_t *w, game_t const *g, uint32_t player,
+                        uint64_t seed) {
+    rng_seed(&w->rng, seed);
+    w->game = game_fork(g);
+    return w->game != NULL && game_set_history(w->game, UINT64_MAX)
+           && node_new(w, NO_NODE, 0, 0, NO_PLAYER, player) != NO_NODE;
+}
+
+/**
+ * Porównuje ruchy z korzenia według klucza.
+ */
+static int root_move_compare(const void *a, const void *b) {
+    uint64_t ka = ((const root_move_t*)a)->key;
+    uint64_t kb = ((const root_move_t*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * Sumuje liczby odwiedzin ruchów z korzeni drzew wszystkich wątków
+ * i zapisuje najczęściej odwiedzany ruch. Zwraca false, gdy nie udało się
+ * alokować pamięci lub żaden ruch nie został odwiedzony.
+ */
+static bool choose_move(worker_t *workers, uint32_t threads,
+                        mcts_result_t *result) {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        if (workers[i].count > 0) {
+            count += workers[i].nodes[0].expanded;
+        }
+    }
+    root_move_t *moves = safe_malloc((count + 1) * sizeof(root_move_t));
+    if (moves == NULL) {
+        return false;
+    }
+    count = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        const worker_t *w = &workers[i];
+        for (uint32_t c = w->count > 0 ? w->nodes[0].first_child : NO_NODE;
+             c != NO_NODE; c = w->nodes[c].next_sibling) {
+            moves[count].key = (uint64_t)w->nodes[c].x << 32 | w->nodes[c].y;
+            moves[count++].visits = w->nodes[c].visits;
+        }
+    }
+    qsort(moves, count, sizeof(root_move_t), root_move_compare);
+
+    uint64_t best = 0;
+    result->root_moves = 0;
+    for (uint64_t i = 0, j = 0; i < count; i = j) {
+        result->root_moves++;
+        uint64_t visits = 0;
+        for (j = i; j < count && moves[j].key == moves[i].key; j++) {
+            visits += moves[j].visits;
+        }
+        if (visits > best) {
+            best = visits;
+            result->x = (uint32_t)(moves[i].key >> 32);
+            result->y = (uint32_t)moves[i].key;
+        }
+    }
+    free(moves);
+    return best > 0;
+}
+
+/* FUNKCJE MODUŁU */
+
+mcts_params_t mcts_default_params(void) {
+    return (mcts_params_t) {.threads = 0, .playouts = MCTS_DEFAULT_PLAYOUTS,
+                            .time_ms = 0, .depth = 0, .seed = 1};
+}
+
+bool mcts_search(game_t const *g, uint32_t player, const mcts_params_t *params,
+                 mcts_result_t *result) {
+    if (params == NULL || result == NULL || game_free_fields(g, player) == 0) {
+        return false;
+    }
+    uint64_t playouts = params->playouts;
+    if (playouts == 0 && params->time_ms == 0) {
+        playouts = MCTS_DEFAULT_PLAYOUTS;
+    }
+    uint64_t threads = params->threads;
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (uint64_t)online : 1;
+    }
+    if (threads > MCTS_MAX_THREADS) {
+        threads = MCTS_MAX_THREADS;
+    }
+    if (playouts > 0 && threads > playouts) {
+        threads = playouts;
+    }
+    worker_t *workers = safe_calloc(threads, sizeof(worker_t));
+    if (workers == NULL) {
+        return false;
+    }
+
+    double start = now();
+    uint64_t seed = params->seed;
+    bool ok = true;
+    for (uint32_t i = 0; i < threads && ok; i++) {
+        worker_t *w = &workers[i];
+        w->depth = params->depth;
+        w->playouts = playouts / threads + (i < playouts % threads);
+        w->deadline = params->time_ms > 0
+                      ? start + (double)params->time_ms / 1000 : 0;
+        ok = worker_init(w, g, player, rng_splitmix(&seed));
+    }
+    for (uint32_t i = 1; i < threads && ok; i++) {
+        workers[i].started = pthread_create(&workers[i].thread, NULL,
+                                            worker_run, &workers[i]) == 0;
+    }
+    if (ok) {
+        worker_run(&workers[0]);
+    }
+    result->playouts = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        else if (ok && i > 0) {
+            worker_run(&workers[i]);
+        }
+        result->playouts += workers[i].done;
+    }
+    result->seconds = now() - start;
+    ok = ok && choose_move(workers, (uint32_t)threads, result);
+
+    for (uint32_t i = 0; i < threads; i++) {
+        game_delete(workers[i].game);
+        free(workers[i].nodes);
+    }
+    free(workers);
+    return ok;
+}
@@ -0,0 +1,64 @@
+/** @file
+ * Interfejs modułu komputerowego gracza
+ *
+ * Gracz wybiera ruch przeszukiwaniem drzewa gry metodą Monte Carlo (UCT).
+ * Przeszukiwanie jest zrównoleglone na poziomie korzenia: każdy wątek
+ * buduje własne drzewo na własnej kopii gry, a na końcu liczby odwiedzin
+ * ruchów z korzenia są sumowane. Wątki nie współdzielą żadnych danych
+ * w trakcie przeszukiwania.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+
+/**
+ * Domyślna liczba symulacji na ruch.
+ */
+#define MCTS_DEFAULT_PLAYOUTS 20000
+
+/**
+ * To jest struktura przechowująca parametry przeszukiwania.
+ */
+typedef struct mcts_params {
+    uint32_t threads;   /* Liczba wątków, zero oznacza liczbę procesorów. */
+    uint64_t playouts;  /* Łączna liczba symulacji, zero oznacza brak limitu. */
+    uint64_t time_ms;   /* Limit czasu w milisekundach, zero oznacza brak limitu. */
+    uint64_t depth;     /* Maksymalna liczba ruchów od korzenia do końca
+                           symulacji, zero oznacza grę do końca. */
+    uint64_t seed;      /* Ziarno generatora liczb pseudolosowych. */
+} mcts_params_t;
+
+/**
+ * To jest struktura przechowująca wynik przeszukiwania.
+ */
+typedef struct mcts_result {
+    uint32_t x;
+    uint32_t y;
+    uint64_t playouts;  /* Liczba wykonanych symulacji. */
+    uint64_t root_moves; /* Liczba różnych ruchów z korzenia rozwiniętych
+                            przez wątki. */
+    double seconds;     /* Czas przeszukiwania. */
+} mcts_result_t;
+
+/**
+ * Zwraca domyślne parametry przeszukiwania.
+ */
+mcts_params_t mcts_default_params(void);
+
+
+/**
+ * Wybiera ruch gracza @p player w grze @p g i zapisuje go w @p result.
+ * Nie zmienia stanu gry. Zwraca false, gdy gracz nie może wykonać ruchu,
+ * któryś z parametrów jest niepoprawny lub nie udało się alokować pamięci.
+ */
+bool mcts_search(game_t const *g, uint32_t player, const mcts_params_t *params,
+                 mcts_result_t *result);
+
+#endif /* MCTS_H */
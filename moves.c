@@ -0,0 +1,601 @@
+/** @file
+ * Implementacja modułu indeksu dozwolonych ruchów
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "moves.h"
+#include "safe_memory_allocation.h"
+#include "constants.h"
+
+/**
+ * Pusta komórka tablicy mieszającej.
+ */
+#define EMPTY_SLOT UINT64_MAX
+
+/**
+ * Początkowy logarytm pojemności tablicy mieszającej.
+ */
+#define INITIAL_SLOTS_LOG 4
+
+/**
+ * To jest struktura przechowująca komórkę tablicy mieszającej: klucz pola
+ * i jego pozycję w tablicy pól zbioru.
+ */
+typedef struct slot {
+    uint64_t key;
+    uint64_t position;
+} slot_t;
+
+/**
+ * To jest struktura przechowująca zbiór pól sąsiadujących z obszarami gracza.
+ * Pola leżą w ciągłej tablicy @p cells, a tablica mieszająca z adresowaniem
+ * otwartym pamięta pozycję każdego z nich, więc dodawanie, usuwanie
+ * i wybór pola o zadanym numerze działają w stałym oczekiwanym czasie.
+ */
+typedef struct frontier {
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t* cells;
+    uint32_t slots_log;
+    slot_t* slots;
+} frontier_t;
+
+/**
+ * Logarytm boku kwadratowego kafelka indeksu wolnych pól.
+ */
+#define MOVES_TILE_SIDE_BITS 6
+
+/**
+ * Bok kafelka indeksu wolnych pól: liczba kolumn kafelka i liczba bitów
+ * słowa opisującego jedną kolumnę.
+ */
+#define MOVES_TILE_SIDE ((uint32_t)1 << MOVES_TILE_SIDE_BITS)
+
+/**
+ * To jest struktura przechowująca indeks dozwolonych ruchów. Plansza jest
+ * podzielona na kafelki @ref MOVES_TILE_SIDE na @ref MOVES_TILE_SIDE pól,
+ * numerowane kolumnami. Wolne pola kafelka, w którym jest zajęte pole, są
+ * zaznaczone w jego mapie bitowej (po słowie na kolumnę); brak mapy oznacza
+ * kafelek bez zajętych pól. Nad kafelkami zbudowane jest drzewo potęgowe
+ * liczby ich wolnych pól, więc pamięć rośnie z liczbą kafelków i obszarem,
+ * na którym toczy się gra, a nie z liczbą pól planszy.
+ */
+struct moves {
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint64_t tile_rows;
+    uint64_t tiles;
+    uint64_t bitmaps;
+    uint64_t** free_bits;
+    uint64_t* free_tree;
+    frontier_t frontier[];
+};
+
+/* ZBIÓR PÓL */
+
+/**
+ * Zwraca pozycję klucza w tablicy mieszającej, od której zaczyna się
+ * jego szukanie.
+ */
+static uint64_t slot_home(const frontier_t *f, uint64_t key) {
+    return (key * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - f->slots_log);
+}
+
+/**
+ * Zwraca maskę pozycji w tablicy mieszającej.
+ */
+static uint64_t slots_mask(const frontier_t *f) {
+    return ((uint64_t)1 << f->slots_log) - 1;
+}
+
+/**
+ * Zwraca pozycję klucza w tablicy mieszającej lub pozycję pustej komórki,
+ * w której powinien się znaleźć.
+ */
+static uint64_t frontier_find(const frontier_t *f, uint64_t key) {
+    uint64_t i = slot_home(f, key);
+    while (f->slots[i].key != EMPTY_SLOT && f->slots[i].key != key) {
+        i = (i + 1) & slots_mask(f);
+    }
+    return i;
+}
+
+/**
+ * Tworzy tablicę mieszającą o zadanym logarytmie pojemności i wstawia do
+ * niej wszystkie pola zbioru.
+ */
+static bool frontier_rehash(frontier_t *f, uint32_t slots_log) {
+    slot_t* slots = safe_malloc(((size_t)1 << slots_log) * sizeof(slot_t));
+    if (slots == NULL) {
+        return false;
+    }
+    free(f->slots);
+    f->slots = slots;
+    f->slots_log = slots_log;
+    for (uint64_t i = 0; i <= slots_mask(f); i++) {
+        f->slots[i].key = EMPTY_SLOT;
+    }
+    for (uint64_t i = 0; i < f->count; i++) {
+        slot_t* slot = &f->slots[frontier_find(f, f->cells[i])];
+        slot->key = f->cells[i];
+        slot->position = i;
+    }
+    return true;
+}
+
+/**
+ * Zapewnia miejsce na @p extra nowych pól zbioru.
+ */
+static bool frontier_reserve(frontier_t *f, uint64_t extra) {
+    uint64_t needed = f->count + extra;
+    if (needed > f->capacity) {
+        uint64_t capacity = f->capacity > 0 ? 2 * f->capacity : 16;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint64_t* cells = safe_realloc(f->cells, capacity * sizeof(uint64_t));
+        if (cells == NULL) {
+            return false;
+        }
+        f->cells = cells;
+        f->capacity = capacity;
+    }
+    uint32_t slots_log = f->slots == NULL ? INITIAL_SLOTS_LOG : f->slots_log;
+    while (2 * needed > ((uint64_t)1 << slots_log)) {
+        slots_log++;
+    }
+    if (f->slots == NULL || slots_log != f->slots_log) {
+        return frontier_rehash(f, slots_log);
+    }
+    return true;
+}
+
+/**
+ * Dodaje pole do zbioru, jeśli go w nim nie ma.
+ */
+static void frontier_add(frontier_t *f, uint64_t key) {
+    assert(f->count < f->capacity);
+    slot_t* slot = &f->slots[frontier_find(f, key)];
+    if (slot->key == key) {
+        return;
+    }
+    slot->key = key;
+    slot->position = f->count;
+    f->cells[f->count++] = key;
+}
+
+/**
+ * Wstawia do zbioru pole, którego w nim nie ma, na pozycję @p position
+ * tablicy pól; pole z tej pozycji trafia na koniec tablicy. Odwraca
+ * @ref frontier_remove, które usunęło pole z tej pozycji.
+ */
+static void frontier_insert(frontier_t *f, uint64_t key, uint64_t position) {
+    assert(f->count < f->capacity && position <= f->count);
+    slot_t* slot = &f->slots[frontier_find(f, key)];
+    assert(slot->key != key);
+    slot->key = key;
+    slot->position = position;
+    if (position != f->count) {
+        uint64_t moved = f->cells[position];
+        f->slots[frontier_find(f, moved)].position = f->count;
+        f->cells[f->count] = moved;
+    }
+    f->cells[position] = key;
+    f->count++;
+}
+
+/**
+ * Usuwa pole ze zbioru. Na jego miejsce w tablicy pól trafia ostatnie pole,
+ * a zwolnioną komórkę tablicy mieszającej wypełniają przesunięte do tyłu
+ * komórki z dalszej części ciągu. Zwraca pozycję, którą pole zajmowało.
+ */
+static uint64_t frontier_remove(frontier_t *f, uint64_t key) {
+    uint64_t i = frontier_find(f, key);
+    assert(f->slots[i].key == key);
+
+    uint64_t position = f->slots[i].position;
+    uint64_t last = f->cells[--f->count];
+    if (position != f->count) {
+        f->cells[position] = last;
+        f->slots[frontier_find(f, last)].position = position;
+    }
+
+    uint64_t mask = slots_mask(f);
+    for (uint64_t j = (i + 1) & mask; f->slots[j].key != EMPTY_SLOT;
+         j = (j + 1) & mask) {
+        uint64_t home = slot_home(f, f->slots[j].key);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            f->slots[i] = f->slots[j];
+            i = j;
+        }
+    }
+    f->slots[i].key = EMPTY_SLOT;
+    return position;
+}
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca klucz pola (x, y).
+ */
+static uint64_t moves_key(moves_t m, uint32_t x, uint32_t y) {
+    return (uint64_t)x * m->height + y;
+}
+
+/**
+ * Zapisuje współrzędne pola o zadanym kluczu.
+ */
+static void moves_coordinates(moves_t m, uint64_t key, uint32_t *x,
+                              uint32_t *y) {
+    *x = (uint32_t)(key / m->height);
+    *y = (uint32_t)(key % m->height);
+}
+
+/**
+ * Zwraca numer kafelka zawierającego pole (x, y).
+ */
+static uint64_t tile_number(moves_t m, uint32_t x, uint32_t y) {
+    return (uint64_t)(x >> MOVES_TILE_SIDE_BITS) * m->tile_rows
+           + (y >> MOVES_TILE_SIDE_BITS);
+}
+
+/**
+ * Zapisuje współrzędne lewego dolnego pola kafelka oraz liczbę jego kolumn
+ * i wierszy; kafelki na brzegu planszy mogą być mniejsze.
+ */
+static void tile_extent(moves_t m, uint64_t tile, uint32_t *x, uint32_t *y,
+                        uint32_t *columns, uint32_t *rows) {
+    *x = (uint32_t)(tile / m->tile_rows) << MOVES_TILE_SIDE_BITS;
+    *y = (uint32_t)(tile % m->tile_rows) << MOVES_TILE_SIDE_BITS;
+    *columns = m->width - *x < MOVES_TILE_SIDE ? m->width - *x
+                                               : MOVES_TILE_SIDE;
+    *rows = m->height - *y < MOVES_TILE_SIDE ? m->height - *y
+                                             : MOVES_TILE_SIDE;
+}
+
+/**
+ * Zwraca liczbę wolnych pól kafelka.
+ */
+static uint64_t tile_free(moves_t m, uint64_t tile) {
+    const uint64_t* bits = m->free_bits[tile];
+    if (bits == NULL) {
+        uint32_t x, y, columns, rows;
+        tile_extent(m, tile, &x, &y, &columns, &rows);
+        return (uint64_t)columns * rows;
+    }
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < MOVES_TILE_SIDE; i++) {
+        count += (uint64_t)__builtin_popcountll(bits[i]);
+    }
+    return count;
+}
+
+/**
+ * Zaznacza wszystkie pola kafelka w jego mapie bitowej jako wolne.
+ */
+static void tile_fill(moves_t m, uint64_t tile) {
+    uint32_t x, y, columns, rows;
+    tile_extent(m, tile, &x, &y, &columns, &rows);
+    uint64_t column = rows < 64 ? ((uint64_t)1 << rows) - 1 : UINT64_MAX;
+    for (uint32_t i = 0; i < MOVES_TILE_SIDE; i++) {
+        m->free_bits[tile][i] = i < columns ? column : 0;
+    }
+}
+
+/**
+ * Zapewnia, że kafelek zawierający pole (x, y) ma mapę bitową.
+ * Zwraca false, gdy nie udało się alokować pamięci.
+ */
+static bool tile_claim(moves_t m, uint32_t x, uint32_t y) {
+    uint64_t tile = tile_number(m, x, y);
+    if (m->free_bits[tile] != NULL) {
+        return true;
+    }
+    m->free_bits[tile] = safe_malloc(MOVES_TILE_SIDE * sizeof(uint64_t));
+    if (m->free_bits[tile] == NULL) {
+        return false;
+    }
+    m->bitmaps++;
+    tile_fill(m, tile);
+    return true;
+}
+
+/**
+ * Zwraca słowo mapy bitowej z kolumną pola (x, y). Kafelek musi mieć mapę.
+ */
+static uint64_t* tile_column(moves_t m, uint32_t x, uint32_t y) {
+    uint64_t* bits = m->free_bits[tile_number(m, x, y)];
+    assert(bits != NULL);
+    return &bits[x & (MOVES_TILE_SIDE - 1)];
+}
+
+/* ZBIÓR WOLNYCH PÓL */
+
+/**
+ * Dodaje @p delta do liczby wolnych pól kafelka @p tile w drzewie potęgowym.
+ */
+static void free_tree_add(moves_t m, uint64_t tile, int64_t delta) {
+    for (uint64_t i = tile + 1; i <= m->tiles; i += i & (~i + 1)) {
+        m->free_tree[i] += (uint64_t)delta;
+    }
+}
+
+/**
+ * Buduje drzewo potęgowe liczby wolnych pól w kafelkach.
+ */
+static void free_tree_build(moves_t m) {
+    m->free_tree[0] = 0;
+    for (uint64_t i = 1; i <= m->tiles; i++) {
+        m->free_tree[i] = tile_free(m, i - 1);
+    }
+    for (uint64_t i = 1; i <= m->tiles; i++) {
+        uint64_t parent = i + (i & (~i + 1));
+        if (parent <= m->tiles) {
+            m->free_tree[parent] += m->free_tree[i];
+        }
+    }
+}
+
+/**
+ * Wypełnia indeks na podstawie stanu planszy. Przegląda tylko zajęte pola:
+ * zaznacza je w mapach bitowych ich kafelków i dodaje ich wolnych sąsiadów
+ * do zbiorów pól sąsiadujących z obszarami ich graczy.
+ */
+static bool moves_build(moves_t m, board_t b) {
+    uint64_t cursor = 0;
+    uint32_t x, y;
+    while (board_next_busy(b, &cursor, &x, &y)) {
+        if (!tile_claim(m, x, y)) {
+            return false;
+        }
+        *tile_column(m, x, y) &= ~((uint64_t)1 << (y & (MOVES_TILE_SIDE - 1)));
+        frontier_t *f = &m->frontier[board_field_player(b, x, y)];
+        if (!frontier_reserve(f, DIRECTIONS)) {
+            return false;
+        }
+        if (x > 0 && board_field_free(b, x - 1, y)) {
+            frontier_add(f, moves_key(m, x - 1, y));
+        }
+        if (x + 1 < m->width && board_field_free(b, x + 1, y)) {
+            frontier_add(f, moves_key(m, x + 1, y));
+        }
+        if (y > 0 && board_field_free(b, x, y - 1)) {
+            frontier_add(f, moves_key(m, x, y - 1));
+        }
+        if (y + 1 < m->height && board_field_free(b, x, y + 1)) {
+            frontier_add(f, moves_key(m, x, y + 1));
+        }
+    }
+    free_tree_build(m);
+    return true;
+}
+
+/* FUNKCJE MODUŁU */
+
+moves_t moves_new(board_t b, uint32_t width, uint32_t height, uint32_t players) {
+    moves_t m = safe_calloc(1, sizeof(struct moves)
+                               + (players + 1) * sizeof(frontier_t));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->width = width;
+    m->height = height;
+    m->players = players;
+    m->tile_rows = ((uint64_t)height + MOVES_TILE_SIDE - 1)
+                   >> MOVES_TILE_SIDE_BITS;
+    m->tiles = (((uint64_t)width + MOVES_TILE_SIDE - 1) >> MOVES_TILE_SIDE_BITS)
+               * m->tile_rows;
+    m->free_bits = safe_calloc(m->tiles, sizeof(uint64_t*));
+    m->free_tree = safe_malloc((m->tiles + 1) * sizeof(uint64_t));
+    if (m->free_bits == NULL || m->free_tree == NULL || !moves_build(m, b)) {
+        moves_delete(m);
+        return NULL;
+    }
+    return m;
+}
+
+void moves_delete(moves_t m) {
+    if (m != NULL) {
+        for (uint32_t i = 0; i <= m->players; i++) {
+            free(m->frontier[i].cells);
+            free(m->frontier[i].slots);
+        }
+        if (m->free_bits != NULL) {
+            for (uint64_t i = 0; i < m->tiles; i++) {
+                free(m->free_bits[i]);
+            }
+        }
+        free(m->free_bits);
+        free(m->free_tree);
+        free(m);
+    }
+}
+
+void moves_reset(moves_t m) {
+    assert(m != NULL);
+    for (uint64_t i = 0; i < m->tiles; i++) {
+        if (m->free_bits[i] != NULL) {
+            tile_fill(m, i);
+        }
+    }
+    free_tree_build(m);
+    for (uint32_t i = 0; i <= m->players; i++) {
+        frontier_t *f = &m->frontier[i];
+        f->count = 0;
+        if (f->slots != NULL) {
+            memset(f->slots, 0xFF, ((size_t)1 << f->slots_log) * sizeof(slot_t));
+        }
+    }
+}
+
+uint64_t moves_memory(moves_t m) {
+    if (m == NULL) {
+        return 0;
+    }
+    uint64_t memory = sizeof(struct moves) + (m->players + 1) * sizeof(frontier_t)
+                      + m->tiles * sizeof(uint64_t*)
+                      + (m->tiles + 1) * sizeof(uint64_t)
+                      + m->bitmaps * MOVES_TILE_SIDE * sizeof(uint64_t);
+    for (uint32_t i = 0; i <= m->players; i++) {
+        const frontier_t *f = &m->frontier[i];
+        memory += f->capacity * sizeof(uint64_t);
+        if (f->slots != NULL) {
+            memory += ((uint64_t)1 << f->slots_log) * sizeof(slot_t);
+        }
+    }
+    return memory;
+}
+
+bool moves_reserve(moves_t m, uint32_t x, uint32_t y, uint32_t player) {
+    assert(m != NULL && player <= m->players);
+    return tile_claim(m, x, y)
+           && frontier_reserve(&m->frontier[player], DIRECTIONS);
+}
+
+bool moves_reserve_undo(moves_t m, uint64_t neighbour_players) {
+    assert(m != NULL);
+    while (neighbour_players != 0) {
+        uint32_t neighbour = (uint32_t)__builtin_ctzll(neighbour_players);
+        neighbour_players &= neighbour_players - 1;
+        if (!frontier_reserve(&m->frontier[neighbour], 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void moves_move(moves_t m, board_t b, uint32_t x, uint32_t y, uint32_t player,
+                uint64_t neighbour_players, moves_undo_t *undo) {
+    assert(m != NULL && player <= m->players);
+    uint64_t key = moves_key(m, x, y);
+    uint64_t* column = tile_column(m, x, y);
+    uint64_t bit = (uint64_t)1 << (y & (MOVES_TILE_SIDE - 1));
+    assert(*column & bit);
+    *column &= ~bit;
+    free_tree_add(m, tile_number(m, x, y), -1);
+
+    for (uint32_t i = 0; neighbour_players != 0; i++) {
+        assert(i < DIRECTIONS);
+        uint32_t neighbour = (uint32_t)__builtin_ctzll(neighbour_players);
+        neighbour_players &= neighbour_players - 1;
+        uint64_t position = frontier_remove(&m->frontier[neighbour], key);
+        if (undo != NULL) {
+            undo->positions[i] = position;
+        }
+    }
+    if (undo != NULL) {
+        undo->valid = true;
+    }
+
+    frontier_t *f = &m->frontier[player];
+    if (x > 0 && board_field_free(b, x - 1, y)) {
+        frontier_add(f, moves_key(m, x - 1, y));
+    }
+    if (x + 1 < m->width && board_field_free(b, x + 1, y)) {
+        frontier_add(f, moves_key(m, x + 1, y));
+    }
+    if (y > 0 && board_field_free(b, x, y - 1)) {
+        frontier_add(f, moves_key(m, x, y - 1));
+    }
+    if (y + 1 < m->height && board_field_free(b, x, y + 1)) {
+        frontier_add(f, moves_key(m, x, y + 1));
+    }
+}
+
+void moves_undo(moves_t m, board_t b, uint32_t x, uint32_t y, uint32_t player,
+                uint64_t neighbour_players, const moves_undo_t *undo) {
+    assert(m != NULL && player <= m->players);
+    uint64_t key = moves_key(m, x, y);
+    uint64_t* column = tile_column(m, x, y);
+    uint64_t bit = (uint64_t)1 << (y & (MOVES_TILE_SIDE - 1));
+    assert((*column & bit) == 0);
+    *column |= bit;
+    free_tree_add(m, tile_number(m, x, y), 1);
+
+    /* Pola dodane przez ruch są usuwane w odwrotnej kolejności, więc po
+       ruchu wykonanym z indeksem są zdejmowane z końca tablicy pól. */
+    frontier_t *f = &m->frontier[player];
+    if (y + 1 < m->height && board_field_free(b, x, y + 1)
+        && !board_has_neighbour_with_player(b, x, y + 1, player)) {
+        frontier_remove(f, moves_key(m, x, y + 1));
+    }
+    if (y > 0 && board_field_free(b, x, y - 1)
+        && !board_has_neighbour_with_player(b, x, y - 1, player)) {
+        frontier_remove(f, moves_key(m, x, y - 1));
+    }
+    if (x + 1 < m->width && board_field_free(b, x + 1, y)
+        && !board_has_neighbour_with_player(b, x + 1, y, player)) {
+        frontier_remove(f, moves_key(m, x + 1, y));
+    }
+    if (x > 0 && board_field_free(b, x - 1, y)
+        && !board_has_neighbour_with_player(b, x - 1, y, player)) {
+        frontier_remove(f, moves_key(m, x - 1, y));
+    }
+
+    for (uint32_t i = 0; neighbour_players != 0; i++) {
+        uint32_t neighbour = (uint32_t)__builtin_ctzll(neighbour_players);
+        neighbour_players &= neighbour_players - 1;
+        frontier_t *n = &m->frontier[neighbour];
+        if (undo != NULL && undo->valid) {
+            frontier_insert(n, key, undo->positions[i]);
+        }
+        else {
+            frontier_add(n, key);
+        }
+    }
+}
+
+bool moves_free_field(moves_t m, uint64_t n, uint32_t *x, uint32_t *y) {
+    assert(m != NULL);
+    uint64_t tile = 0;
+    uint64_t step = 1;
+    while (2 * step <= m->tiles) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (tile + step <= m->tiles && m->free_tree[tile + step] <= n) {
+            tile += step;
+            n -= m->free_tree[tile];
+        }
+    }
+    if (tile == m->tiles) {
+        return false;
+    }
+    uint32_t left, bottom, columns, rows;
+    tile_extent(m, tile, &left, &bottom, &columns, &rows);
+    const uint64_t* bits = m->free_bits[tile];
+    if (bits == NULL) {
+        *x = left + (uint32_t)(n / rows);
+        *y = bottom + (uint32_t)(n % rows);
+        return true;
+    }
+    uint32_t i = 0;
+    for (uint64_t count; n >= (count = (uint64_t)__builtin_popcountll(bits[i]));
+         i++) {
+        n -= count;
+    }
+    uint64_t column = bits[i];
+    for (; n > 0; n--) {
+        column &= column - 1;
+    }
+    *x = left + i;
+    *y = bottom + (uint32_t)__builtin_ctzll(column);
+    return true;
+}
+
+bool moves_frontier_field(moves_t m, uint32_t player, uint64_t n,
+                          uint32_t *x, uint32_t *y) {
+    assert(m != NULL && player <= m->players);
+    const frontier_t *f = &m->frontier[player];
+    if (n >= f->count) {
+        return false;
+    }
+    moves_coordinates(m, f->cells[n], x, y);
+    return true;
+}
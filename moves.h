@@ -0,0 +1,111 @@
+/** @file
+ * Interfejs modułu indeksu dozwolonych ruchów
+ *
+ * Indeks przechowuje zbiór wolnych pól oraz, dla każdego gracza, zbiór
+ * wolnych pól sąsiadujących z jego obszarami. Zbiory są aktualizowane przy
+ * każdym ruchu i pozwalają w stałym (dla zbioru wolnych pól –
+ * logarytmicznym) czasie wyznaczyć pole o zadanym numerze. Indeks zajmuje
+ * pamięć proporcjonalną do liczby kafelków planszy i obszaru, na którym
+ * toczy się gra, a budowa przegląda tylko zajęte pola.
+ * Pole (x, y) jest identyfikowane kluczem x * height + y.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef MOVES_H
+#define MOVES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "board.h"
+#include "constants.h"
+
+/**
+ * To jest deklaracja struktury przechowującej indeks dozwolonych ruchów.
+ */
+typedef struct moves* moves_t;
+
+/**
+ * To jest struktura opisująca zmianę indeksu w jednym ruchu, pozwalająca
+ * ją wycofać tak, żeby pola w zbiorach wróciły na swoje pozycje. Dzięki
+ * temu numeracja dozwolonych ruchów zależy tylko od ruchów wykonanych od
+ * utworzenia indeksu, a nie od ruchów wykonanych i wycofanych po drodze.
+ */
+typedef struct moves_undo {
+    uint64_t positions[DIRECTIONS]; /* Pozycje zajętego pola w zbiorach
+                                       kolejnych graczy z maski sąsiadów. */
+    bool valid;                     /* Czy pozycje zostały zapisane. */
+} moves_undo_t;
+
+/**
+ * Tworzy indeks dozwolonych ruchów dla aktualnego stanu planszy.
+ * Zwraca NULL, gdy nie udało się alokować pamięci.
+ */
+moves_t moves_new(board_t b, uint32_t width, uint32_t height, uint32_t players);
+
+/**
+ * Usuwa indeks dozwolonych ruchów.
+ */
+void moves_delete(moves_t m);
+
+/**
+ * Przywraca indeks do stanu dla pustej planszy bez zwalniania pamięci.
+ */
+void moves_reset(moves_t m);
+
+/**
+ * Zwraca liczbę bajtów pamięci zajmowanych przez indeks.
+ */
+uint64_t moves_memory(moves_t m);
+
+/**
+ * Zapewnia miejsce na zajęcie pola (x, y) i na pola, które zyska gracz
+ * w tym ruchu. Zwraca false, gdy nie udało się alokować pamięci. Musi
+ * zostać wywołana przed @ref moves_move.
+ */
+bool moves_reserve(moves_t m, uint32_t x, uint32_t y, uint32_t player);
+
+/**
+ * Aktualizuje indeks po zajęciu pola (x, y) przez gracza. Wywoływana po
+ * ruchu na planszy @p b. Maska @p neighbour_players opisuje graczy, którzy
+ * przed ruchem sąsiadowali z polem (x, y). Jeśli @p undo nie ma wartości
+ * NULL, zapisuje w nim opis zmiany dla @ref moves_undo.
+ */
+void moves_move(moves_t m, board_t b, uint32_t x, uint32_t y, uint32_t player,
+                uint64_t neighbour_players, moves_undo_t *undo);
+
+/**
+ * Zapewnia miejsce na powrót pola do zbiorów graczy z maski
+ * @p neighbour_players przy wycofaniu ruchu. Zwraca false, gdy nie udało
+ * się alokować pamięci. Musi zostać wywołana przed @ref moves_undo.
+ */
+bool moves_reserve_undo(moves_t m, uint64_t neighbour_players);
+
+/**
+ * Aktualizuje indeks po wycofaniu ruchu gracza na pole (x, y). Wywoływana
+ * po wycofaniu ruchu na planszy @p b, z tymi samymi argumentami co
+ * odpowiadające mu wywołanie @ref moves_move. Gdy wycofywany jest ostatni
+ * ruch wykonany z indeksem, a @p undo zawiera opis zapisany przez
+ * @ref moves_move, przywraca dokładnie wcześniejszą numerację pól;
+ * w przeciwnym razie (ruch sprzed utworzenia indeksu, @p undo równe NULL)
+ * przywraca tylko zbiory pól. Nie alokuje pamięci, więc musi zostać
+ * poprzedzona wywołaniem @ref moves_reserve_undo.
+ */
+void moves_undo(moves_t m, board_t b, uint32_t x, uint32_t y, uint32_t player,
+                uint64_t neighbour_players, const moves_undo_t *undo);
+
+/**
+ * Wyznacza wolne pole o numerze @p n. Zwraca false, gdy wolnych pól jest
+ * co najwyżej @p n.
+ */
+bool moves_free_field(moves_t m, uint64_t n, uint32_t *x, uint32_t *y);
+
+/**
+ * Wyznacza wolne pole o numerze @p n sąsiadujące z obszarami gracza.
+ * Zwraca false, gdy takich pól jest co najwyżej @p n.
+ */
+bool moves_frontier_field(moves_t m, uint32_t player, uint64_t n,
+                          uint32_t *x, uint32_t *y);
+
+#endif /* MOVES_H */
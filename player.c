@@ -10,25 +10,26 @@
 #include "player.h"
 #include "constants.h"
 
+char player_symbol(uint32_t player) {
+    if (player == NO_PLAYER) {
+        return EMPTY_FIELD_SYMBOL;
+    }
+    return (char)((player < 10) ? '0' + player : 'A' + player - 10);
+}
+
 player_t player_new(char symbol) {
     return (player_t) {.symbol = symbol, .areas = 0, .busy_fields = 0, .free_neighbours = 0};
 }
 
-void player_set_neighbour_to_remove(player_t *p) {
+void player_remove_neighbour(player_t *p) {
     assert(p != NULL);
-    if (p->symbol == EMPTY_FIELD_SYMBOL) {
-        return;
-    }
-    p->neighbour_to_remove = true;
+    assert(p->free_neighbours > 0);
+    p->free_neighbours--;
 }
 
-void player_remove_neighbour(player_t *p) {
+void player_add_neighbour(player_t *p) {
     assert(p != NULL);
-    if (p->symbol != EMPTY_FIELD_SYMBOL && p->neighbour_to_remove) {
-        p->neighbour_to_remove = false;
-        assert(p->free_neighbours > 0);
-        p->free_neighbours--;
-    }
+    p->free_neighbours++;
 }
 
 void player_move(player_t *p, uint32_t new_neighbours, uint32_t merged_areas) {
@@ -38,6 +39,16 @@ void player_move(player_t *p, uint32_t new_neighbours, uint32_t merged_areas) {
     player_update_area(p, merged_areas);
 }
 
+void player_undo_move(player_t *p, uint32_t new_neighbours,
+                      uint32_t merged_areas) {
+    assert(p != NULL);
+    assert(p->busy_fields > 0 && p->free_neighbours >= new_neighbours);
+    assert(p->areas + merged_areas >= 1);
+    p->busy_fields--;
+    p->free_neighbours -= new_neighbours;
+    p->areas = p->areas + merged_areas - 1;
+}
+
 uint64_t player_free_fields(const player_t *p, uint32_t areas, uint64_t free_fields) {
     assert(p != NULL);
     if (p->areas < areas) {
@@ -19,30 +19,41 @@ typedef struct player_t {
     uint32_t free_neighbours; /* Liczba wolnych pól sąsiadujących z obszarami gracza. */
     uint32_t areas;
     char symbol;
-    bool neighbour_to_remove;
 } player_t;
 
 /**
- * Tworzy nowego gracza.
+ * Zwraca symbol gracza o zadanym numerze. Dla numeru @p NO_PLAYER zwraca
+ * symbol pustego pola.
  */
-player_t player_new(char symbol);
+char player_symbol(uint32_t player);
 
 /**
- * Ustawia informację, że istnieje sąsiadujące z obszarami gracza pole,
- * które należy usunąć, gdyż zostało zajęte.
+ * Tworzy nowego gracza.
  */
-void player_set_neighbour_to_remove(player_t* p);
+player_t player_new(char symbol);
 
 /**
  * Zmniejsza liczbę wolnych pól sąsiadujących z obszarami gracza.
  */
 void player_remove_neighbour(player_t* p);
 
+/**
+ * Zwiększa liczbę wolnych pól sąsiadujących z obszarami gracza.
+ */
+void player_add_neighbour(player_t* p);
+
 /**
  * Wykonuje ruch gracza.
  */
 void player_move(player_t *p, uint32_t new_neighbours, uint32_t merged_areas);
 
+/**
+ * Wycofuje ruch gracza wykonany przez @ref player_move z tymi samymi
+ * argumentami.
+ */
+void player_undo_move(player_t *p, uint32_t new_neighbours,
+                      uint32_t merged_areas);
+
 /**
  * Podaje liczbę pól, które jeszcze gracz może zająć.
  */
@@ -0,0 +1,447 @@
+/** @file
+ * Implementacja modułu dziennika ruchów
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "replay.h"
+#include "safe_memory_allocation.h"
+#include "constants.h"
+
+/**
+ * Wartość zapisywana w nagłówku do rozpoznania porządku bajtów.
+ */
+#define REPLAY_BYTE_ORDER 0x01020304u
+
+/**
+ * Maksymalna liczba bajtów wpisu: 6 bajtów pierwszej liczby (33 bity
+ * różnicy i 6 bitów gracza) i 5 bajtów drugiej.
+ */
+#define REPLAY_ENTRY_MAX_BYTES 11
+
+/**
+ * Rozmiar bufora danych bloku.
+ */
+#define REPLAY_BLOCK_BYTES (REPLAY_BLOCK_ENTRIES * REPLAY_ENTRY_MAX_BYTES)
+
+/**
+ * To jest struktura opisująca zapis dziennika. Bufor zawiera nagłówek
+ * bloku i jego dane, więc blok jest zapisywany jednym wywołaniem.
+ */
+struct replay_writer {
+    int fd;
+    int error;              /* Pierwszy błąd zapisu lub 0. */
+    uint32_t player_bits;
+    uint32_t entries;
+    size_t used;
+    int64_t x;              /* Pole poprzedniego ruchu w bloku. */
+    int64_t y;
+    unsigned char buffer[sizeof(replay_block_t) + REPLAY_BLOCK_BYTES];
+};
+
+/**
+ * To jest struktura opisująca odczyt zmapowanego dziennika.
+ */
+struct replay_reader {
+    const unsigned char *data;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t player_bits;
+    replay_header_t header;
+};
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca liczbę bitów potrzebnych na numer gracza.
+ */
+static uint32_t replay_player_bits(uint32_t players) {
+    return 32 - (uint32_t)__builtin_clz(players);
+}
+
+/**
+ * Zwraca nagłówek dziennika gry o zadanych parametrach.
+ */
+static replay_header_t replay_header(uint32_t width, uint32_t height,
+                                     uint32_t players, uint32_t areas) {
+    replay_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    h.version = REPLAY_VERSION;
+    h.byte_order = REPLAY_BYTE_ORDER;
+    h.width = width;
+    h.height = height;
+    h.players = players;
+    h.areas = areas;
+    return h;
+}
+
+/**
+ * Zwraca sumę kontrolną danych bloku. Dane są czytane słowami 64-bitowymi,
+ * więc suma kosztuje ułamek nanosekundy na wpis.
+ */
+static uint64_t replay_checksum(const unsigned char *data, uint32_t size,
+                                uint32_t entries) {
+    uint64_t hash = UINT64_C(0xCBF29CE484222325) ^ ((uint64_t)entries << 32 | size);
+    uint32_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+        hash ^= hash >> 29;
+    }
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    hash = (hash ^ word) * UINT64_C(0x9E3779B97F4A7C15);
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * Koduje różnicę naprzemiennie: 0, -1, 1, -2, ... na 0, 1, 2, 3, ...
+ */
+static inline uint64_t replay_zigzag(int64_t delta) {
+    return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+/**
+ * Odwraca @ref replay_zigzag.
+ */
+static inline int64_t replay_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * Dopisuje liczbę kodem o zmiennej długości.
+ */
+static inline void replay_put(replay_writer_t *w, uint64_t value) {
+    unsigned char *out = w->buffer + sizeof(replay_block_t) + w->used;
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    w->used += n;
+}
+
+/**
+ * Odczytuje liczbę zapisaną kodem o zmiennej długości z bufora kończącego
+ * się przed @p end. Zwraca false, gdy liczba wychodzi poza bufor lub ma
+ * więcej niż 64 bity.
+ */
+static inline bool replay_get(const unsigned char **in,
+                              const unsigned char *end, uint64_t *value) {
+    const unsigned char *p = *in;
+    if (p < end && *p < 0x80) {
+        *value = *p;
+        *in = p + 1;
+        return true;
+    }
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            *value = result;
+            *in = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Zapisuje @p size bajtów do deskryptora, ponawiając przerwane
+ * i częściowe zapisy.
+ */
+static bool replay_write_all(int fd, const unsigned char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written == 0) {
+                errno = EIO;
+            }
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+/**
+ * Rozpoczyna nowy wpis, zapisując pełny blok. Zwraca false, gdy któryś
+ * zapis się nie powiódł.
+ */
+static inline bool replay_writer_entry(replay_writer_t *w) {
+    if (w->error != 0
+        || (w->entries == REPLAY_BLOCK_ENTRIES && !replay_writer_flush(w))) {
+        return false;
+    }
+    w->entries++;
+    return true;
+}
+
+/**
+ * Wczytuje nagłówek kolejnego bloku i sprawdza, czy blok mieści się
+ * w pliku. Nie sprawdza sumy kontrolnej.
+ */
+static replay_status_t replay_reader_block(replay_reader_t *r,
+                                           replay_block_t *block) {
+    if (r->offset == r->size) {
+        return REPLAY_END;
+    }
+    if (r->size - r->offset < sizeof(replay_block_t)) {
+        return REPLAY_CORRUPT;
+    }
+    memcpy(block, r->data + r->offset, sizeof(replay_block_t));
+    if (block->magic != REPLAY_BLOCK_MAGIC || block->entries == 0
+        || block->entries > REPLAY_BLOCK_ENTRIES
+        || block->size > r->size - r->offset - sizeof(replay_block_t)) {
+        return REPLAY_CORRUPT;
+    }
+    return REPLAY_BLOCK;
+}
+
+/* FUNKCJE MODUŁU */
+
+replay_writer_t* replay_writer_open(int fd, uint32_t width, uint32_t height,
+                                    uint32_t players, uint32_t areas) {
+    if (players == 0 || players > MAX_NUMBER_OF_PLAYERS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return NULL;
+    }
+    replay_writer_t *w = safe_malloc(sizeof(replay_writer_t));
+    if (w == NULL) {
+        return NULL;
+    }
+    w->fd = fd;
+    w->error = 0;
+    w->player_bits = replay_player_bits(players);
+    w->entries = 0;
+    w->used = 0;
+    w->x = w->y = 0;
+
+    replay_header_t h = replay_header(width, height, players, areas);
+    if (st.st_size == 0) {
+        if (!replay_write_all(fd, (const unsigned char*)&h, sizeof(h))) {
+            free(w);
+            return NULL;
+        }
+        return w;
+    }
+    replay_header_t existing;
+    if (pread(fd, &existing, sizeof(existing), 0) != sizeof(existing)
+        || memcmp(&existing, &h, sizeof(h)) != 0) {
+        free(w);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!replay_writer_control(w, REPLAY_RESET) || !replay_writer_flush(w)) {
+        int error = w->error != 0 ? w->error : errno;
+        free(w);
+        errno = error;
+        return NULL;
+    }
+    return w;
+}
+
+bool replay_writer_move(replay_writer_t *w, uint32_t player,
+                        uint32_t x, uint32_t y) {
+    if (!replay_writer_entry(w)) {
+        return false;
+    }
+    replay_put(w, replay_zigzag((int64_t)x - w->x) << w->player_bits | player);
+    replay_put(w, replay_zigzag((int64_t)y - w->y));
+    w->x = x;
+    w->y = y;
+    return true;
+}
+
+bool replay_writer_control(replay_writer_t *w, replay_control_t control) {
+    if (!replay_writer_entry(w)) {
+        return false;
+    }
+    replay_put(w, (uint64_t)control << w->player_bits | NO_PLAYER);
+    return true;
+}
+
+bool replay_writer_flush(replay_writer_t *w) {
+    if (w->error != 0) {
+        return false;
+    }
+    if (w->entries == 0) {
+        return true;
+    }
+    unsigned char *data = w->buffer + sizeof(replay_block_t);
+    replay_block_t block = {
+        .magic = REPLAY_BLOCK_MAGIC,
+        .entries = w->entries,
+        .size = (uint32_t)w->used,
+        .reserved = 0,
+        .checksum = replay_checksum(data, (uint32_t)w->used, w->entries),
+    };
+    memcpy(w->buffer, &block, sizeof(block));
+    if (!replay_write_all(w->fd, w->buffer, sizeof(block) + w->used)) {
+        w->error = errno;
+        return false;
+    }
+    w->entries = 0;
+    w->used = 0;
+    w->x = w->y = 0;
+    return true;
+}
+
+bool replay_writer_close(replay_writer_t *w) {
+    if (w == NULL) {
+        return true;
+    }
+    bool ok = replay_writer_flush(w);
+    int error = w->error;
+    free(w);
+    if (!ok) {
+        errno = error;
+    }
+    return ok;
+}
+
+replay_reader_t* replay_reader_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    replay_header_t h;
+    if ((uint64_t)st.st_size < sizeof(h)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(&h, data, sizeof(h));
+    replay_header_t expected = replay_header(h.width, h.height, h.players,
+                                             h.areas);
+    if (memcmp(&h, &expected, sizeof(h)) != 0 || h.players == 0
+        || h.players > MAX_NUMBER_OF_PLAYERS) {
+        munmap(data, (size_t)st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    replay_reader_t *r = safe_malloc(sizeof(replay_reader_t));
+    if (r == NULL) {
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    r->data = data;
+    r->size = (uint64_t)st.st_size;
+    r->offset = sizeof(h);
+    r->player_bits = replay_player_bits(h.players);
+    r->header = h;
+    return r;
+}
+
+const replay_header_t* replay_reader_header(replay_reader_t *r) {
+    return &r->header;
+}
+
+replay_status_t replay_reader_next(replay_reader_t *r, replay_entry_t *entries,
+                                   uint32_t *count) {
+    replay_block_t block;
+    replay_status_t status = replay_reader_block(r, &block);
+    *count = 0;
+    const unsigned char *in = r->data + r->offset + sizeof(block);
+    if (status != REPLAY_BLOCK
+        || block.checksum != replay_checksum(in, block.size, block.entries)) {
+        return status == REPLAY_END ? REPLAY_END : REPLAY_CORRUPT;
+    }
+
+    const unsigned char *end = in + block.size;
+    uint32_t bits = r->player_bits;
+    uint64_t player_mask = ((uint64_t)1 << bits) - 1;
+    int64_t x = 0, y = 0;
+    for (uint32_t i = 0; i < block.entries; i++) {
+        uint64_t first, second;
+        if (!replay_get(&in, end, &first)) {
+            return REPLAY_CORRUPT;
+        }
+        uint32_t player = (uint32_t)(first & player_mask);
+        if (player == NO_PLAYER) {
+            if ((first >> bits) > REPLAY_UNDO) {
+                return REPLAY_CORRUPT;
+            }
+            entries[i] = (replay_entry_t){NO_PLAYER, (uint32_t)(first >> bits), 0};
+            continue;
+        }
+        if (player > r->header.players || !replay_get(&in, end, &second)) {
+            return REPLAY_CORRUPT;
+        }
+        x += replay_unzigzag(first >> bits);
+        y += replay_unzigzag(second);
+        if ((uint64_t)x > UINT32_MAX || (uint64_t)y > UINT32_MAX) {
+            return REPLAY_CORRUPT;
+        }
+        entries[i] = (replay_entry_t){player, (uint32_t)x, (uint32_t)y};
+    }
+    if (in != end) {
+        return REPLAY_CORRUPT;
+    }
+    r->offset += sizeof(block) + block.size;
+    *count = block.entries;
+    return REPLAY_BLOCK;
+}
+
+replay_status_t replay_reader_skip(replay_reader_t *r, uint32_t *count) {
+    replay_block_t block;
+    replay_status_t status = replay_reader_block(r, &block);
+    *count = 0;
+    if (status == REPLAY_BLOCK) {
+        r->offset += sizeof(block) + block.size;
+        *count = block.entries;
+    }
+    return status;
+}
+
+uint64_t replay_reader_offset(replay_reader_t *r) {
+    return r->offset;
+}
+
+uint64_t replay_reader_size(replay_reader_t *r) {
+    return r->size;
+}
+
+void replay_reader_seek(replay_reader_t *r, uint64_t offset) {
+    r->offset = offset;
+}
+
+void replay_reader_close(replay_reader_t *r) {
+    if (r != NULL) {
+        munmap((void*)r->data, r->size);
+        free(r);
+    }
+}
@@ -0,0 +1,196 @@
+/** @file
+ * Interfejs modułu dziennika ruchów
+ *
+ * Dziennik ruchów jest plikiem, do którego tylko się dopisuje. Zaczyna się
+ * nagłówkiem @ref replay_header_t z parametrami gry, po którym następują
+ * bloki. Blok zaczyna się nagłówkiem @ref replay_block_t z liczbą wpisów,
+ * rozmiarem danych i ich sumą kontrolną, więc uszkodzony lub niedopisany
+ * blok jest wykrywany bez czytania dalszej części pliku.
+ *
+ * Wpis ruchu składa się z dwóch liczb zapisanych kodem o zmiennej długości
+ * (po 7 bitów w bajcie): pierwsza zawiera numer gracza w najmłodszych
+ * bitach i różnicę kolumny względem poprzedniego ruchu w bloku w pozostałych,
+ * druga zawiera różnicę wiersza. Różnice są kodowane naprzemiennie
+ * (0, -1, 1, -2, ...), więc ruch na małej planszy zajmuje zwykle dwa bajty.
+ * Wpis z graczem @p NO_PLAYER jest wpisem sterującym z kodem
+ * @ref replay_control_t zamiast różnicy kolumny i bez drugiej liczby.
+ * Każdy blok zaczyna kodowanie różnic od pola (0, 0), więc bloki można
+ * dekodować niezależnie.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Znacznik początku dziennika.
+ */
+#define REPLAY_MAGIC "IPPLOG"
+
+/**
+ * Wersja formatu dziennika.
+ */
+#define REPLAY_VERSION 1
+
+/**
+ * Znacznik początku bloku.
+ */
+#define REPLAY_BLOCK_MAGIC 0x4B4C4252u
+
+/**
+ * Maksymalna liczba wpisów w bloku.
+ */
+#define REPLAY_BLOCK_ENTRIES 4096
+
+/**
+ * To jest struktura przechowująca nagłówek dziennika.
+ */
+typedef struct replay_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+} replay_header_t;
+
+/**
+ * To jest struktura przechowująca nagłówek bloku dziennika.
+ */
+typedef struct replay_block {
+    uint32_t magic;
+    uint32_t entries;
+    uint32_t size;          /* Rozmiar danych bloku w bajtach. */
+    uint32_t reserved;
+    uint64_t checksum;      /* Suma kontrolna danych, liczby wpisów i rozmiaru. */
+} replay_block_t;
+
+/**
+ * To jest typ wyliczeniowy opisujący wpisy sterujące.
+ */
+typedef enum replay_control {
+    REPLAY_RESET,   /* Gra została przywrócona do stanu początkowego. */
+    REPLAY_UNDO,    /* Ostatni ruch został wycofany. */
+} replay_control_t;
+
+/**
+ * To jest struktura opisująca wpis dziennika. Dla wpisu sterującego
+ * @p player ma wartość @p NO_PLAYER, a @p x zawiera kod wpisu.
+ */
+typedef struct replay_entry {
+    uint32_t player;
+    uint32_t x;
+    uint32_t y;
+} replay_entry_t;
+
+/**
+ * To jest typ wyliczeniowy opisujący wynik czytania bloku.
+ */
+typedef enum replay_status {
+    REPLAY_BLOCK,       /* Wczytano blok. */
+    REPLAY_END,         /* Dziennik się skończył. */
+    REPLAY_CORRUPT,     /* Blok jest uszkodzony lub niedopisany. */
+} replay_status_t;
+
+/**
+ * To jest deklaracja struktury opisującej zapis dziennika.
+ */
+typedef struct replay_writer replay_writer_t;
+
+/**
+ * To jest deklaracja struktury opisującej odczyt dziennika.
+ */
+typedef struct replay_reader replay_reader_t;
+
+/**
+ * Rozpoczyna dopisywanie do dziennika otwartego do odczytu i zapisu
+ * w deskryptorze @p fd (zwykle z flagą @p O_APPEND). Do pustego pliku
+ * zapisuje nagłówek z parametrami gry; w niepustym sprawdza, czy nagłówek
+ * ma te same parametry, i od razu zapisuje blok z wpisem @ref REPLAY_RESET
+ * rozpoczynającym nową grę, żeby gry w dzienniku nigdy się nie zlały.
+ * Zwraca NULL, gdy nie udało się alokować pamięci, zapisać nagłówka lub wpisu
+ * @ref REPLAY_RESET albo plik zawiera dziennik innej gry; @p errno opisuje
+ * wtedy błąd.
+ */
+replay_writer_t* replay_writer_open(int fd, uint32_t width, uint32_t height,
+                                    uint32_t players, uint32_t areas);
+
+/**
+ * Dopisuje ruch gracza na pole (x, y). Pełny blok jest zapisywany jednym
+ * wywołaniem @p write. Zwraca false, gdy któryś zapis się nie powiódł.
+ */
+bool replay_writer_move(replay_writer_t *w, uint32_t player,
+                        uint32_t x, uint32_t y);
+
+/**
+ * Dopisuje wpis sterujący. Zwraca false, gdy któryś zapis się nie powiódł.
+ */
+bool replay_writer_control(replay_writer_t *w, replay_control_t control);
+
+/**
+ * Zapisuje niepełny blok. Zwraca false, gdy któryś zapis się nie powiódł.
+ */
+bool replay_writer_flush(replay_writer_t *w);
+
+/**
+ * Zapisuje niepełny blok i zwalnia strukturę. Nie zamyka deskryptora.
+ * Zwraca false, gdy któryś zapis się nie powiódł; @p errno opisuje wtedy
+ * pierwszy błąd.
+ */
+bool replay_writer_close(replay_writer_t *w);
+
+/**
+ * Mapuje do pamięci dziennik z pliku @p path i sprawdza jego nagłówek.
+ * Zwraca NULL, gdy nie udało się otworzyć pliku lub plik nie jest
+ * dziennikiem; @p errno opisuje wtedy błąd.
+ */
+replay_reader_t* replay_reader_open(const char *path);
+
+/**
+ * Zwraca nagłówek dziennika.
+ */
+const replay_header_t* replay_reader_header(replay_reader_t *r);
+
+/**
+ * Sprawdza sumę kontrolną kolejnego bloku i dekoduje go do tablicy
+ * @p entries o długości @ref REPLAY_BLOCK_ENTRIES, zapisując liczbę wpisów
+ * pod @p count.
+ */
+replay_status_t replay_reader_next(replay_reader_t *r, replay_entry_t *entries,
+                                   uint32_t *count);
+
+/**
+ * Pomija kolejny blok, sprawdzając tylko jego nagłówek, i zapisuje liczbę
+ * jego wpisów pod @p count. Pozwala szybko wyznaczyć położenie bloków.
+ */
+replay_status_t replay_reader_skip(replay_reader_t *r, uint32_t *count);
+
+/**
+ * Zwraca przesunięcie w pliku pierwszego niewczytanego bloku.
+ */
+uint64_t replay_reader_offset(replay_reader_t *r);
+
+/**
+ * Przechodzi do bloku zaczynającego się w przesunięciu @p offset,
+ * zwróconym wcześniej przez @ref replay_reader_offset.
+ */
+void replay_reader_seek(replay_reader_t *r, uint64_t offset);
+
+/**
+ * Zwraca rozmiar pliku dziennika.
+ */
+uint64_t replay_reader_size(replay_reader_t *r);
+
+/**
+ * Odmapowuje dziennik i zwalnia strukturę.
+ */
+void replay_reader_close(replay_reader_t *r);
+
+#endif /* REPLAY_H */
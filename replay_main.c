@@ -0,0 +1,361 @@
+/** @file
+ * Program odtwarzający dziennik ruchów.
+ *
+ * Wczytuje dziennik zapisany przez @ref game_set_replay, sprawdza sumy
+ * kontrolne bloków i wykonuje zapisane ruchy w silniku gry, sprawdzając, że
+ * każdy z nich jest dozwolony. Gry zapisane w jednym dzienniku są od siebie
+ * niezależne, więc mogą być odtwarzane równolegle: bloki są dzielone między
+ * wątki, a każdy wątek odtwarza gry zaczynające się w jego blokach.
+ * Wypisuje liczbę gier i ruchów, rozmiar dziennika, szybkość odtwarzania
+ * i stan ostatniej gry.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "constants.h"
+#include "game.h"
+#include "replay.h"
+#include "safe_memory_allocation.h"
+
+/**
+ * Maksymalna liczba wątków.
+ */
+#define REPLAY_MAX_THREADS 256
+
+/**
+ * To jest struktura przechowująca wyniki odtwarzania.
+ */
+typedef struct replay_result {
+    uint64_t games;
+    uint64_t moves;
+    uint64_t rejected;          /* Ruchy i wycofania odrzucone przez silnik. */
+    uint64_t first_rejected;    /* Numer pierwszego odrzuconego wpisu. */
+    uint64_t corrupt_offset;    /* Przesunięcie pierwszego uszkodzonego bloku. */
+} replay_result_t;
+
+/**
+ * To jest struktura przechowująca stan wątku odtwarzania. Wątek odtwarza
+ * gry, które zaczynają się w jego przedziale bloków, kończąc ostatnią z nich
+ * w kolejnych blokach. Wyniki kolejnych wątków są rozdzielone odstępem, żeby
+ * wątki nie zapisywały do wspólnych linii pamięci podręcznej.
+ */
+typedef struct worker {
+    pthread_t thread;
+    bool started;
+    bool check;                 /* Czy tylko sprawdzać sumy kontrolne. */
+    bool played;                /* Czy wątek odtworzył jakąś grę. */
+    uint64_t repeats;
+    const uint64_t *offsets;    /* Przesunięcia bloków. */
+    const uint64_t *first;      /* Numery pierwszych wpisów bloków. */
+    uint64_t begin;             /* Przedział bloków wątku. */
+    uint64_t end;
+    replay_reader_t *reader;
+    game_t *game;
+    replay_entry_t *entries;
+    replay_result_t result;
+    char padding[64];
+} worker_t;
+
+/**
+ * Zwraca czas monotoniczny w sekundach.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/**
+ * Konwertuje napis na liczbę 64 bitową. Zwraca 0, gdy napis jest
+ * niepoprawny.
+ */
+static uint64_t parse_uint64(const char* str) {
+    char *endptr;
+    errno = 0;
+    uint64_t number = strtoull(str, &endptr, 10);
+    if (errno != 0 || *endptr != '\0') {
+        return 0;
+    }
+    return number;
+}
+
+/**
+ * Rozpoczyna kolejną grę wątku.
+ */
+static void worker_new_game(worker_t *w) {
+    if (!w->check) {
+        game_reset(w->game);
+    }
+    w->played = true;
+    w->result.games++;
+}
+
+/**
+ * Wykonuje wpis @p e o numerze @p index w grze wątku.
+ */
+static void worker_entry(worker_t *w, const replay_entry_t *e, uint64_t index) {
+    bool ok = true;
+    if (e->player != NO_PLAYER) {
+        w->result.moves++;
+        ok = w->check || game_move(w->game, e->player, e->x, e->y);
+    }
+    else if (!w->check) {
+        ok = game_undo(w->game);
+    }
+    if (!ok && w->result.rejected++ == 0) {
+        w->result.first_rejected = index;
+    }
+}
+
+/**
+ * Odtwarza jeden raz gry zaczynające się w przedziale bloków wątku.
+ * Wątek zaczynający od pierwszego bloku zaczyna od razu pierwszą grę,
+ * a pozostałe pomijają wpisy do pierwszego wpisu @ref REPLAY_RESET.
+ */
+static void worker_replay(worker_t *w) {
+    replay_reader_seek(w->reader, w->offsets[w->begin]);
+    bool active = w->begin == 0;
+    if (active) {
+        worker_new_game(w);
+    }
+    for (uint64_t block = w->begin; active || block < w->end; block++) {
+        uint32_t count;
+        replay_status_t status = replay_reader_next(w->reader, w->entries,
+                                                    &count);
+        if (status == REPLAY_CORRUPT
+            && replay_reader_offset(w->reader) < w->result.corrupt_offset) {
+            w->result.corrupt_offset = replay_reader_offset(w->reader);
+        }
+        if (status != REPLAY_BLOCK) {
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const replay_entry_t *e = &w->entries[i];
+            if (e->player == NO_PLAYER && e->x == REPLAY_RESET) {
+                if (block >= w->end) {
+                    return;
+                }
+                active = true;
+                worker_new_game(w);
+            }
+            else if (active) {
+                worker_entry(w, e, w->first[block] + i);
+            }
+        }
+    }
+}
+
+/**
+ * Odtwarza przedział bloków wątku zadaną liczbę razy.
+ */
+static void* worker_run(void *arg) {
+    worker_t *w = arg;
+    for (uint64_t i = 0; i < w->repeats; i++) {
+        worker_replay(w);
+    }
+    return NULL;
+}
+
+/**
+ * Wyznacza przesunięcia bloków dziennika i numery ich pierwszych wpisów.
+ * Bloki zaczynające się za pierwszym uszkodzonym nagłówkiem są pomijane.
+ * Zapisuje liczbę bloków pod @p blocks. Zwraca false, gdy nie udało się
+ * alokować pamięci.
+ */
+static bool index_blocks(replay_reader_t *r, uint64_t **offsets,
+                         uint64_t **first, uint64_t *blocks) {
+    uint64_t capacity = 16;
+    *blocks = 0;
+    *offsets = safe_malloc(capacity * sizeof(uint64_t));
+    *first = safe_malloc(capacity * sizeof(uint64_t));
+    uint64_t entries = 0;
+    uint32_t count;
+    while (*offsets != NULL && *first != NULL) {
+        (*offsets)[*blocks] = replay_reader_offset(r);
+        (*first)[*blocks] = entries;
+        if (replay_reader_skip(r, &count) != REPLAY_BLOCK) {
+            return true;
+        }
+        entries += count;
+        if (++*blocks == capacity) {
+            capacity *= 2;
+            uint64_t *o = safe_realloc(*offsets, capacity * sizeof(uint64_t));
+            *offsets = o != NULL ? o : *offsets;
+            uint64_t *f = safe_realloc(*first, capacity * sizeof(uint64_t));
+            *first = f != NULL ? f : *first;
+            if (o == NULL || f == NULL) {
+                break;
+            }
+        }
+    }
+    free(*offsets);
+    free(*first);
+    return false;
+}
+
+/**
+ * Wypisuje sposób użycia programu.
+ */
+static int usage(const char *name) {
+    fprintf(stderr, "Użycie:\n%s [-c] [-j wątki] [-u historia] "
+                    "[-r powtórzenia] plik\n"
+                    "  -c       tylko sprawdza sumy kontrolne i dekoduje wpisy\n"
+                    "  -j liczba wątków, zero oznacza liczbę procesorów\n"
+                    "  -u liczba ruchów, które można wycofać (dla dzienników "
+                    "z wycofaniami)\n"
+                    "  -r liczba odtworzeń dziennika (do pomiaru szybkości)\n",
+            name);
+    return WRONG_INPUT;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t history = 0;
+    uint64_t repeats = 1;
+    uint64_t threads = 1;
+    bool check = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "u:r:j:c")) != -1) {
+        switch (opt) {
+            case 'u':
+                history = parse_uint64(optarg);
+                break;
+            case 'r':
+                repeats = parse_uint64(optarg);
+                if (repeats == 0) {
+                    return usage(argv[0]);
+                }
+                break;
+            case 'j':
+                threads = parse_uint64(optarg);
+                break;
+            case 'c':
+                check = true;
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+    if (argc - optind != 1) {
+        return usage(argv[0]);
+    }
+    const char *path = argv[optind];
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (uint64_t)online : 1;
+    }
+
+    replay_reader_t *r = replay_reader_open(path);
+    if (r == NULL) {
+        fprintf(stderr, "Nie udało się wczytać dziennika ruchów.\n");
+        return WRONG_INPUT;
+    }
+    const replay_header_t *h = replay_reader_header(r);
+    double start = now();
+    uint64_t *offsets, *first, blocks;
+    if (!index_blocks(r, &offsets, &first, &blocks)) {
+        replay_reader_close(r);
+        fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+        return MEMORY_ERROR;
+    }
+    if (threads > blocks) {
+        threads = blocks > 0 ? blocks : 1;
+    }
+    if (threads > REPLAY_MAX_THREADS) {
+        threads = REPLAY_MAX_THREADS;
+    }
+    worker_t *workers = safe_calloc(threads, sizeof(worker_t));
+    bool ok = workers != NULL;
+    for (uint64_t i = 0; i < threads && ok; i++) {
+        worker_t *w = &workers[i];
+        w->check = check;
+        w->repeats = repeats;
+        w->offsets = offsets;
+        w->first = first;
+        w->begin = blocks * i / threads;
+        w->end = blocks * (i + 1) / threads;
+        w->result.corrupt_offset = UINT64_MAX;
+        w->reader = i == 0 ? r : replay_reader_open(path);
+        w->game = game_new(h->width, h->height, h->players, h->areas);
+        w->entries = safe_malloc(REPLAY_BLOCK_ENTRIES * sizeof(replay_entry_t));
+        ok = w->reader != NULL && w->game != NULL && w->entries != NULL
+             && game_set_history(w->game, history);
+    }
+    for (uint64_t i = 1; i < threads && ok; i++) {
+        workers[i].started = pthread_create(&workers[i].thread, NULL,
+                                            worker_run, &workers[i]) == 0;
+    }
+    if (ok) {
+        worker_run(&workers[0]);
+    }
+
+    replay_result_t result = {.corrupt_offset = UINT64_MAX};
+    const worker_t *last = NULL;
+    for (uint64_t i = 0; workers != NULL && i < threads; i++) {
+        worker_t *w = &workers[i];
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+        }
+        if (w->result.rejected > 0 && result.rejected == 0) {
+            result.first_rejected = w->result.first_rejected;
+        }
+        result.games += w->result.games;
+        result.moves += w->result.moves;
+        result.rejected += w->result.rejected;
+        if (w->result.corrupt_offset < result.corrupt_offset) {
+            result.corrupt_offset = w->result.corrupt_offset;
+        }
+        last = w->played ? w : last;
+    }
+    double seconds = now() - start;
+
+    int status = 0;
+    if (!ok) {
+        fprintf(stderr, "Nie udało się zaalokować pamiąci.\n");
+        status = MEMORY_ERROR;
+    }
+    else {
+        uint64_t bytes = replay_reader_size(r) * repeats;
+        printf("gry: %lu\nruchy: %lu\nodrzucone: %lu\nbajty: %lu\n"
+               "bajty/ruch: %.2f\nwątki: %lu\nczas: %.3f s\n"
+               "ruchy/s: %.0f\n",
+               result.games, result.moves, result.rejected, bytes,
+               result.moves > 0 ? (double)bytes / (double)result.moves : 0.0,
+               threads, seconds,
+               seconds > 0 ? (double)result.moves / seconds : 0.0);
+        for (uint32_t p = 1; !check && last != NULL && p <= h->players; p++) {
+            printf("gracz %u: pól %lu\n", p, game_busy_fields(last->game, p));
+        }
+    }
+    if (result.rejected > 0) {
+        fprintf(stderr, "Odrzucony wpis %lu.\n", result.first_rejected);
+        status = WRONG_INPUT;
+    }
+    if (result.corrupt_offset != UINT64_MAX) {
+        fprintf(stderr, "Uszkodzony blok w przesunięciu %lu.\n",
+                result.corrupt_offset);
+        status = WRONG_INPUT;
+    }
+    for (uint64_t i = 0; workers != NULL && i < threads; i++) {
+        if (i > 0) {
+            replay_reader_close(workers[i].reader);
+        }
+        game_delete(workers[i].game);
+        free(workers[i].entries);
+    }
+    free(workers);
+    free(offsets);
+    free(first);
+    replay_reader_close(r);
+    return status;
+}
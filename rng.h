@@ -0,0 +1,67 @@
+/** @file
+ * Generator liczb pseudolosowych
+ *
+ * Generator xoshiro256** inicjowany ciągiem splitmix64. Każdy wątek używa
+ * własnego stanu, więc losowanie nie wymaga synchronizacji.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/**
+ * To jest struktura przechowująca stan generatora.
+ */
+typedef struct rng {
+    uint64_t s[4];
+} rng_t;
+
+/**
+ * Zwraca kolejną wartość ciągu splitmix64 o stanie @p state.
+ */
+static inline uint64_t rng_splitmix(uint64_t *state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/**
+ * Inicjuje generator ziarnem @p seed.
+ */
+static inline void rng_seed(rng_t *r, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        r->s[i] = rng_splitmix(&seed);
+    }
+}
+
+/**
+ * Zwraca kolejną liczbę pseudolosową.
+ */
+static inline uint64_t rng_next(rng_t *r) {
+    uint64_t *s = r->s;
+    uint64_t x = s[1] * 5;
+    uint64_t result = ((x << 7) | (x >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+/**
+ * Zwraca liczbę pseudolosową z przedziału [0, n). Używa mnożenia zamiast
+ * dzielenia, kosztem pomijalnie nierównego rozkładu.
+ */
+static inline uint64_t rng_below(rng_t *r, uint64_t n) {
+    return (uint64_t)(((unsigned __int128)rng_next(r) * n) >> 64);
+}
+
+#endif /* RNG_H */
@@ -4,7 +4,10 @@
   @author Anna Pawłowska
 */
 
+#define _DEFAULT_SOURCE
+
 #include <errno.h>
+#include <sys/mman.h>
 #include "safe_memory_allocation.h"
 
 void* safe_malloc(size_t size) {
@@ -21,4 +24,43 @@ void* safe_calloc(size_t nmemb, size_t size) {
         errno = ENOMEM;
     }
     return new_ptr;
-}
\ No newline at end of file
+}
+
+void* safe_realloc(void *ptr, size_t size) {
+    void *new_ptr = realloc(ptr, size);
+    if (size > 0 && new_ptr == NULL) {
+        errno = ENOMEM;
+    }
+    return new_ptr;
+}
+
+void* safe_map(size_t size, bool huge_pages) {
+    void *new_ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+        new_ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_HUGETLB,
+                       -1, 0);
+    }
+#endif
+    if (new_ptr == MAP_FAILED) {
+        new_ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (new_ptr == MAP_FAILED) {
+            errno = ENOMEM;
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(new_ptr, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return new_ptr;
+}
+
+void safe_unmap(void *ptr, size_t size) {
+    if (ptr != NULL) {
+        munmap(ptr, size);
+    }
+}
@@ -7,6 +7,7 @@
 #ifndef __SAFE_MEMORY_ALLOCATION_H_
 #define __SAFE_MEMORY_ALLOCATION_H_
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 /**
@@ -26,5 +27,31 @@ void* safe_malloc(size_t size);
  */
 void* safe_calloc(size_t nmemb, size_t size);
 
+/**
+ * Bezpiecznie zmienia rozmiar bloku pamięci.
+ * W przypadku nieudanej próby alokacji stary blok pozostaje nienaruszony.
+ * @param[in] ptr : wskaźnik na blok pamięci.
+ * @param[in] size : nowy rozmiar bloku.
+ * @return wskaźnik na blok pamięci lub NULL.
+ */
+void* safe_realloc(void *ptr, size_t size);
+
+/**
+ * Mapuje wyzerowany blok pamięci. Strony są przydzielane przy pierwszym
+ * zapisie, więc nieużywana część bloku nie zajmuje pamięci.
+ * @param[in] size : rozmiar bloku.
+ * @param[in] huge_pages : czy użyć dużych stron; gdy system ich nie
+ *                         udostępnia, blok jest mapowany zwykłymi stronami.
+ * @return wskaźnik na blok pamięci lub NULL.
+ */
+void* safe_map(size_t size, bool huge_pages);
+
+/**
+ * Zwalnia blok pamięci zmapowany przez @ref safe_map.
+ * @param[in] ptr : wskaźnik na blok pamięci lub NULL.
+ * @param[in] size : rozmiar bloku.
+ */
+void safe_unmap(void *ptr, size_t size);
+
 #endif /* __SAFE_MEMORY_ALLOCATION_H__ */
 
@@ -0,0 +1,378 @@
+/** @file
+ * Implementacja modułu rysowania planszy w terminalu
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "safe_memory_allocation.h"
+#include "screen.h"
+#include "constants.h"
+
+/**
+ * Maksymalna liczba pól zaznaczonych jako zmienione między klatkami.
+ * Po jej przekroczeniu klatka porównuje wszystkie pola.
+ */
+#define SCREEN_DIRTY 64
+
+/**
+ * Maksymalna długość sekwencji sterującej przesuwającej kursor terminala.
+ */
+#define SCREEN_MOVE_LENGTH 32
+
+/**
+ * To jest typ wyliczeniowy opisujący kolory pól.
+ */
+typedef enum screen_style {
+    STYLE_UNKNOWN,  /* Pole nie zostało jeszcze narysowane. */
+    STYLE_PLAIN,    /* Pole innego gracza. */
+    STYLE_EMPTY,    /* Wolne pole. */
+    STYLE_CURRENT,  /* Pole wyróżnianego gracza. */
+    STYLE_CURSOR,   /* Pole pod kursorem. */
+} screen_style_t;
+
+/**
+ * Sekwencje sterujące ustawiające kolory pól.
+ */
+static const char *const styles[] = {
+    [STYLE_UNKNOWN] = "",
+    [STYLE_PLAIN] = "\x1b[0m",
+    [STYLE_EMPTY] = "\x1b[0;38;2;" MINT_GREEN "m",
+    [STYLE_CURRENT] = "\x1b[0;38;2;" DARK_ORCHID "m",
+    [STYLE_CURSOR] = "\x1b[0;30;48;2;" DARK_ORCHID "m",
+};
+
+/**
+ * To jest struktura opisująca stan terminala. Terminal pokazuje widok:
+ * prostokąt planszy o lewym górnym rogu w kolumnie @p left i wierszu
+ * @p top, licząc wiersze od góry. Bufor ekranu zawiera dla każdego pola
+ * widoku jego symbol w młodszym bajcie i kolor w starszym; zero oznacza
+ * pole, którego zawartość w terminalu nie jest znana.
+ */
+struct screen {
+    int fd;
+    game_t const *g;
+    uint32_t width;             /* Wymiary planszy. */
+    uint32_t height;
+    uint32_t view_width;        /* Wymiary widoku. */
+    uint32_t view_height;
+    uint32_t left;
+    uint32_t top;
+    uint16_t *front;            /* Narysowane pola widoku, wierszami. */
+    uint64_t dirty[SCREEN_DIRTY]; /* Numery zmienionych pól bufora. */
+    uint32_t dirty_count;
+    bool full;                  /* Czy porównać wszystkie pola. */
+    bool clear;                 /* Czy wyczyścić terminal. */
+    bool cursor_visible;
+    uint32_t cursor_x;
+    uint32_t cursor_y;          /* Wiersz kursora, licząc od góry. */
+    uint32_t player;
+    char *status;
+    bool status_changed;
+    char *out;                  /* Bufor klatki. */
+    size_t used;
+    size_t capacity;
+    screen_style_t style;       /* Kolor ustawiony w terminalu. */
+    uint64_t position;          /* Pole, na którym stoi kursor terminala. */
+};
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Dopisuje @p length bajtów do bufora klatki. Zwraca false, gdy nie udało
+ * się alokować pamięci.
+ */
+static bool screen_append(screen_t *s, const char *data, size_t length) {
+    if (s->used + length > s->capacity) {
+        size_t capacity = 2 * s->capacity;
+        while (s->used + length > capacity) {
+            capacity *= 2;
+        }
+        char *out = safe_realloc(s->out, capacity);
+        if (out == NULL) {
+            return false;
+        }
+        s->out = out;
+        s->capacity = capacity;
+    }
+    memcpy(s->out + s->used, data, length);
+    s->used += length;
+    return true;
+}
+
+/**
+ * Dopisuje napis do bufora klatki.
+ */
+static bool screen_append_string(screen_t *s, const char *string) {
+    return screen_append(s, string, strlen(string));
+}
+
+/**
+ * Dopisuje sekwencję przesuwającą kursor terminala do wiersza @p row
+ * i kolumny @p column (liczonych od zera).
+ */
+static bool screen_append_move(screen_t *s, uint64_t row, uint64_t column) {
+    char move[SCREEN_MOVE_LENGTH];
+    int length = snprintf(move, sizeof(move), "\x1b[%lu;%luH",
+                          row + 1, column + 1);
+    return screen_append(s, move, (size_t)length);
+}
+
+/**
+ * Zwraca zawartość pola bufora o numerze @p cell: symbol i kolor.
+ */
+static uint16_t screen_cell(screen_t *s, uint64_t cell) {
+    uint32_t column = s->left + (uint32_t)(cell % s->view_width);
+    uint32_t row = s->top + (uint32_t)(cell / s->view_width);
+    uint32_t player = game_field_player(s->g, column, s->height - 1 - row);
+    screen_style_t style;
+    if (s->cursor_visible && column == s->cursor_x && row == s->cursor_y) {
+        style = STYLE_CURSOR;
+    }
+    else if (player == NO_PLAYER) {
+        style = STYLE_EMPTY;
+    }
+    else if (player == s->player) {
+        style = STYLE_CURRENT;
+    }
+    else {
+        style = STYLE_PLAIN;
+    }
+    return (uint16_t)((unsigned char)game_player(s->g, player)
+                      | (uint16_t)style << 8);
+}
+
+/**
+ * Dopisuje do bufora klatki pole o numerze @p cell, jeśli jego zawartość
+ * w terminalu jest inna. Kursor terminala jest przesuwany tylko wtedy, gdy
+ * pole nie leży zaraz za poprzednio wypisanym, a kolor jest ustawiany tylko
+ * wtedy, gdy się zmienia.
+ */
+static bool screen_draw_cell(screen_t *s, uint64_t cell) {
+    uint16_t value = screen_cell(s, cell);
+    if (s->front[cell] == value) {
+        return true;
+    }
+    screen_style_t style = (screen_style_t)(value >> 8);
+    char symbol = (char)(value & 0xFF);
+    if ((s->position != cell || cell % s->view_width == 0)
+        && !screen_append_move(s, cell / s->view_width,
+                               cell % s->view_width)) {
+        return false;
+    }
+    if (s->style != style && !screen_append_string(s, styles[style])) {
+        return false;
+    }
+    if (!screen_append(s, &symbol, 1)) {
+        return false;
+    }
+    s->style = style;
+    s->position = cell + 1;
+    s->front[cell] = value;
+    return true;
+}
+
+/**
+ * Zaznacza pole bufora o numerze @p cell jako zmienione.
+ */
+static void screen_mark(screen_t *s, uint64_t cell) {
+    if (s->dirty_count == SCREEN_DIRTY) {
+        s->full = true;
+    }
+    else {
+        s->dirty[s->dirty_count++] = cell;
+    }
+}
+
+/**
+ * Zaznacza pole planszy w kolumnie @p column i wierszu @p row (licząc
+ * od góry) jako zmienione, o ile leży w widoku.
+ */
+static void screen_mark_field(screen_t *s, uint32_t column, uint32_t row) {
+    if (column >= s->left && column - s->left < s->view_width
+        && row >= s->top && row - s->top < s->view_height) {
+        screen_mark(s, (uint64_t)(row - s->top) * s->view_width
+                       + (column - s->left));
+    }
+}
+
+/**
+ * Zaznacza pole pod kursorem jako zmienione.
+ */
+static void screen_mark_cursor(screen_t *s) {
+    if (s->cursor_visible) {
+        screen_mark_field(s, s->cursor_x, s->cursor_y);
+    }
+}
+
+/**
+ * Przesuwa początek widoku @p start o najmniejszą odległość, po której
+ * widok długości @p length zawiera pozycję @p position. Zwraca true, jeśli
+ * widok się przesunął.
+ */
+static bool screen_follow(uint32_t *start, uint32_t length,
+                          uint32_t position) {
+    uint32_t old = *start;
+    if (position < *start) {
+        *start = position;
+    }
+    else if (position - *start >= length) {
+        *start = position - length + 1;
+    }
+    return *start != old;
+}
+
+/**
+ * Zapisuje bufor klatki do terminala, ponawiając przerwane
+ * i niepełne zapisy.
+ */
+static bool screen_write(screen_t *s) {
+    size_t written = 0;
+    while (written < s->used) {
+        ssize_t result = write(s->fd, s->out + written, s->used - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            if (result == 0) {
+                errno = EIO;
+            }
+            return false;
+        }
+        written += (size_t)result;
+    }
+    return true;
+}
+
+/* FUNKCJE MODUŁU */
+
+screen_t* screen_new(int fd, game_t const *g, uint32_t columns,
+                     uint32_t rows) {
+    assert(columns > 0 && rows > 0);
+    screen_t *s = safe_calloc(1, sizeof(screen_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->fd = fd;
+    s->g = g;
+    s->width = game_board_width(g);
+    s->height = game_board_height(g);
+    s->view_width = s->width < columns ? s->width : columns;
+    s->view_height = s->height < rows ? s->height : rows;
+    size_t cells = (size_t)s->view_width * s->view_height;
+    s->front = safe_calloc(cells, sizeof(uint16_t));
+    s->capacity = cells + SCREEN_MOVE_LENGTH;
+    s->out = safe_malloc(s->capacity);
+    if (s->front == NULL || s->out == NULL) {
+        screen_delete(s);
+        errno = ENOMEM;
+        return NULL;
+    }
+    s->player = NO_PLAYER;
+    screen_redraw(s);
+    return s;
+}
+
+void screen_delete(screen_t *s) {
+    if (s != NULL) {
+        free(s->front);
+        free(s->status);
+        free(s->out);
+        free(s);
+    }
+}
+
+void screen_redraw(screen_t *s) {
+    s->clear = true;
+    s->full = true;
+    s->status_changed = true;
+}
+
+void screen_set_cursor(screen_t *s, bool visible, uint32_t x, uint32_t y) {
+    screen_mark_cursor(s);
+    s->cursor_visible = visible;
+    s->cursor_x = x;
+    s->cursor_y = s->height - 1 - y;
+    if (visible) {
+        bool moved = screen_follow(&s->left, s->view_width, s->cursor_x);
+        moved |= screen_follow(&s->top, s->view_height, s->cursor_y);
+        s->full |= moved;
+    }
+    screen_mark_cursor(s);
+}
+
+void screen_set_player(screen_t *s, uint32_t player) {
+    if (s->player != player) {
+        s->player = player;
+        s->full = true;
+    }
+}
+
+void screen_field_changed(screen_t *s, uint32_t x, uint32_t y) {
+    screen_mark_field(s, x, s->height - 1 - y);
+}
+
+bool screen_set_status(screen_t *s, const char *status) {
+    if (s->status != NULL && strcmp(s->status, status) == 0) {
+        return true;
+    }
+    char *copy = safe_malloc(strlen(status) + 1);
+    if (copy == NULL) {
+        return false;
+    }
+    strcpy(copy, status);
+    free(s->status);
+    s->status = copy;
+    s->status_changed = true;
+    return true;
+}
+
+bool screen_flush(screen_t *s) {
+    s->used = 0;
+    s->style = STYLE_UNKNOWN;
+    s->position = UINT64_MAX;
+    uint64_t cells = (uint64_t)s->view_width * s->view_height;
+    if (s->clear) {
+        memset(s->front, 0, cells * sizeof(uint16_t));
+        if (!screen_append_string(s, "\x1b[H\x1b[J")) {
+            return false;
+        }
+    }
+    bool ok = true;
+    if (s->full) {
+        for (uint64_t cell = 0; ok && cell < cells; cell++) {
+            ok = screen_draw_cell(s, cell);
+        }
+    }
+    else {
+        for (uint32_t i = 0; ok && i < s->dirty_count; i++) {
+            ok = screen_draw_cell(s, s->dirty[i]);
+        }
+    }
+    if (ok && s->style != STYLE_UNKNOWN && s->style != STYLE_PLAIN) {
+        ok = screen_append_string(s, styles[STYLE_PLAIN]);
+    }
+    if (ok && s->status_changed) {
+        ok = screen_append_move(s, s->view_height, 0)
+             && screen_append_string(s, "\x1b[J")
+             && (s->status == NULL || screen_append_string(s, s->status));
+    }
+    if (!ok) {
+        screen_redraw(s);
+        errno = ENOMEM;
+        return false;
+    }
+    s->clear = false;
+    s->full = false;
+    s->dirty_count = 0;
+    s->status_changed = false;
+    return screen_write(s);
+}
@@ -0,0 +1,83 @@
+/** @file
+ * Interfejs modułu rysowania planszy w terminalu
+ *
+ * Terminal pokazuje widok: prostokątny fragment planszy mieszczący się
+ * w oknie, przesuwany tak, żeby zawierał kursor. Pola widoku są czytane
+ * bezpośrednio ze stanu gry, więc koszt klatki zależy od rozmiaru widoku,
+ * a nie planszy.
+ * Moduł pamięta, co zostało już narysowane w terminalu (bufor ekranu),
+ * i w kolejnej klatce wypisuje tylko pola, które się zmieniły: zajęte pole
+ * i pola, które kursor opuścił lub na które wszedł. Wszystkie pola widoku
+ * są porównywane tylko wtedy, gdy zmienia się wyróżniany gracz lub widok
+ * się przesuwa. Kolejne pola
+ * tego samego koloru dzielą jedną sekwencję sterującą, a cała klatka jest
+ * zapisywana do terminala jednym wywołaniem @p write.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+
+/**
+ * To jest deklaracja struktury opisującej stan terminala.
+ */
+typedef struct screen screen_t;
+
+/**
+ * Tworzy bufor ekranu dla gry @p g rysowanej do deskryptora @p fd. Widok
+ * ma co najwyżej @p columns kolumn i @p rows wierszy (liczby dodatnie),
+ * a tekst pod planszą jest wypisywany zaraz pod widokiem. Pierwsza klatka
+ * czyści terminal i rysuje cały widok. Zwraca NULL, gdy nie udało się
+ * alokować pamięci; @p errno ma wtedy wartość @p ENOMEM.
+ */
+screen_t* screen_new(int fd, game_t const *g, uint32_t columns,
+                     uint32_t rows);
+
+/**
+ * Zwalnia bufor ekranu.
+ */
+void screen_delete(screen_t *s);
+
+/**
+ * Sprawia, że kolejna klatka wyczyści terminal i narysuje wszystko od nowa.
+ */
+void screen_redraw(screen_t *s);
+
+/**
+ * Ustawia kursor na polu (x, y) planszy lub go ukrywa, gdy @p visible
+ * ma wartość false. Widoczny kursor poza widokiem przesuwa widok
+ * o najmniejszą odległość, po której kursor jest w widoku.
+ */
+void screen_set_cursor(screen_t *s, bool visible, uint32_t x, uint32_t y);
+
+/**
+ * Ustawia gracza, którego pola są wyróżniane, lub @p NO_PLAYER.
+ */
+void screen_set_player(screen_t *s, uint32_t player);
+
+/**
+ * Zaznacza, że pole (x, y) planszy mogło się zmienić.
+ */
+void screen_field_changed(screen_t *s, uint32_t x, uint32_t y);
+
+/**
+ * Ustawia tekst wypisywany pod planszą. Tekst może zawierać sekwencje
+ * sterujące i jest rysowany ponownie tylko wtedy, gdy się zmienił.
+ * Zwraca false, gdy nie udało się alokować pamięci.
+ */
+bool screen_set_status(screen_t *s, const char *status);
+
+/**
+ * Wypisuje zmiany od poprzedniej klatki jednym zapisem. Zwraca false, gdy
+ * nie udało się alokować pamięci lub zapisać klatki; @p errno opisuje
+ * wtedy błąd.
+ */
+bool screen_flush(screen_t *s);
+
+#endif /* SCREEN_H */
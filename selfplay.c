@@ -0,0 +1,187 @@
+/** @file
+ * Implementacja modułu symulacji rozgrywek
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "game.h"
+#include "rng.h"
+#include "safe_memory_allocation.h"
+#include "selfplay.h"
+
+/**
+ * Maksymalna liczba wątków.
+ */
+#define SELFPLAY_MAX_THREADS 256
+
+/**
+ * Liczba gier pobieranych naraz przez wątek ze wspólnego licznika.
+ */
+#define SELFPLAY_BATCH 16
+
+/**
+ * To jest struktura przechowująca stan wątku symulacji. Wyniki kolejnych
+ * wątków są rozdzielone odstępem, żeby wątki nie zapisywały do wspólnych
+ * linii pamięci podręcznej.
+ */
+typedef struct worker {
+    pthread_t thread;
+    bool started;
+    bool failed;
+    const selfplay_params_t *params;
+    atomic_uint_fast64_t *next_game;
+    game_t *game;
+    selfplay_result_t result;
+    char padding[64];
+} worker_t;
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zwraca czas monotoniczny w sekundach.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * Rozgrywa grę o numerze @p index na strukturze gry wątku i dolicza jej
+ * wynik. Zwraca false, gdy nie udało się alokować pamięci.
+ */
+static bool play_game(worker_t *w, uint64_t index) {
+    game_t *g = w->game;
+    uint32_t players = w->params->players;
+    uint64_t seed = w->params->seed + index;
+    rng_t rng;
+    rng_seed(&rng, rng_splitmix(&seed));
+
+    game_reset(g);
+    uint64_t moves = 0;
+    for (uint32_t p = game_next_active_player(g, NO_PLAYER);
+         p != NO_PLAYER; p = game_next_active_player(g, p)) {
+        uint32_t x, y;
+        uint64_t n = rng_below(&rng, game_free_fields(g, p));
+        if (!game_legal_move(g, p, n, &x, &y) || !game_move(g, p, x, y)) {
+            return false;
+        }
+        moves++;
+    }
+
+    selfplay_result_t *r = &w->result;
+    uint64_t best = 0;
+    uint32_t winner = NO_PLAYER;
+    for (uint32_t p = 1; p <= players; p++) {
+        uint64_t busy = game_busy_fields(g, p);
+        r->fields[p] += busy;
+        if (busy > best) {
+            best = busy;
+            winner = p;
+        }
+        else if (busy == best) {
+            winner = NO_PLAYER;
+        }
+    }
+    if (winner == NO_PLAYER) {
+        r->draws++;
+    }
+    else {
+        r->wins[winner]++;
+    }
+    r->games++;
+    r->moves += moves;
+    return true;
+}
+
+/**
+ * Rozgrywa gry w wątku. Wątek pobiera numery kolejnych gier paczkami ze
+ * wspólnego licznika atomowego.
+ */
+static void* worker_run(void *arg) {
+    worker_t *w = arg;
+    uint64_t games = w->params->games;
+    while (!w->failed) {
+        uint64_t first = atomic_fetch_add(w->next_game, SELFPLAY_BATCH);
+        if (first >= games) {
+            break;
+        }
+        uint64_t last = first + SELFPLAY_BATCH < games
+                        ? first + SELFPLAY_BATCH : games;
+        for (uint64_t i = first; i < last && !w->failed; i++) {
+            w->failed = !play_game(w, i);
+        }
+    }
+    return NULL;
+}
+
+/* FUNKCJE MODUŁU */
+
+bool selfplay_run(const selfplay_params_t *params, selfplay_result_t *result) {
+    if (params == NULL || result == NULL) {
+        return false;
+    }
+    uint64_t threads = params->threads;
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (uint64_t)online : 1;
+    }
+    if (threads > SELFPLAY_MAX_THREADS) {
+        threads = SELFPLAY_MAX_THREADS;
+    }
+    worker_t *workers = safe_calloc(threads, sizeof(worker_t));
+    if (workers == NULL) {
+        return false;
+    }
+
+    atomic_uint_fast64_t next_game = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < threads && ok; i++) {
+        workers[i].params = params;
+        workers[i].next_game = &next_game;
+        workers[i].game = game_new(params->width, params->height,
+                                   params->players, params->areas);
+        ok = workers[i].game != NULL;
+    }
+
+    double start = now();
+    for (uint32_t i = 1; i < threads && ok; i++) {
+        workers[i].started = pthread_create(&workers[i].thread, NULL,
+                                            worker_run, &workers[i]) == 0;
+    }
+    if (ok) {
+        worker_run(&workers[0]);
+    }
+    memset(result, 0, sizeof(selfplay_result_t));
+    for (uint32_t i = 0; i < threads; i++) {
+        const worker_t *w = &workers[i];
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+        }
+    }
+    result->threads = (uint32_t)threads;
+    result->seconds = now() - start;
+    for (uint32_t i = 0; i < threads; i++) {
+        const worker_t *w = &workers[i];
+        ok = ok && !w->failed;
+        result->games += w->result.games;
+        result->moves += w->result.moves;
+        result->draws += w->result.draws;
+        for (uint32_t p = 0; p <= MAX_NUMBER_OF_PLAYERS; p++) {
+            result->wins[p] += w->result.wins[p];
+            result->fields[p] += w->result.fields[p];
+        }
+        game_delete(w->game);
+    }
+    free(workers);
+    return ok;
+}
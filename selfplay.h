@@ -0,0 +1,54 @@
+/** @file
+ * Interfejs modułu symulacji rozgrywek
+ *
+ * Moduł rozgrywa wiele kompletnych gier, w których każdy gracz wykonuje
+ * losowy dozwolony ruch. Gry są rozdzielane między wątki; każdy wątek
+ * używa jednej struktury gry, którą przywraca do stanu początkowego przed
+ * kolejną grą. Wyniki są zbierane osobno w każdym wątku i sumowane po ich
+ * zakończeniu.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "constants.h"
+
+/**
+ * To jest struktura przechowująca parametry symulacji.
+ */
+typedef struct selfplay_params {
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+    uint64_t games;     /* Liczba gier do rozegrania. */
+    uint32_t threads;   /* Liczba wątków, zero oznacza liczbę procesorów. */
+    uint64_t seed;      /* Ziarno; gra o numerze i zależy tylko od ziarna i i. */
+} selfplay_params_t;
+
+/**
+ * To jest struktura przechowująca zsumowane wyniki symulacji.
+ */
+typedef struct selfplay_result {
+    uint64_t games;
+    uint64_t moves;
+    uint64_t draws;                              /* Gry bez jednego zwycięzcy. */
+    uint64_t wins[MAX_NUMBER_OF_PLAYERS + 1];    /* Gry wygrane przez gracza. */
+    uint64_t fields[MAX_NUMBER_OF_PLAYERS + 1];  /* Suma zajętych pól gracza. */
+    uint32_t threads;
+    double seconds;
+} selfplay_result_t;
+
+/**
+ * Rozgrywa gry o zadanych parametrach i zapisuje wyniki w @p result.
+ * Zwraca false, gdy parametry gry są niepoprawne lub nie udało się alokować
+ * pamięci.
+ */
+bool selfplay_run(const selfplay_params_t *params, selfplay_result_t *result);
+
+#endif /* SELFPLAY_H */
@@ -0,0 +1,119 @@
+/** @file
+ * Implementacja modułu zapisu migawek gry
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "safe_memory_allocation.h"
+#include "snapshot.h"
+
+/**
+ * Rozmiar bufora zapisu.
+ */
+#define SNAPSHOT_BUFFER_SIZE (1 << 16)
+
+/**
+ * Początkowa wartość sumy kontrolnej FNV-1a.
+ */
+#define SNAPSHOT_CHECKSUM_BASIS UINT64_C(0xCBF29CE484222325)
+
+/* FUNKCJE POMOCNICZE */
+
+/**
+ * Zapisuje @p size bajtów do deskryptora, ponawiając przerwane
+ * i częściowe zapisy. Zapis, który nie zapisał żadnego bajtu, kończy się
+ * błędem @p EIO.
+ */
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            if (written == 0) {
+                errno = EIO;
+            }
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+/**
+ * Zapisuje zawartość bufora.
+ */
+static bool snapshot_flush(snapshot_writer_t *w) {
+    bool ok = write_all(w->fd, w->buffer, w->used);
+    w->used = 0;
+    return ok;
+}
+
+/* FUNKCJE MODUŁU */
+
+uint64_t snapshot_align(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(uint64_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+uint64_t snapshot_checksum(const void *data, size_t size) {
+    return snapshot_checksum_update(SNAPSHOT_CHECKSUM_BASIS, data, size);
+}
+
+uint64_t snapshot_checksum_update(uint64_t checksum, const void *data,
+                                  size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        checksum = (checksum ^ bytes[i]) * UINT64_C(0x100000001B3);
+    }
+    return checksum;
+}
+
+bool snapshot_writer_init(snapshot_writer_t *w, int fd) {
+    w->fd = fd;
+    w->offset = 0;
+    w->used = 0;
+    w->checksum = SNAPSHOT_CHECKSUM_BASIS;
+    w->buffer = safe_malloc(SNAPSHOT_BUFFER_SIZE);
+    return w->buffer != NULL;
+}
+
+bool snapshot_write(snapshot_writer_t *w, const void *data, size_t size) {
+    w->offset += size;
+    w->checksum = snapshot_checksum_update(w->checksum, data, size);
+    if (w->used + size <= SNAPSHOT_BUFFER_SIZE) {
+        memcpy(w->buffer + w->used, data, size);
+        w->used += size;
+        return true;
+    }
+    return snapshot_flush(w) && write_all(w->fd, data, size);
+}
+
+bool snapshot_write_padding(snapshot_writer_t *w) {
+    static const char zeros[SNAPSHOT_ALIGNMENT];
+    return snapshot_write(w, zeros, snapshot_align(w->offset) - w->offset);
+}
+
+uint64_t snapshot_writer_section(snapshot_writer_t *w) {
+    uint64_t checksum = w->checksum;
+    w->checksum = SNAPSHOT_CHECKSUM_BASIS;
+    return checksum;
+}
+
+bool snapshot_writer_finish(snapshot_writer_t *w) {
+    bool ok = snapshot_flush(w);
+    free(w->buffer);
+    w->buffer = NULL;
+    return ok;
+}
+
+bool snapshot_section_correct(uint64_t offset, uint64_t size, uint64_t total) {
+    return offset % SNAPSHOT_ALIGNMENT == 0 && offset <= total
+           && size <= total - offset;
+}
@@ -0,0 +1,141 @@
+/** @file
+ * Interfejs modułu zapisu migawek gry
+ *
+ * Migawka jest plikiem binarnym, który można zmapować do pamięci i używać
+ * bez odtwarzania stanu pole po polu. Zaczyna się nagłówkiem
+ * @ref snapshot_header_t, po którym następują sekcje opisane przesunięciami
+ * od początku pliku i wyrównane do @ref SNAPSHOT_ALIGNMENT bajtów. Liczby
+ * są zapisywane w porządku bajtów komputera, który utworzył migawkę;
+ * migawki z komputera o innym porządku bajtów są odrzucane.
+ * Moduł udostępnia zapis strumieniowy z buforem, który zapisuje plik
+ * jednym sekwencyjnym przebiegiem, bez przesuwania się w pliku, i liczy
+ * przy tym sumy kontrolne kolejnych sekcji; są one zapisywane w zakończeniu
+ * migawki @ref snapshot_trailer_t.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Znacznik początku migawki.
+ */
+#define SNAPSHOT_MAGIC "IPPSNAP"
+
+/**
+ * Wersja formatu migawki.
+ */
+#define SNAPSHOT_VERSION 7
+
+/**
+ * Wartość zapisywana w nagłówku do rozpoznania porządku bajtów.
+ */
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/**
+ * Wyrównanie sekcji migawki.
+ */
+#define SNAPSHOT_ALIGNMENT 64
+
+/**
+ * To jest struktura przechowująca nagłówek migawki.
+ */
+typedef struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;              /* Rozmiar całej migawki. */
+    uint64_t checksum;          /* Suma kontrolna nagłówka z zerową sumą. */
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+    uint32_t order;             /* Kolejność pól planszy. */
+    uint32_t reserved;
+    uint64_t free_fields;
+    uint64_t players_offset;    /* Tablica liczników graczy. */
+    uint64_t players_size;
+    uint64_t board_offset;      /* Sekcja planszy. */
+    uint64_t trailer_offset;    /* Zakończenie migawki. */
+} snapshot_header_t;
+
+/**
+ * To jest struktura przechowująca zakończenie migawki: sumy kontrolne
+ * sekcji, każda liczona od początku sekcji do początku następnej.
+ */
+typedef struct snapshot_trailer {
+    uint64_t players_checksum;
+    uint64_t board_checksum;
+} snapshot_trailer_t;
+
+/**
+ * To jest struktura opisująca zapis strumieniowy migawki.
+ */
+typedef struct snapshot_writer {
+    int fd;
+    uint64_t offset;    /* Liczba bajtów zapisanych od początku migawki. */
+    size_t used;        /* Liczba bajtów w buforze. */
+    uint64_t checksum;  /* Suma kontrolna bajtów bieżącej sekcji. */
+    char *buffer;
+} snapshot_writer_t;
+
+/**
+ * Zwraca najmniejszą wielokrotność @ref SNAPSHOT_ALIGNMENT niemniejszą
+ * od @p offset.
+ */
+uint64_t snapshot_align(uint64_t offset);
+
+/**
+ * Zwraca sumę kontrolną (FNV-1a) @p size bajtów spod adresu @p data.
+ */
+uint64_t snapshot_checksum(const void *data, size_t size);
+
+/**
+ * Zwraca sumę kontrolną ciągu bajtów o sumie @p checksum przedłużonego
+ * o @p size bajtów spod adresu @p data.
+ */
+uint64_t snapshot_checksum_update(uint64_t checksum, const void *data,
+                                  size_t size);
+
+/**
+ * Przygotowuje zapis migawki do deskryptora @p fd od jego bieżącej pozycji.
+ * Zwraca false, gdy nie udało się alokować bufora.
+ */
+bool snapshot_writer_init(snapshot_writer_t *w, int fd);
+
+/**
+ * Dopisuje @p size bajtów spod adresu @p data. Zwraca false, gdy zapis się
+ * nie powiódł; @p errno opisuje wtedy błąd.
+ */
+bool snapshot_write(snapshot_writer_t *w, const void *data, size_t size);
+
+/**
+ * Dopisuje zera do najbliższego wyrównanego przesunięcia.
+ */
+bool snapshot_write_padding(snapshot_writer_t *w);
+
+/**
+ * Zwraca sumę kontrolną bajtów zapisanych od poprzedniego wywołania (lub
+ * od początku migawki) i zaczyna liczyć sumę następnej sekcji.
+ */
+uint64_t snapshot_writer_section(snapshot_writer_t *w);
+
+/**
+ * Zapisuje zawartość bufora i zwalnia go. Zwraca false, gdy zapis się nie
+ * powiódł.
+ */
+bool snapshot_writer_finish(snapshot_writer_t *w);
+
+/**
+ * Sprawdza, czy sekcja o przesunięciu @p offset i rozmiarze @p size jest
+ * wyrównana i mieści się w migawce o rozmiarze @p total.
+ */
+bool snapshot_section_correct(uint64_t offset, uint64_t size, uint64_t total);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,1415 @@
+/** @file
+ * Testy silnika gry.
+ *
+ * Każdy test rozgrywa powtarzalne (zależne tylko od ziarna) gry przez
+ * publiczny interfejs silnika i porównuje jego odpowiedzi z wynikami
+ * wyznaczonymi wprost z zawartości planszy. Program wypisuje wynik każdego
+ * testu i kończy się kodem 1, jeśli któryś test się nie powiódł.
+ *
+ * @author Anna Pawłowska <ap429162@students.mimuw.edu.pl>
+ * @date 2023
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "constants.h"
+#include "game.h"
+#include "mcts.h"
+#include "replay.h"
+#include "rng.h"
+#include "snapshot.h"
+
+/**
+ * Sprawdza warunek; gdy nie jest spełniony, wypisuje jego położenie
+ * i kończy test porażką.
+ */
+#define CHECK(condition)                                                  \
+    do {                                                                  \
+        if (!(condition)) {                                               \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            return false;                                                 \
+        }                                                                 \
+    } while (0)
+
+/**
+ * Liczba ruchów między kolejnymi porównaniami z wynikami wzorcowymi.
+ */
+#define CHECK_INTERVAL 37
+
+/**
+ * To jest struktura opisująca test.
+ */
+typedef struct test {
+    const char *name;
+    bool (*run)(void);
+} test_t;
+
+/* WYNIKI WZORCOWE */
+
+/**
+ * Zwraca liczbę obszarów gracza, licząc je przeszukiwaniem planszy.
+ * Tablica @p seen ma po jednym bajcie na pole.
+ */
+static uint32_t reference_areas(game_t *g, uint32_t player, uint8_t *seen,
+                                uint64_t *stack) {
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+    memset(seen, 0, (size_t)width * height);
+    uint32_t areas = 0;
+    for (uint64_t start = 0; start < (uint64_t)width * height; start++) {
+        if (seen[start] || game_field_player(g, (uint32_t)(start / height),
+                                             (uint32_t)(start % height))
+                           != player) {
+            continue;
+        }
+        areas++;
+        uint64_t top = 0;
+        stack[top++] = start;
+        seen[start] = 1;
+        while (top > 0) {
+            uint64_t cell = stack[--top];
+            uint32_t x = (uint32_t)(cell / height);
+            uint32_t y = (uint32_t)(cell % height);
+            int64_t dx[DIRECTIONS] = {1, -1, 0, 0};
+            int64_t dy[DIRECTIONS] = {0, 0, 1, -1};
+            for (uint32_t i = 0; i < DIRECTIONS; i++) {
+                int64_t nx = (int64_t)x + dx[i];
+                int64_t ny = (int64_t)y + dy[i];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                    continue;
+                }
+                uint64_t next = (uint64_t)nx * height + (uint64_t)ny;
+                if (!seen[next] && game_field_player(g, (uint32_t)nx,
+                                                     (uint32_t)ny) == player) {
+                    seen[next] = 1;
+                    stack[top++] = next;
+                }
+            }
+        }
+    }
+    return areas;
+}
+
+/**
+ * Sprawdza, czy pole (x, y) jest wolne i sąsiaduje z polem gracza.
+ */
+static bool reference_frontier(game_t *g, uint32_t player, uint32_t x,
+                               uint32_t y) {
+    return game_field_player(g, x, y) == NO_PLAYER
+           && ((x > 0 && game_field_player(g, x - 1, y) == player)
+               || game_field_player(g, x + 1, y) == player
+               || (y > 0 && game_field_player(g, x, y - 1) == player)
+               || game_field_player(g, x, y + 1) == player);
+}
+
+/**
+ * Porównuje liczby zajętych i wolnych pól oraz wyliczenie dozwolonych
+ * ruchów każdego gracza z wynikami wyznaczonymi wprost z planszy. Wolne
+ * pola gracza, który ma mniej obszarów niż @p areas, to wszystkie wolne
+ * pola, a pozostałego gracza – wolne pola sąsiednie z jego polami.
+ */
+static bool check_reference(game_t *g, uint32_t areas, uint8_t *seen,
+                            uint64_t *stack, uint8_t *legal) {
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+    uint64_t cells = (uint64_t)width * height;
+    for (uint32_t player = 1; player <= game_players(g); player++) {
+        bool limited = reference_areas(g, player, seen, stack) >= areas;
+        uint64_t busy = 0;
+        uint64_t free = 0;
+        memset(legal, 0, cells);
+        for (uint32_t x = 0; x < width; x++) {
+            for (uint32_t y = 0; y < height; y++) {
+                uint32_t owner = game_field_player(g, x, y);
+                busy += owner == player;
+                if (owner == NO_PLAYER
+                    && (!limited || reference_frontier(g, player, x, y))) {
+                    legal[(uint64_t)x * height + y] = 1;
+                    free++;
+                }
+            }
+        }
+        CHECK(game_busy_fields(g, player) == busy);
+        CHECK(game_free_fields(g, player) == free);
+        for (uint64_t n = 0; n < free; n++) {
+            uint32_t x, y;
+            CHECK(game_legal_move(g, player, n, &x, &y));
+            CHECK(x < width && y < height);
+            uint64_t cell = (uint64_t)x * height + y;
+            CHECK(legal[cell] == 1);
+            legal[cell] = 2;
+        }
+        uint32_t x, y;
+        CHECK(!game_legal_move(g, player, free, &x, &y));
+    }
+    return true;
+}
+
+/**
+ * Porównuje rozmiar obszaru każdego pola z rozmiarem wyznaczonym
+ * przeszukiwaniem planszy. Tablica @p seen ma po jednym bajcie na pole,
+ * a tablice @p stack i @p area po jednym elemencie na pole.
+ */
+static bool check_area_sizes(game_t *g, uint8_t *seen, uint64_t *stack,
+                             uint64_t *area) {
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+    memset(seen, 0, (size_t)width * height);
+    for (uint64_t start = 0; start < (uint64_t)width * height; start++) {
+        uint32_t player = game_field_player(g, (uint32_t)(start / height),
+                                            (uint32_t)(start % height));
+        if (seen[start] || player == NO_PLAYER) {
+            continue;
+        }
+        uint64_t top = 0;
+        uint64_t cells = 0;
+        stack[top++] = start;
+        seen[start] = 1;
+        while (top > 0) {
+            uint64_t cell = stack[--top];
+            area[cells++] = cell;
+            uint32_t x = (uint32_t)(cell / height);
+            uint32_t y = (uint32_t)(cell % height);
+            int64_t dx[DIRECTIONS] = {1, -1, 0, 0};
+            int64_t dy[DIRECTIONS] = {0, 0, 1, -1};
+            for (uint32_t i = 0; i < DIRECTIONS; i++) {
+                int64_t nx = (int64_t)x + dx[i];
+                int64_t ny = (int64_t)y + dy[i];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                    continue;
+                }
+                uint64_t next = (uint64_t)nx * height + (uint64_t)ny;
+                if (!seen[next] && game_field_player(g, (uint32_t)nx,
+                                                     (uint32_t)ny) == player) {
+                    seen[next] = 1;
+                    stack[top++] = next;
+                }
+            }
+        }
+        for (uint64_t i = 0; i < cells; i++) {
+            CHECK(game_area_size(g, (uint32_t)(area[i] / height),
+                                 (uint32_t)(area[i] % height)) == cells);
+        }
+    }
+    return true;
+}
+
+/* TESTY */
+
+/**
+ * Zapełnia losowo część planszy dozwolonymi ruchami.
+ */
+static void play_random(game_t *g, rng_t *rng, uint64_t moves) {
+    uint32_t player = game_next_active_player(g, NO_PLAYER);
+    for (uint64_t i = 0; i < moves && player != NO_PLAYER; i++) {
+        uint32_t x, y;
+        uint64_t n = rng_below(rng, game_free_fields(g, player));
+        if (game_legal_move(g, player, n, &x, &y)) {
+            game_move(g, player, x, y);
+        }
+        player = game_next_active_player(g, player);
+    }
+}
+
+/**
+ * Próbuje wykonać ruchy kolejnych graczy na losowe pola. Ruchy zależą tylko
+ * od ziarna i stanu planszy, a nie od numeracji dozwolonych ruchów.
+ */
+static void play_fields(game_t *g, rng_t *rng, uint64_t moves) {
+    uint32_t players = game_players(g);
+    for (uint64_t i = 0; i < moves; i++) {
+        game_move(g, (uint32_t)(i % players) + 1,
+                  (uint32_t)rng_below(rng, game_board_width(g)),
+                  (uint32_t)rng_below(rng, game_board_height(g)));
+    }
+}
+
+/**
+ * Rozgrywa losowe gry z wycofywaniem ruchów na planszach mieszczących się
+ * w planszy bitowej i na większych planszach i porównuje liczniki pól
+ * oraz wyliczenie dozwolonych ruchów z wynikami wzorcowymi. Oba rodzaje
+ * planszy muszą dawać te same odpowiedzi co reguły gry.
+ */
+static bool test_legal_moves(void) {
+    static const uint32_t sizes[][2] = {
+        {1, 1}, {7, 5}, {20, 15}, {64, 64}, {65, 9}, {70, 40}, {3, 100},
+    };
+    rng_t rng;
+    rng_seed(&rng, 6);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t width = sizes[s][0];
+        uint32_t height = sizes[s][1];
+        uint32_t players = 3;
+        uint32_t areas = 2;
+        uint64_t cells = (uint64_t)width * height;
+        game_t *g = game_new(width, height, players, areas);
+        uint8_t *seen = malloc(cells);
+        uint8_t *legal = malloc(cells);
+        uint64_t *stack = malloc(cells * sizeof(uint64_t));
+        bool ok = g != NULL && seen != NULL && legal != NULL && stack != NULL
+                  && game_set_history(g, 16);
+        uint32_t player = game_next_active_player(g, NO_PLAYER);
+        for (uint64_t i = 0; ok && player != NO_PLAYER; i++) {
+            uint64_t choice = rng_below(&rng, 8);
+            uint32_t x, y;
+            if (choice == 0) {
+                game_undo(g);
+            }
+            else if (choice == 1) {
+                game_move(g, player, (uint32_t)rng_below(&rng, width),
+                          (uint32_t)rng_below(&rng, height));
+            }
+            else if (game_free_fields(g, player) > 0) {
+                uint64_t n = rng_below(&rng, game_free_fields(g, player));
+                ok = game_legal_move(g, player, n, &x, &y)
+                     && game_move(g, player, x, y);
+            }
+            if (ok && i % CHECK_INTERVAL == 0) {
+                ok = check_reference(g, areas, seen, stack, legal);
+            }
+            player = game_next_active_player(g, player);
+        }
+        ok = ok && check_reference(g, areas, seen, stack, legal);
+        free(seen);
+        free(legal);
+        free(stack);
+        game_delete(g);
+        if (!ok) {
+            fprintf(stderr, "plansza %ux%u\n", width, height);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Zapełnia losowo część planszy ruchami zadanymi współrzędnymi, bez
+ * wyznaczania dozwolonych ruchów, a potem porównuje z wynikami wzorcowymi
+ * kopię gry, której indeks dozwolonych ruchów powstaje więc z zajętej
+ * planszy. Sprawdza każdą kolejność pól planszy w pamięci.
+ */
+static bool test_moves_index_build(void) {
+    static const uint32_t sizes[][2] = {
+        {70, 40}, {130, 70}, {3, 200}, {200, 3},
+    };
+    rng_t rng;
+    rng_seed(&rng, 7);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            uint32_t areas = 3;
+            uint64_t cells = (uint64_t)width * height;
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *g = game_new_with_options(width, height, 4, areas,
+                                              &options);
+            bool ok = g != NULL;
+            for (uint64_t i = 0; ok && i < cells / 2; i++) {
+                game_move(g, (uint32_t)rng_below(&rng, 4) + 1,
+                          (uint32_t)rng_below(&rng, width),
+                          (uint32_t)rng_below(&rng, height));
+            }
+            game_t *copy = ok ? game_fork(g) : NULL;
+            uint8_t *seen = malloc(cells);
+            uint8_t *legal = malloc(cells);
+            uint64_t *stack = malloc(cells * sizeof(uint64_t));
+            ok = copy != NULL && seen != NULL && legal != NULL
+                 && stack != NULL
+                 && check_reference(copy, areas, seen, stack, legal);
+            free(seen);
+            free(legal);
+            free(stack);
+            game_delete(copy);
+            game_delete(g);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Sprawdza, że indeks dozwolonych ruchów na ogromnej planszy z kilkoma
+ * zajętymi polami nie zajmuje pamięci proporcjonalnej do liczby pól.
+ */
+static bool test_moves_index_memory(void) {
+    uint32_t side = 1u << 17;
+    game_t *g = game_new(side, side, 2, 1);
+    CHECK(g != NULL);
+    bool ok = game_move(g, 1, 5, 5) && game_move(g, 2, side - 1, side - 1);
+    uint64_t before = game_memory(g);
+    uint32_t x, y;
+    uint64_t free = game_free_fields(g, 1);
+    ok = ok && game_legal_move(g, 1, 0, &x, &y)
+         && game_legal_move(g, 1, free - 1, &x, &y)
+         && game_field_player(g, x, y) == NO_PLAYER;
+    uint64_t index = game_memory(g) - before;
+    game_delete(g);
+    CHECK(ok);
+    /* Mapa bitowa wszystkich pól z drzewem potęgowym zajęłaby 4 GiB. */
+    CHECK(index < ((uint64_t)side * side >> 8) + ((uint64_t)1 << 20));
+    return true;
+}
+
+/**
+ * Wycofuje ruchy wykonane przed utworzeniem indeksu dozwolonych ruchów.
+ * Gracz 2 otacza wiersz pól gracza 1, więc indeks buduje pusty zbiór pól
+ * sąsiadujących z obszarem gracza 1, a wycofanie ruchów gracza 2 przywraca
+ * do niego pola, na które indeks nie ma zapasu miejsca.
+ */
+static bool test_moves_undo_before_index(void) {
+    uint32_t side = 100;
+    uint32_t length = 60;
+    game_t *g = game_new(side, side, 2, 20);
+    CHECK(g != NULL);
+    bool ok = game_set_history(g, 1000);
+    for (uint32_t x = 0; ok && x < length; x++) {
+        ok = game_move(g, 1, x, 1);
+    }
+    for (uint32_t x = 0; ok && x <= length; x++) {
+        ok = game_move(g, 2, x, 0) && game_move(g, 2, x, 2)
+             && (x < length || game_move(g, 2, x, 1));
+    }
+    uint32_t x, y;
+    ok = ok && game_legal_move(g, 1, 0, &x, &y);
+    uint64_t undone = 0;
+    while (ok && game_undo(g)) {
+        undone++;
+    }
+    ok = ok && undone == 3 * length + 3
+         && game_free_fields(g, 1) == (uint64_t)side * side
+         && game_busy_fields(g, 1) == 0 && game_busy_fields(g, 2) == 0
+         && game_legal_move(g, 2, 0, &x, &y);
+    game_delete(g);
+    CHECK(ok);
+    return true;
+}
+
+/**
+ * Sprawdza, że wycofanie ruchów przywraca numerację dozwolonych ruchów na
+ * planszy większej niż plansza bitowa, więc korzeń drzewa przeszukiwania
+ * rozwija każdy dozwolony ruch dokładnie raz. Gracz 1 ma wyczerpany limit
+ * obszarów, więc jego ruchy są polami sąsiadującymi z jego obszarem.
+ */
+static bool test_mcts_root_children(void) {
+    uint32_t side = 100;
+    game_t *g = game_new(side, side, 2, 1);
+    CHECK(g != NULL);
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < 60; i++) {
+        ok = game_move(g, 1, 20 + i, 50)
+             && game_move(g, 2, 20 + i, 10);
+    }
+    uint64_t moves = game_free_fields(g, 1);
+    mcts_params_t params = mcts_default_params();
+    params.threads = 1;
+    params.playouts = moves;
+    params.depth = 64;
+    mcts_result_t result;
+    ok = ok && moves > 100 && mcts_search(g, 1, &params, &result);
+    game_delete(g);
+    CHECK(ok);
+    CHECK(result.playouts == moves);
+    CHECK(result.root_moves == moves);
+    return true;
+}
+
+/**
+ * Rozgrywa losowe gry z częstym wycofywaniem ruchów, w których ruchy
+ * często łączą obszary, i porównuje rozmiary obszarów wszystkich pól
+ * z wynikami wzorcowymi. Łączenie przekolorowuje pola mniejszych obszarów,
+ * a wycofanie ruchu musi przywrócić ich kolory. Gry toczą się na kopiach,
+ * więc przekolorowywane pola leżą w kafelkach współdzielonych z oryginałem.
+ */
+static bool test_area_sizes(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {70, 40}, {3, 200}};
+    rng_t rng;
+    rng_seed(&rng, 4);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            uint64_t cells = (uint64_t)width * height;
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *g = game_new_with_options(width, height, 2, 8, &options);
+            game_t *copy = NULL;
+            uint8_t *seen = malloc(cells);
+            uint64_t *stack = malloc(cells * sizeof(uint64_t));
+            uint64_t *area = malloc(cells * sizeof(uint64_t));
+            bool ok = g != NULL && seen != NULL && stack != NULL
+                      && area != NULL;
+            if (ok) {
+                play_random(g, &rng, cells / 4);
+                copy = game_fork(g);
+            }
+            ok = copy != NULL && game_set_history(copy, 64);
+            for (uint64_t i = 0; ok && i < cells * 4; i++) {
+                uint32_t player = (uint32_t)rng_below(&rng, 2) + 1;
+                if (rng_below(&rng, 3) == 0) {
+                    game_undo(copy);
+                }
+                else {
+                    game_move(copy, player, (uint32_t)rng_below(&rng, width),
+                              (uint32_t)rng_below(&rng, height));
+                }
+                if (i % CHECK_INTERVAL == 0) {
+                    ok = check_area_sizes(copy, seen, stack, area);
+                }
+            }
+            while (ok && game_undo(copy)) {
+            }
+            ok = ok && check_area_sizes(copy, seen, stack, area)
+                 && check_area_sizes(g, seen, stack, area)
+                 && game_hash(copy) == game_hash(g);
+            free(seen);
+            free(stack);
+            free(area);
+            game_delete(copy);
+            game_delete(g);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Sprawdza, że kolory połączonych obszarów są używane ponownie: gra,
+ * w której co drugi ruch tworzy obszar, a następny łączy go z poprzednimi,
+ * zajmuje tyle pamięci co gra o tych samych polach zajmowanych po kolei
+ * (poza pierwszym połączeniem obszarów, które w obu grach przydziela stos
+ * przeszukiwania obszaru). Bez ponownego użycia kolorów potrzebowałaby
+ * stron na kilka tysięcy kolorów. To samo musi zachodzić po wycofaniu
+ * części ruchów i ich powtórzeniu.
+ */
+static bool test_area_colors_reused(void) {
+    uint32_t width = 9001;
+    game_t *merging = game_new(width, 1, 1, 2);
+    game_t *growing = game_new(width, 1, 1, 2);
+    CHECK(merging != NULL && growing != NULL);
+    bool ok = game_set_history(merging, 100) && game_set_history(growing, 100)
+              && game_move(merging, 1, 0, 0) && game_move(growing, 1, 0, 0)
+              && game_move(growing, 1, 2, 0) && game_move(growing, 1, 1, 0);
+    for (uint32_t x = 2; ok && x < width; x += 2) {
+        ok = game_move(merging, 1, x, 0) && game_area_size(merging, x, 0) == 1
+             && game_move(merging, 1, x - 1, 0)
+             && game_area_size(merging, 0, 0) == (uint64_t)x + 1;
+    }
+    for (uint32_t x = 3; ok && x < width; x++) {
+        ok = game_move(growing, 1, x, 0);
+    }
+    for (uint32_t i = 0; ok && i < 100; i++) {
+        ok = game_undo(merging) && game_undo(growing);
+    }
+    for (uint32_t x = width - 100; ok && x < width; x++) {
+        ok = game_move(merging, 1, x, 0) && game_move(growing, 1, x, 0);
+    }
+    ok = ok && game_area_size(merging, width / 2, 0) == width
+         && game_memory(merging) == game_memory(growing);
+    game_delete(merging);
+    game_delete(growing);
+    CHECK(ok);
+    return true;
+}
+
+/**
+ * Dolicza czas @p ns do histogramu czasu ruchu @p stats, wyznaczając jego
+ * przedział z dolnych granic przedziałów.
+ */
+static void record_latency(game_stats_t *stats, uint64_t ns) {
+    uint32_t bucket = 0;
+    while (bucket + 1 < GAME_STATS_LATENCY_BUCKETS
+           && game_stats_latency_bucket(bucket + 1) <= ns) {
+        bucket++;
+    }
+    stats->latency[bucket]++;
+    stats->latency_ns += ns;
+    if (ns > stats->latency_max) {
+        stats->latency_max = ns;
+    }
+}
+
+/**
+ * Sprawdza granice przedziałów histogramu czasu ruchu i kwantyle
+ * histogramu o znanych czasach, a potem zgodność histogramu zebranego
+ * w grze z najdłuższym zmierzonym ruchem.
+ */
+static bool test_latency_histogram(void) {
+    uint32_t sub = GAME_STATS_LATENCY_SUB_BUCKETS;
+    for (uint32_t i = 0; i < 2 * sub; i++) {
+        CHECK(game_stats_latency_bucket(i) == i);
+    }
+    for (uint32_t i = 2 * sub; i < GAME_STATS_LATENCY_BUCKETS; i++) {
+        uint64_t low = game_stats_latency_bucket(i);
+        uint64_t width = game_stats_latency_bucket(i + 1) - low;
+        CHECK(width > 0 && width * sub <= low);
+        CHECK(i % sub != 0 || low == (uint64_t)1 << (i / sub + 3));
+    }
+    CHECK(game_stats_latency_bucket(GAME_STATS_LATENCY_BUCKETS)
+          == (uint64_t)1 << 40);
+
+    game_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    CHECK(game_stats_latency_quantile(&stats, 0.5) == 0);
+    for (uint32_t i = 0; i < 1000; i++) {
+        record_latency(&stats, i < 900 ? 100 : i < 990 ? 5000 : 1000000);
+    }
+    /* 100 ns leży w [96, 104), 5000 ns w [4864, 5120), a 10^6 ns
+       w [983040, 1015808), więc ostatni kwantyl ogranicza najdłuższy czas. */
+    CHECK(game_stats_latency_quantile(&stats, 0.0) == 104);
+    CHECK(game_stats_latency_quantile(&stats, 0.5) == 104);
+    CHECK(game_stats_latency_quantile(&stats, 0.899) == 104);
+    CHECK(game_stats_latency_quantile(&stats, 0.9) == 5120);
+    CHECK(game_stats_latency_quantile(&stats, 0.989) == 5120);
+    CHECK(game_stats_latency_quantile(&stats, 0.99) == 1000000);
+    CHECK(game_stats_latency_quantile(&stats, 1.0) == 1000000);
+    CHECK(game_stats_latency_quantile(NULL, 0.5) == 0);
+
+    game_t *g = game_new(50, 50, 3, 4);
+    CHECK(g != NULL);
+    rng_t rng;
+    rng_seed(&rng, 12);
+    bool ok = game_set_stats(g, true);
+    play_random(g, &rng, 2000);
+    ok = ok && game_stats(g, &stats);
+    game_delete(g);
+    CHECK(ok);
+    uint64_t total = 0;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < GAME_STATS_LATENCY_BUCKETS; i++) {
+        total += stats.latency[i];
+        if (stats.latency[i] > 0) {
+            last = i;
+        }
+    }
+    CHECK(total == stats.calls && stats.calls > 0);
+    CHECK(game_stats_latency_bucket(last) <= stats.latency_max);
+    CHECK(last + 1 == GAME_STATS_LATENCY_BUCKETS
+          || stats.latency_max < game_stats_latency_bucket(last + 1));
+    CHECK(game_stats_latency_quantile(&stats, 1.0) == stats.latency_max);
+    CHECK(game_stats_latency_quantile(&stats, 0.5)
+          <= game_stats_latency_quantile(&stats, 0.99));
+    return true;
+}
+
+/* MIGAWKI */
+
+/**
+ * Szablon ścieżki plików tymczasowych z migawkami.
+ */
+#define SNAPSHOT_TEMPLATE "/tmp/ipp-tests-XXXXXX"
+
+/**
+ * Zapisuje migawkę gry do nowego pliku tymczasowego, którego ścieżkę
+ * zapisuje w @p path. Zwraca false, gdy zapis się nie powiódł.
+ */
+static bool save_temporary(game_t const *g, char *path) {
+    strcpy(path, SNAPSHOT_TEMPLATE);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = game_save(g, fd);
+    return close(fd) == 0 && ok;
+}
+
+/**
+ * Wczytuje cały plik do pamięci. Zwraca NULL, gdy się to nie udało.
+ */
+static char* read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    char *data = NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && ftell(f) > 0) {
+        *size = (size_t)ftell(f);
+        data = malloc(*size);
+        rewind(f);
+        if (data != NULL && fread(data, 1, *size, f) != *size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+/**
+ * Zapisuje @p size bajtów do pliku @p path. Zwraca false, gdy się to nie
+ * udało.
+ */
+static bool write_file(const char *path, const char *data, size_t size) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * Porównuje stan dwóch gier: planszę, liczby pól graczy i skrót planszy.
+ */
+static bool games_equal(game_t *a, game_t *b) {
+    char *board_a = game_board(a);
+    char *board_b = game_board(b);
+    bool ok = board_a != NULL && board_b != NULL
+              && strcmp(board_a, board_b) == 0;
+    free(board_a);
+    free(board_b);
+    CHECK(ok);
+    CHECK(game_hash(a) == game_hash(b));
+    CHECK(game_players(a) == game_players(b));
+    for (uint32_t player = 1; player <= game_players(a); player++) {
+        CHECK(game_busy_fields(a, player) == game_busy_fields(b, player));
+        CHECK(game_free_fields(a, player) == game_free_fields(b, player));
+    }
+    return true;
+}
+
+/**
+ * Zapisuje i wczytuje gry na planszach mieszczących się w planszy bitowej
+ * i większych, w każdej kolejności pól, i sprawdza, że wczytana gra ma
+ * ten sam stan i po tych samych ruchach nadal go ma. Numeracja dozwolonych
+ * ruchów nie należy do stanu, więc ruchy są wybierane w oryginale
+ * i powtarzane we wczytanej grze.
+ */
+static bool test_snapshot_round_trip(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {130, 70}};
+    rng_t rng;
+    rng_seed(&rng, 15);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *g = game_new_with_options(width, height, 3, 4, &options);
+            CHECK(g != NULL);
+            play_random(g, &rng, (uint64_t)width * height / 2);
+            char path[sizeof(SNAPSHOT_TEMPLATE)];
+            bool saved = save_temporary(g, path);
+            game_t *loaded = saved ? game_load(path) : NULL;
+            if (saved) {
+                unlink(path);
+            }
+            bool ok = loaded != NULL && games_equal(g, loaded);
+            uint32_t player = game_next_active_player(g, NO_PLAYER);
+            for (uint64_t i = 0; ok && player != NO_PLAYER
+                                 && i < (uint64_t)width * height / 4; i++) {
+                uint32_t x, y;
+                uint64_t n = rng_below(&rng, game_free_fields(g, player));
+                ok = game_legal_move(g, player, n, &x, &y)
+                     && game_move(g, player, x, y)
+                     && game_move(loaded, player, x, y);
+                player = game_next_active_player(g, player);
+            }
+            ok = ok && games_equal(g, loaded);
+            game_delete(loaded);
+            game_delete(g);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Odczytuje stan gry wczytanej z uszkodzonej migawki: planszę (numery
+ * graczy), rozmiary obszarów wszystkich pól (kolory i drzewa find-union)
+ * oraz dozwolone ruchy graczy. Zmieniona migawka może opisywać stan
+ * niespójny z regułami gry, ale odczyty nie mogą wychodzić poza tablice.
+ */
+static void inspect_game(game_t *g) {
+    char *board = game_board(g);
+    free(board);
+    for (uint32_t x = 0; x < game_board_width(g); x++) {
+        for (uint32_t y = 0; y < game_board_height(g); y++) {
+            game_area_size(g, x, y);
+        }
+    }
+    for (uint32_t player = 1; player <= game_players(g); player++) {
+        uint64_t free = game_free_fields(g, player);
+        for (uint64_t n = 0; n < free && n < 64; n++) {
+            uint32_t x, y;
+            game_legal_move(g, player, n, &x, &y);
+        }
+    }
+}
+
+/**
+ * Sprawdza, że migawka z uszkodzonym bajtem lub skrócona jest odrzucana,
+ * a migawka zmieniona z poprawionymi sumami kontrolnymi jest odrzucana
+ * albo wczytywana do gry, której stan da się bezpiecznie odczytać.
+ * Zmieniane są bajty sekcji graczy i planszy; przy uruchomieniu
+ * z sanitizerem adresów test wykrywa odwołania poza tablice silnika.
+ */
+static bool test_snapshot_corrupted(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {70, 40}};
+    rng_t rng;
+    rng_seed(&rng, 16);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        game_t *g = game_new(sizes[s][0], sizes[s][1], 3, 2);
+        CHECK(g != NULL);
+        play_random(g, &rng, (uint64_t)sizes[s][0] * sizes[s][1] / 3);
+        char path[sizeof(SNAPSHOT_TEMPLATE)];
+        bool saved = save_temporary(g, path);
+        game_delete(g);
+        CHECK(saved);
+        size_t size;
+        char *data = read_file(path, &size);
+        CHECK(data != NULL && size > sizeof(snapshot_header_t));
+        const snapshot_header_t *h = (const snapshot_header_t*)data;
+        uint64_t start = h->players_offset;
+        uint64_t end = h->trailer_offset;
+        bool ok = true;
+
+        data[start + rng_below(&rng, end - start)] ^= 1;
+        ok = ok && write_file(path, data, size) && game_load(path) == NULL
+             && errno == EINVAL;
+        ok = ok && write_file(path, data, size - 1) && game_load(path) == NULL;
+
+        uint64_t rejected = 0;
+        for (uint32_t i = 0; ok && i < 300; i++) {
+            char *copy = malloc(size);
+            ok = copy != NULL;
+            if (!ok) {
+                break;
+            }
+            memcpy(copy, data, size);
+            uint64_t offset = start + rng_below(&rng, end - start);
+            copy[offset] = (char)rng_below(&rng, 256);
+            snapshot_trailer_t *t = (snapshot_trailer_t*)(copy + end);
+            t->players_checksum = snapshot_checksum(copy + start,
+                                                    h->board_offset - start);
+            t->board_checksum = snapshot_checksum(copy + h->board_offset,
+                                                  end - h->board_offset);
+            ok = write_file(path, copy, size);
+            free(copy);
+            game_t *loaded = ok ? game_load(path) : NULL;
+            if (loaded == NULL) {
+                rejected++;
+                continue;
+            }
+            inspect_game(loaded);
+            game_delete(loaded);
+        }
+        unlink(path);
+        free(data);
+        CHECK(ok);
+        CHECK(rejected > 0);
+    }
+    return true;
+}
+
+/* DZIENNIK RUCHÓW */
+
+/**
+ * Odtwarza dziennik z pliku @p path w nowej grze o parametrach z jego
+ * nagłówka i historii ruchów długości @p history, wykonując wpisy do końca
+ * dziennika lub pierwszego uszkodzonego bloku. Zapisuje pod @p status wynik
+ * czytania ostatniego bloku. Zwraca NULL, gdy nie udało się otworzyć
+ * dziennika lub silnik odrzucił któryś wpis.
+ */
+static game_t* replay_file(const char *path, uint64_t history,
+                           replay_status_t *status) {
+    replay_reader_t *r = replay_reader_open(path);
+    if (r == NULL) {
+        return NULL;
+    }
+    const replay_header_t *h = replay_reader_header(r);
+    game_t *g = game_new(h->width, h->height, h->players, h->areas);
+    replay_entry_t *entries = malloc(REPLAY_BLOCK_ENTRIES
+                                     * sizeof(replay_entry_t));
+    bool ok = g != NULL && entries != NULL && game_set_history(g, history);
+    uint32_t count;
+    while (ok && (*status = replay_reader_next(r, entries, &count))
+                 == REPLAY_BLOCK) {
+        for (uint32_t i = 0; ok && i < count; i++) {
+            const replay_entry_t *e = &entries[i];
+            if (e->player != NO_PLAYER) {
+                ok = game_move(g, e->player, e->x, e->y);
+            }
+            else if (e->x == REPLAY_UNDO) {
+                ok = game_undo(g);
+            }
+            else {
+                game_reset(g);
+            }
+        }
+    }
+    free(entries);
+    replay_reader_close(r);
+    if (!ok) {
+        game_delete(g);
+        return NULL;
+    }
+    return g;
+}
+
+/**
+ * Zapisuje dziennik losowej gry z wycofaniami ruchów i przywróceniem gry
+ * do stanu początkowego, odtwarza go i porównuje planszę i skrót
+ * odtworzonej gry z grą zapisaną. Potem skraca dziennik lub zmienia bajt
+ * jego ostatniego bloku i sprawdza, że odtwarzanie wykrywa uszkodzenie
+ * i kończy się na stanie sprzed tego bloku.
+ */
+static bool test_replay_round_trip(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {130, 70}};
+    rng_t rng;
+    rng_seed(&rng, 16);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t width = sizes[s][0];
+        uint32_t height = sizes[s][1];
+        uint64_t cells = (uint64_t)width * height;
+        char path[sizeof(SNAPSHOT_TEMPLATE)];
+        strcpy(path, SNAPSHOT_TEMPLATE);
+        int fd = mkstemp(path);
+        CHECK(fd >= 0);
+        replay_writer_t *w = replay_writer_open(fd, width, height, 3, 2);
+        game_t *g = game_new(width, height, 3, 2);
+        bool ok = w != NULL && g != NULL && game_set_history(g, 32);
+        game_set_replay(g, w);
+        uint32_t player = game_next_active_player(g, NO_PLAYER);
+        for (uint64_t i = 0; ok && player != NO_PLAYER && i < cells; i++) {
+            uint32_t x, y;
+            if (i == cells / 4) {
+                game_reset(g);
+            }
+            else if (rng_below(&rng, 8) == 0) {
+                game_undo(g);
+            }
+            else if (game_legal_move(g, player, rng_below(&rng,
+                         game_free_fields(g, player)), &x, &y)) {
+                ok = game_move(g, player, x, y);
+            }
+            player = game_next_active_player(g, player);
+        }
+        ok = ok && replay_writer_flush(w);
+        game_t *prefix = ok ? game_fork(g) : NULL;
+        play_random(g, &rng, cells / 8);
+        game_set_replay(g, NULL);
+        ok = replay_writer_close(w) && close(fd) == 0 && ok
+             && prefix != NULL && game_hash(prefix) != game_hash(g);
+
+        replay_status_t status;
+        game_t *replayed = ok ? replay_file(path, 32, &status) : NULL;
+        ok = replayed != NULL && status == REPLAY_END
+             && games_equal(replayed, g);
+        game_delete(replayed);
+
+        size_t size = 0;
+        char *data = ok ? read_file(path, &size) : NULL;
+        replay_reader_t *r = data != NULL ? replay_reader_open(path) : NULL;
+        uint64_t last = 0;
+        uint32_t count;
+        ok = r != NULL;
+        while (ok) {
+            uint64_t offset = replay_reader_offset(r);
+            if (replay_reader_skip(r, &count) != REPLAY_BLOCK) {
+                break;
+            }
+            last = offset;
+        }
+        replay_reader_close(r);
+        uint64_t start = last + sizeof(replay_block_t);
+        ok = ok && last > 0 && start < size;
+
+        ok = ok && write_file(path, data, size - 1);
+        replayed = ok ? replay_file(path, 32, &status) : NULL;
+        ok = replayed != NULL && status == REPLAY_CORRUPT
+             && games_equal(replayed, prefix);
+        game_delete(replayed);
+
+        if (ok) {
+            data[start + rng_below(&rng, size - start)] ^= 0x10;
+        }
+        ok = ok && write_file(path, data, size);
+        replayed = ok ? replay_file(path, 32, &status) : NULL;
+        ok = replayed != NULL && status == REPLAY_CORRUPT
+             && games_equal(replayed, prefix);
+        game_delete(replayed);
+
+        unlink(path);
+        free(data);
+        game_delete(prefix);
+        game_delete(g);
+        if (!ok) {
+            fprintf(stderr, "plansza %ux%u\n", width, height);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* STAN GRY */
+
+/**
+ * Porównuje stan dwóch gier o tych samych parametrach pole po polu:
+ * planszę, skrót, liczniki pól, rozmiary obszarów, dozwolone ruchy,
+ * kolejnych aktywnych graczy i ranking. Gdy @p numbering jest true,
+ * dozwolone ruchy muszą mieć też te same numery; numeracja zależy od
+ * ruchów wykonanych od utworzenia indeksu, więc gra rozgałęziona może mieć
+ * inną numerację niż gra, która rozegrała te same ruchy.
+ */
+static bool games_identical(game_t *a, game_t *b, bool numbering) {
+    CHECK(games_equal(a, b));
+    uint32_t width = game_board_width(a);
+    uint32_t height = game_board_height(a);
+    CHECK(width == game_board_width(b) && height == game_board_height(b));
+    for (uint32_t x = 0; x < width; x++) {
+        for (uint32_t y = 0; y < height; y++) {
+            CHECK(game_field_player(a, x, y) == game_field_player(b, x, y));
+            CHECK(game_area_size(a, x, y) == game_area_size(b, x, y));
+        }
+    }
+    CHECK(game_is_over(a) == game_is_over(b));
+    CHECK(game_next_active_player(a, NO_PLAYER)
+          == game_next_active_player(b, NO_PLAYER));
+    uint8_t *legal = calloc((uint64_t)width * height, 1);
+    CHECK(legal != NULL);
+    bool ok = true;
+    for (uint32_t player = 1; ok && player <= game_players(a); player++) {
+        for (uint64_t n = 0; ok && n < game_free_fields(a, player); n++) {
+            uint32_t xa, ya, xb, yb;
+            ok = game_legal_move(a, player, n, &xa, &ya)
+                 && game_legal_move(b, player, n, &xb, &yb)
+                 && (!numbering || (xa == xb && ya == yb));
+            if (ok) {
+                legal[(uint64_t)xa * height + ya] |= 1;
+                legal[(uint64_t)xb * height + yb] |= 2;
+            }
+        }
+        for (uint64_t i = 0; ok && i < (uint64_t)width * height; i++) {
+            ok = legal[i] == 0 || legal[i] == 3;
+            legal[i] = 0;
+        }
+    }
+    free(legal);
+    CHECK(ok);
+    for (uint32_t player = 1; player <= game_players(a); player++) {
+        CHECK(game_next_active_player(a, player)
+              == game_next_active_player(b, player));
+        CHECK(game_leaderboard(a, game_rank(a, player)) == player);
+        CHECK(game_busy_fields(a, game_leaderboard(a, player))
+              == game_busy_fields(b, game_leaderboard(b, player)));
+    }
+    return true;
+}
+
+/**
+ * Przywraca rozegraną grę do stanu początkowego i porównuje ją z nową grą
+ * o tych samych parametrach, także po rozegraniu na obu tych samych ruchów.
+ * Sprawdza każdą kolejność pól planszy w pamięci.
+ */
+static bool test_game_reset(void) {
+    static const uint32_t sizes[][2] = {{7, 5}, {70, 40}, {3, 100}};
+    rng_t rng;
+    rng_seed(&rng, 13);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            uint64_t cells = (uint64_t)width * height;
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *g = game_new_with_options(width, height, 3, 2, &options);
+            game_t *fresh = game_new_with_options(width, height, 3, 2,
+                                                  &options);
+            CHECK(g != NULL && fresh != NULL);
+            bool ok = game_set_history(g, 16);
+            play_random(g, &rng, cells / 2);
+            for (uint32_t i = 0; ok && i < 5; i++) {
+                ok = game_undo(g);
+            }
+            play_random(g, &rng, cells / 4);
+            game_reset(g);
+            ok = ok && !game_undo(g) && games_identical(g, fresh, true);
+            rng_t replay = rng;
+            play_random(g, &rng, cells / 3);
+            play_random(fresh, &replay, cells / 3);
+            ok = ok && games_identical(g, fresh, true);
+            game_delete(g);
+            game_delete(fresh);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Rozgałęzia rozegraną grę i wykonuje różne ruchy (a w grze rozgałęzianej
+ * także wycofania ruchów sprzed rozgałęzienia) w obu grach na przemian,
+ * porównując każdą z grą wzorcową, która rozegrała te same ruchy bez
+ * rozgałęziania. Potem usuwa grę rozgałęzianą i sprawdza, że jej kopia
+ * działa dalej. Sprawdza każdą kolejność pól planszy w pamięci.
+ */
+static bool test_fork_isolation(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {130, 70}};
+    rng_t rng;
+    rng_seed(&rng, 14);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            uint64_t cells = (uint64_t)width * height;
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *parent = game_new_with_options(width, height, 3, 3,
+                                                   &options);
+            game_t *parent_ref = game_new_with_options(width, height, 3, 3,
+                                                       &options);
+            game_t *child_ref = game_new_with_options(width, height, 3, 3,
+                                                      &options);
+            CHECK(parent != NULL && parent_ref != NULL && child_ref != NULL);
+            bool ok = game_set_history(parent, 16)
+                      && game_set_history(parent_ref, 16);
+            rng_t parent_rng = rng;
+            rng_t child_rng = rng;
+            play_random(parent, &rng, cells / 4);
+            play_random(parent_ref, &parent_rng, cells / 4);
+            play_random(child_ref, &child_rng, cells / 4);
+            game_t *child = ok ? game_fork(parent) : NULL;
+            ok = child != NULL && games_identical(child, child_ref, false)
+                 && game_hash(child) == game_hash(parent);
+            rng_seed(&child_rng, 140 + s);
+            for (uint32_t round = 0; ok && round < 4; round++) {
+                ok = game_undo(parent) && game_undo(parent_ref);
+                rng_t copy = rng;
+                play_fields(parent, &rng, cells / 16);
+                play_fields(parent_ref, &copy, cells / 16);
+                copy = child_rng;
+                play_fields(child, &child_rng, cells / 16);
+                play_fields(child_ref, &copy, cells / 16);
+                ok = ok && games_identical(parent, parent_ref, true)
+                     && games_identical(child, child_ref, false)
+                     && game_hash(parent) != game_hash(child);
+            }
+            game_delete(parent);
+            rng_t copy = child_rng;
+            play_fields(child, &child_rng, cells / 8);
+            play_fields(child_ref, &copy, cells / 8);
+            ok = ok && games_identical(child, child_ref, false);
+            game_delete(child);
+            game_delete(parent_ref);
+            game_delete(child_ref);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Sprawdza ranking gry z wynikiem sortowania liczb zajętych pól: miejsca
+ * graczy tworzą permutację zgodną z @ref game_leaderboard, a liczby pól
+ * graczy na kolejnych miejscach są liczbami pól wszystkich graczy
+ * posortowanymi malejąco.
+ */
+static bool check_leaderboard(game_t *g, uint64_t *busy) {
+    uint32_t players = game_players(g);
+    for (uint32_t player = 1; player <= players; player++) {
+        busy[player - 1] = game_busy_fields(g, player);
+    }
+    for (uint32_t i = 1; i < players; i++) {
+        for (uint32_t j = i; j > 0 && busy[j - 1] < busy[j]; j--) {
+            uint64_t tmp = busy[j - 1];
+            busy[j - 1] = busy[j];
+            busy[j] = tmp;
+        }
+    }
+    for (uint32_t rank = 1; rank <= players; rank++) {
+        uint32_t player = game_leaderboard(g, rank);
+        CHECK(player >= 1 && player <= players);
+        CHECK(game_rank(g, player) == rank);
+        CHECK(game_busy_fields(g, player) == busy[rank - 1]);
+    }
+    CHECK(game_leaderboard(g, 0) == NO_PLAYER);
+    CHECK(game_leaderboard(g, players + 1) == NO_PLAYER);
+    CHECK(game_rank(g, 0) == 0 && game_rank(g, players + 1) == 0);
+    return true;
+}
+
+/**
+ * Rozgrywa losowe gry wielu graczy z wycofywaniem ruchów i przywracaniem
+ * gry do stanu początkowego i po każdej zmianie porównuje ranking
+ * z posortowanymi liczbami zajętych pól. Mała plansza i mały limit
+ * obszarów dają wielu graczy z tą samą liczbą pól.
+ */
+static bool test_leaderboard(void) {
+    static const uint32_t params[][4] = {
+        {5, 4, 9, 1}, {20, 15, 30, 2}, {70, 40, 7, 3},
+    };
+    rng_t rng;
+    rng_seed(&rng, 17);
+    for (size_t s = 0; s < sizeof(params) / sizeof(params[0]); s++) {
+        uint32_t players = params[s][2];
+        game_t *g = game_new(params[s][0], params[s][1], players,
+                             params[s][3]);
+        uint64_t *busy = malloc(players * sizeof(uint64_t));
+        bool ok = g != NULL && busy != NULL && game_set_history(g, 64)
+                  && check_leaderboard(g, busy);
+        uint32_t player = game_next_active_player(g, NO_PLAYER);
+        for (uint64_t i = 0; ok && i < 3000; i++) {
+            uint64_t choice = rng_below(&rng, 256);
+            uint32_t x, y;
+            if (choice == 0) {
+                game_reset(g);
+            }
+            else if (choice < 64) {
+                game_undo(g);
+            }
+            else if (player != NO_PLAYER
+                     && game_legal_move(g, player, rng_below(&rng,
+                            game_free_fields(g, player)), &x, &y)) {
+                ok = game_move(g, player, x, y);
+            }
+            ok = ok && check_leaderboard(g, busy);
+            player = game_next_active_player(g, player);
+        }
+        free(busy);
+        game_delete(g);
+        if (!ok) {
+            fprintf(stderr, "plansza %ux%u, %u graczy\n", params[s][0],
+                    params[s][1], players);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Porównuje napis z @ref game_board z napisem czytanym kawałkami
+ * o rozmiarze @p size przez @ref game_board_read i z losowym fragmentem
+ * napisu.
+ */
+static bool check_board_read(game_t *g, const char *board, uint64_t length,
+                             uint64_t size, char *buffer, rng_t *rng) {
+    uint64_t offset = 0;
+    uint64_t read;
+    while ((read = game_board_read(g, offset, buffer, size)) > 0) {
+        CHECK(read <= size && offset + read <= length);
+        CHECK(read == size || offset + read == length);
+        CHECK(memcmp(buffer, board + offset, read) == 0);
+        offset += read;
+    }
+    CHECK(offset == length);
+    uint64_t start = rng_below(rng, length);
+    read = game_board_read(g, start, buffer, size);
+    CHECK(read == (length - start < size ? length - start : size));
+    CHECK(memcmp(buffer, board + start, read) == 0);
+    CHECK(game_board_read(g, length + 1, buffer, size) == 0);
+    return true;
+}
+
+/**
+ * Porównuje napis z @ref game_board z napisem czytanym kawałkami przez
+ * @ref game_board_read i zapisanym przez @ref game_board_write do pliku,
+ * dla każdej kolejności pól planszy, szerokości niebędących
+ * wielokrotnością 8 i rozmiarów kawałków dzielących wiersze.
+ */
+static bool test_board_stream(void) {
+    static const uint32_t sizes[][2] = {
+        {1, 1}, {7, 5}, {13, 9}, {64, 3}, {65, 70}, {130, 11}, {3, 200},
+    };
+    static const uint64_t reads[] = {1, 3, 7, 8, 61, 64, 100, 4096};
+    rng_t rng;
+    rng_seed(&rng, 24);
+    char *buffer = malloc(4096);
+    CHECK(buffer != NULL);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            game_t *g = game_new_with_options(width, height, 4, 3, &options);
+            bool ok = g != NULL;
+            if (ok) {
+                play_random(g, &rng, (uint64_t)width * height / 2);
+            }
+            char *board = ok ? game_board(g) : NULL;
+            uint64_t length = (uint64_t)(width + 1) * height;
+            ok = board != NULL && strlen(board) == length;
+            for (size_t r = 0; ok && r < sizeof(reads) / sizeof(reads[0]);
+                 r++) {
+                ok = check_board_read(g, board, length, reads[r], buffer,
+                                      &rng);
+            }
+            ok = ok && check_board_read(g, board, length, width, buffer, &rng)
+                 && check_board_read(g, board, length, width + 2, buffer,
+                                     &rng);
+
+            char path[sizeof(SNAPSHOT_TEMPLATE)];
+            strcpy(path, SNAPSHOT_TEMPLATE);
+            int fd = ok ? mkstemp(path) : -1;
+            ok = fd >= 0 && game_board_write(g, fd);
+            if (fd >= 0) {
+                ok = close(fd) == 0 && ok;
+            }
+            size_t size = 0;
+            char *data = ok ? read_file(path, &size) : NULL;
+            ok = data != NULL && size == length
+                 && memcmp(data, board, length) == 0;
+            if (fd >= 0) {
+                unlink(path);
+            }
+            free(data);
+            free(board);
+            game_delete(g);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                free(buffer);
+                return false;
+            }
+        }
+    }
+    free(buffer);
+    return true;
+}
+
+/**
+ * Sprawdza skrót Zobrista: pusta plansza i plansza po wycofaniu wszystkich
+ * ruchów mają skrót zero, a ta sama pozycja osiągnięta ruchami w innej
+ * kolejności, na planszy o innej kolejności pól i w rozgałęzionej grze ma
+ * ten sam skrót. Limit obszarów nie ogranicza ruchów, więc zajęte pola
+ * można zająć ponownie w dowolnej kolejności.
+ */
+static bool test_zobrist_hash(void) {
+    static const uint32_t sizes[][2] = {{20, 15}, {130, 70}};
+    rng_t rng;
+    rng_seed(&rng, 25);
+    for (uint32_t order = 0; order < BOARD_ORDERS; order++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t width = sizes[s][0];
+            uint32_t height = sizes[s][1];
+            uint32_t cells = width * height;
+            game_options_t options = {.huge_pages = false,
+                                      .order = (board_order_t)order};
+            board_order_t next = (board_order_t)((order + 1) % BOARD_ORDERS);
+            game_options_t other = {.huge_pages = false, .order = next};
+            game_t *g = game_new_with_options(width, height, 3, cells,
+                                              &options);
+            game_t *h = game_new_with_options(width, height, 3, cells, &other);
+            uint32_t (*moves)[3] = malloc(cells * sizeof(*moves));
+            CHECK(g != NULL && h != NULL && moves != NULL);
+            bool ok = game_hash(g) == 0 && game_hash(h) == 0
+                      && game_set_history(g, cells);
+            uint32_t count = 0;
+            for (uint32_t i = 0; ok && i < cells / 2; i++) {
+                uint32_t player = i % 3 + 1;
+                uint32_t x = (uint32_t)rng_below(&rng, width);
+                uint32_t y = (uint32_t)rng_below(&rng, height);
+                if (game_move(g, player, x, y)) {
+                    moves[count][0] = player;
+                    moves[count][1] = x;
+                    moves[count][2] = y;
+                    count++;
+                }
+            }
+            ok = ok && count > 0 && game_hash(g) != 0;
+            for (uint32_t i = count; i > 1; i--) {
+                uint32_t j = (uint32_t)rng_below(&rng, i);
+                for (uint32_t k = 0; k < 3; k++) {
+                    uint32_t tmp = moves[i - 1][k];
+                    moves[i - 1][k] = moves[j][k];
+                    moves[j][k] = tmp;
+                }
+            }
+            for (uint32_t i = 0; ok && i < count; i++) {
+                ok = game_move(h, moves[i][0], moves[i][1], moves[i][2]);
+            }
+            ok = ok && games_equal(g, h);
+
+            game_t *fork = ok ? game_fork(g) : NULL;
+            ok = fork != NULL && game_hash(fork) == game_hash(g);
+            uint32_t x = 0, y = 0;
+            while (ok && game_field_player(g, x, y) != NO_PLAYER) {
+                x = (uint32_t)rng_below(&rng, width);
+                y = (uint32_t)rng_below(&rng, height);
+            }
+            ok = ok && game_move(fork, 2, x, y)
+                 && game_hash(fork) != game_hash(g) && game_move(h, 2, x, y)
+                 && game_hash(fork) == game_hash(h);
+            game_delete(fork);
+
+            uint32_t undone = 0;
+            while (ok && game_undo(g)) {
+                undone++;
+            }
+            ok = ok && undone == count && game_hash(g) == 0;
+            game_reset(h);
+            ok = ok && game_hash(h) == 0;
+            free(moves);
+            game_delete(g);
+            game_delete(h);
+            if (!ok) {
+                fprintf(stderr, "plansza %ux%u, kolejność %u\n", width,
+                        height, order);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Testy uruchamiane przez program.
+ */
+static const test_t tests[] = {
+    {"legal_moves", test_legal_moves},
+    {"moves_index_build", test_moves_index_build},
+    {"moves_index_memory", test_moves_index_memory},
+    {"mcts_root_children", test_mcts_root_children},
+    {"moves_undo_before_index", test_moves_undo_before_index},
+    {"area_sizes", test_area_sizes},
+    {"area_colors_reused", test_area_colors_reused},
+    {"latency_histogram", test_latency_histogram},
+    {"snapshot_round_trip", test_snapshot_round_trip},
+    {"snapshot_corrupted", test_snapshot_corrupted},
+    {"replay_round_trip", test_replay_round_trip},
+    {"game_reset", test_game_reset},
+    {"fork_isolation", test_fork_isolation},
+    {"leaderboard", test_leaderboard},
+    {"board_stream", test_board_stream},
+    {"zobrist_hash", test_zobrist_hash},
+};
+
+int main(void) {
+    int status = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool ok = tests[i].run();
+        printf("%s: %s\n", tests[i].name, ok ? "OK" : "BŁĄD");
+        if (!ok) {
+            status = 1;
+        }
+    }
+    return status;
+}